@@ -23,10 +23,12 @@
  * THE SOFTWARE.
  */
 #include <cctype>
+#include <limits>
 
 #include <graphene/app/api.hpp>
 #include <graphene/app/api_access.hpp>
 #include <graphene/app/application.hpp>
+#include <graphene/account_history/account_history_plugin.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/get_config.hpp>
 #include <graphene/utilities/key_conversion.hpp>
@@ -335,6 +337,16 @@ namespace graphene { namespace app {
        return result;
     }
 
+    /// The operation history store of the account_history plugin, if it keeps the history in a file
+    static const account_history::operation_history_store* find_history_store( const application& app )
+    {
+       if( !app.is_plugin_enabled( "account_history" ) )
+          return nullptr;
+       auto plugin = app.get_plugin<account_history::account_history_plugin>( "account_history" );
+       const account_history::operation_history_store* store = plugin->history_store();
+       return ( store != nullptr && store->is_open() ) ? store : nullptr;
+    }
+
     vector<operation_history_object> history_api::get_account_history( const std::string account_id_or_name,
                                                                        operation_history_id_type stop,
                                                                        uint32_t limit,
@@ -350,6 +362,13 @@ namespace graphene { namespace app {
 
        vector<operation_history_object> result;
        account_id_type account;
+       if( const auto* store = find_history_store( _app ) )
+       {
+          try {
+             account = database_api.get_account_id_from_string(account_id_or_name);
+          } catch(...) { return result; }
+          return store->get_account_history( account, start, stop, limit );
+       }
        try {
           account = database_api.get_account_id_from_string(account_id_or_name);
           const account_transaction_history_object& node = account(db).statistics(db).most_recent_op(db);
@@ -406,27 +425,35 @@ namespace graphene { namespace app {
        try {
           account = database_api.get_account_id_from_string(account_id_or_name);
        } catch(...) { return result; }
+       if( operation_type < 0 || operation_type > std::numeric_limits<uint16_t>::max() ) return result;
+       if( const auto* store = find_history_store( _app ) )
+          return store->get_account_history( account, start, stop, limit, static_cast<uint16_t>( operation_type ) );
        const auto& stats = account(db).statistics(db);
        if( stats.most_recent_op == account_transaction_history_id_type() ) return result;
-       const account_transaction_history_object* node = &stats.most_recent_op(db);
        if( start == operation_history_id_type() )
-          start = node->operation_id;
-
-       while(node && node->operation_id.instance.value > stop.instance.value && result.size() < limit)
+          start = stats.most_recent_op(db).operation_id;
+
+       const auto& his_idx = db.get_index_type<account_transaction_history_index>().indices();
+       // sequence of the newest entry not after start
+       const auto& by_op_idx = his_idx.get<by_op>();
+       auto op_itr = by_op_idx.upper_bound( boost::make_tuple( account, start ) );
+       if( op_itr == by_op_idx.begin() ) return result;
+       --op_itr;
+       if( op_itr->account != account ) return result;
+       const uint64_t start_seq = op_itr->sequence;
+
+       // walk the entries of the requested type backwards from there
+       const auto type = static_cast<uint16_t>( operation_type );
+       const auto& by_type_idx = his_idx.get<by_type>();
+       auto itr = by_type_idx.upper_bound( boost::make_tuple( account, type, start_seq ) );
+       const auto begin = by_type_idx.lower_bound( boost::make_tuple( account, type ) );
+       while( itr != begin && result.size() < limit )
        {
-          if( node->operation_id.instance.value <= start.instance.value ) {
-
-             if(node->operation_id(db).op.which() == operation_type)
-               result.push_back( node->operation_id(db) );
-          }
-          if( node->next == account_transaction_history_id_type() )
-             node = nullptr;
-          else node = &node->next(db);
-       }
-       if( stop.instance.value == 0 && result.size() < limit ) {
-          auto head = db.find(account_transaction_history_id_type());
-          if (head != nullptr && head->account == account && head->operation_id(db).op.which() == operation_type)
-            result.push_back(head->operation_id(db));
+          --itr;
+          // stop is exclusive, except that operation 0 is included when no stop is given
+          if( itr->operation_id.instance.value <= stop.instance.value && stop.instance.value != 0 )
+             break;
+          result.push_back( itr->operation_id(db) );
        }
        return result;
     }
@@ -450,6 +477,8 @@ namespace graphene { namespace app {
        try {
           account = database_api.get_account_id_from_string(account_id_or_name);
        } catch(...) { return result; }
+       if( const auto* store = find_history_store( _app ) )
+          return store->get_relative_account_history( account, start, stop, limit );
        const auto& stats = account(db).statistics(db);
        if( start == 0 )
           start = stats.total_ops;
@@ -255,6 +255,11 @@ void application_impl::initialize(const fc::path& data_dir, shared_ptr<boost::pr
       _force_validate = true;
    }
 
+   if( _options->count("p2p-transaction-batch-size") > 0 )
+      _trx_batch_size = std::max<uint32_t>( 1, _options->at("p2p-transaction-batch-size").as<uint32_t>() );
+   if( _options->count("p2p-transaction-batch-latency-ms") > 0 )
+      _trx_batch_latency = fc::milliseconds( _options->at("p2p-transaction-batch-latency-ms").as<uint32_t>() );
+
    if ( _options->count("enable-subscribe-to-all") > 0 )
       _app_options.enable_subscribe_to_all = _options->at( "enable-subscribe-to-all" ).as<bool>();
 
@@ -498,6 +503,68 @@ void application_impl::open_chain_database() const
       _chain_db->enable_standby_votes_tracking( _options->at("enable-standby-votes-tracking").as<bool>() );
    }
 
+   if( _options->count("incremental-vote-tally") > 0 )
+   {
+      _chain_db->enable_incremental_vote_tally( _options->at("incremental-vote-tally").as<bool>() );
+   }
+
+   if( _options->count("vote-tally-partition-size") > 0 )
+   {
+      _chain_db->set_vote_tally_partition_size( _options->at("vote-tally-partition-size").as<uint32_t>() );
+   }
+
+   if( _options->count("enable-mapped-block-reads") > 0 )
+   {
+      _chain_db->enable_mapped_block_reads( _options->at("enable-mapped-block-reads").as<bool>() );
+   }
+
+   if( _options->count("enable-transaction-id-index") > 0 )
+   {
+      _chain_db->enable_transaction_location_index( _options->at("enable-transaction-id-index").as<bool>() );
+   }
+
+   if( _options->count("signature-cache-size") > 0 )
+   {
+      _chain_db->set_signature_cache_size( _options->at("signature-cache-size").as<uint32_t>() );
+   }
+
+   if( _options->count("enable-incremental-object-db-checkpoints") > 0 )
+   {
+      uint32_t max_deltas = 16;
+      if( _options->count("object-db-max-checkpoint-deltas") > 0 )
+         max_deltas = _options->at("object-db-max-checkpoint-deltas").as<uint32_t>();
+      _chain_db->enable_incremental_checkpoints(
+            _options->at("enable-incremental-object-db-checkpoints").as<bool>(), max_deltas );
+   }
+
+   if( _options->count("object-db-max-changed-objects") > 0 )
+   {
+      _chain_db->set_max_changed_objects( _options->at("object-db-max-changed-objects").as<uint64_t>() );
+   }
+
+   if( _options->count("object-db-checkpoint-interval") > 0 )
+   {
+      const uint32_t interval = _options->at("object-db-checkpoint-interval").as<uint32_t>();
+      if( interval > 0 && !_chain_db->incremental_checkpoints_enabled() )
+         wlog( "object-db-checkpoint-interval is set without enable-incremental-object-db-checkpoints, "
+               "every ${n} blocks the whole object database is written to disk while blocks wait to be applied",
+               ("n", interval) );
+      _chain_db->set_object_db_checkpoint_interval( interval );
+   }
+
+   {
+      graphene::chain::replay_pipeline_options replay_options;
+      if( _options->count("replay-read-batch-size") > 0 )
+         replay_options.read_batch_size = _options->at("replay-read-batch-size").as<uint32_t>();
+      if( _options->count("replay-read-queue-size") > 0 )
+         replay_options.read_queue_size = _options->at("replay-read-queue-size").as<uint32_t>();
+      if( _options->count("replay-deserialize-queue-size") > 0 )
+         replay_options.deserialize_queue_size = _options->at("replay-deserialize-queue-size").as<uint32_t>();
+      if( _options->count("replay-precompute-queue-size") > 0 )
+         replay_options.precompute_queue_size = _options->at("replay-precompute-queue-size").as<uint32_t>();
+      _chain_db->set_replay_pipeline_options( replay_options );
+   }
+
    if( _options->count("replay-blockchain") > 0 || _options->count("revalidate-blockchain") > 0 )
       _chain_db->wipe( _data_dir / "blockchain", false );
 
@@ -628,16 +695,37 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
    try {
       const uint32_t skip = (_is_block_producer || _force_validate) ?
                                database::skip_nothing : database::skip_transaction_signatures;
-      bool result = valve.do_serial( [this,&blk_msg,skip] () {
-         _chain_db->precompute_parallel( blk_msg.block, skip ).wait();
-      }, [this,&blk_msg,skip] () {
+      // a sync block may have been precomputed already while earlier blocks were applied
+      std::shared_ptr<prepared_sync_block> prepared;
+      auto prepared_itr = _prepared_sync_blocks.find( blk_msg.block_id );
+      if( prepared_itr != _prepared_sync_blocks.end() )
+      {
+         prepared = prepared_itr->second;
+         _prepared_sync_blocks.erase( prepared_itr );
+      }
+      const signed_block& block = prepared ? *prepared->block : blk_msg.block;
+      bool result = valve.do_serial( [this,&block,&prepared,skip] () {
+         if( prepared )
+            prepared->precomputed.wait();
+         else
+            _chain_db->precompute_parallel( block, skip ).wait();
+      }, [this,&block,skip] () {
          // TODO: in the case where this block is valid but on a fork that's too old for us to switch to,
          // you can help the network code out by throwing a block_older_than_undo_history exception.
          // when the net code sees that, it will stop trying to push blocks from that chain, but
          // leave that peer connected so that they can get sync blocks from us
-         return _chain_db->push_block( blk_msg.block, skip );
+         return _chain_db->push_block( block, skip );
       });
 
+      const uint32_t head_block_num = _chain_db->head_block_num();
+      for( auto itr = _prepared_sync_blocks.begin(); itr != _prepared_sync_blocks.end(); )
+      {
+         if( itr->second->block->block_num() <= head_block_num )
+            itr = _prepared_sync_blocks.erase( itr );
+         else
+            ++itr;
+      }
+
       // the block was accepted, so we now know all of the transactions contained in the block
       if (!sync_mode)
       {
@@ -646,12 +734,28 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
          // happens, there's no reason to fetch the transactions, so  construct a list of the
          // transaction message ids we no longer need.
          // during sync, it is unlikely that we'll see any old
+         // The ids of transactions received from the network are known already, the others are hashed from
+         // their serialization, which equals the one of their trx_message.
          contained_transaction_msg_ids.reserve( contained_transaction_msg_ids.size()
                                                     + blk_msg.block.transactions.size() );
          for (const processed_transaction& ptrx : blk_msg.block.transactions)
          {
-            graphene::net::trx_message transaction_message(ptrx);
-            contained_transaction_msg_ids.emplace_back(graphene::net::message(transaction_message).id());
+            auto itr = _received_trx_messages.find( ptrx.id() );
+            if( itr != _received_trx_messages.end() && itr->second.signatures == ptrx.signatures )
+               contained_transaction_msg_ids.emplace_back( itr->second.message_id );
+            else
+               contained_transaction_msg_ids.emplace_back(
+                     fc::ripemd160::hash( static_cast<const graphene::protocol::signed_transaction&>( ptrx ) ) );
+            if( itr != _received_trx_messages.end() )
+               _received_trx_messages.erase( itr );
+         }
+         const fc::time_point_sec now = _chain_db->head_block_time();
+         for( auto itr = _received_trx_messages.begin(); itr != _received_trx_messages.end(); )
+         {
+            if( itr->second.expiration < now )
+               itr = _received_trx_messages.erase( itr );
+            else
+               ++itr;
          }
       }
 
@@ -674,7 +778,48 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
    }
 } FC_CAPTURE_AND_RETHROW( (blk_msg)(sync_mode) ) return false; }
 
-void application_impl::handle_transaction(const graphene::net::trx_message& transaction_message)
+void application_impl::prepare_sync_block(const graphene::net::block_message& blk_msg)
+{
+   if( blk_msg.block.block_num() <= _chain_db->head_block_num()
+         || _prepared_sync_blocks.find( blk_msg.block_id ) != _prepared_sync_blocks.end() )
+      return;
+   const uint32_t skip = (_is_block_producer || _force_validate) ?
+                            database::skip_nothing : database::skip_transaction_signatures;
+   if( _prepared_sync_blocks.size() >= _max_prepared_sync_blocks )
+   {
+      // drop the oldest block whose precomputation is done, a running one still refers to the database
+      auto oldest = _prepared_sync_blocks.end();
+      for( auto itr = _prepared_sync_blocks.begin(); itr != _prepared_sync_blocks.end(); ++itr )
+      {
+         if( itr->second->precomputed.ready()
+               && ( oldest == _prepared_sync_blocks.end() || itr->second->sequence < oldest->second->sequence ) )
+            oldest = itr;
+      }
+      if( oldest == _prepared_sync_blocks.end() )
+         return;
+      _prepared_sync_blocks.erase( oldest );
+   }
+   auto prepared = std::make_shared<prepared_sync_block>();
+   auto block = std::make_shared<const signed_block>( blk_msg.block );
+   prepared->block = block;
+   prepared->sequence = _next_prepared_sync_block++;
+   prepared->precomputed = fc::async( [this,block,skip] () {
+      _chain_db->precompute_parallel( *block, skip ).wait();
+   }, "prepare sync block" );
+   _prepared_sync_blocks[blk_msg.block_id] = prepared;
+}
+
+void application_impl::remember_trx_message_id(const graphene::protocol::precomputable_transaction& trx,
+                                               const graphene::net::message_hash_type& message_id)
+{
+   auto& entry = _received_trx_messages[trx.id()];
+   entry.message_id = message_id;
+   entry.signatures = trx.signatures;
+   entry.expiration = trx.expiration;
+}
+
+void application_impl::handle_transaction(const graphene::net::trx_message& transaction_message,
+                                          const graphene::net::message_hash_type& message_id)
 { try {
    static fc::time_point last_call;
    static int trx_count = 0;
@@ -686,10 +831,93 @@ void application_impl::handle_transaction(const graphene::net::trx_message& tran
       trx_count = 0;
    }
 
-   _chain_db->precompute_parallel( transaction_message.trx ).wait();
-   _chain_db->push_transaction( transaction_message.trx );
+   // The p2p node only relays the transaction if we return without an exception, so wait for the result here.
+   // The node hands every transaction to us in its own task, so this does not hold up the messages of the peer.
+   // All transactions go through the queue, also when batching is disabled, so that they are pushed in the order
+   // they were received even though their tasks yield while waiting.
+   auto result = fc::promise<void>::create( "application::handle_transaction" );
+   _trx_ingest_queue.push_back( { transaction_message.trx, message_id, result, now } );
+   if( _trx_batch_full && _trx_ingest_queue.size() >= _trx_batch_size && !_trx_batch_full->ready() )
+      _trx_batch_full->set_value();
+   if( !_trx_ingest_done.valid() || _trx_ingest_done.ready() )
+      _trx_ingest_done = fc::async( [this]() { ingest_transactions(); }, "ingest p2p transactions" );
+   fc::future<void>( result ).wait();
 } FC_CAPTURE_AND_RETHROW( (transaction_message) ) }
 
+void application_impl::ingest_transactions()
+{
+   std::vector<graphene::chain::precomputable_transaction> batch;
+   std::vector<graphene::net::message_hash_type> message_ids;
+   std::vector<fc::promise<void>::ptr> results;
+   while( !_trx_ingest_queue.empty() )
+   {
+      if( _trx_ingest_queue.size() < _trx_batch_size && _trx_batch_latency.count() > 0 )
+      {
+         _trx_batch_full = fc::promise<void>::create( "application::trx_batch_full" );
+         try
+         {
+            _trx_batch_full->wait_until( _trx_ingest_queue.front().received + _trx_batch_latency );
+         }
+         catch( const fc::timeout_exception& )
+         {
+            // send what we have
+         }
+         _trx_batch_full.reset();
+      }
+
+      const size_t count = std::min<size_t>( _trx_batch_size, _trx_ingest_queue.size() );
+      batch.clear();
+      message_ids.clear();
+      results.clear();
+      batch.reserve( count );
+      message_ids.reserve( count );
+      results.reserve( count );
+      for( size_t i = 0; i < count; ++i )
+      {
+         batch.push_back( std::move( _trx_ingest_queue.front().trx ) );
+         message_ids.push_back( _trx_ingest_queue.front().message_id );
+         results.push_back( std::move( _trx_ingest_queue.front().result ) );
+         _trx_ingest_queue.pop_front();
+      }
+
+      try
+      {
+         _chain_db->precompute_batch( batch.data(), batch.size() );
+      }
+      catch( const fc::canceled_exception& e )
+      {
+         for( auto& result : results )
+            result->set_exception( e.dynamic_copy_exception() );
+         throw;
+      }
+      catch( const fc::exception& )
+      {
+         // Some transaction is invalid. Whatever was not precomputed is done while pushing, which also reports
+         // the error to the right sender.
+      }
+
+      for( size_t i = 0; i < count; ++i )
+      {
+         try
+         {
+            _chain_db->push_transaction( batch[i] );
+            remember_trx_message_id( batch[i], message_ids[i] );
+            results[i]->set_value();
+         }
+         catch( const fc::canceled_exception& e )
+         {
+            for( size_t j = i; j < count; ++j )
+               results[j]->set_exception( e.dynamic_copy_exception() );
+            throw;
+         }
+         catch( const fc::exception& e )
+         {
+            results[i]->set_exception( e.dynamic_copy_exception() );
+         }
+      }
+   }
+}
+
 void application_impl::handle_message(const message& message_to_process)
 {
    // not a transaction, not a block
@@ -1042,6 +1270,28 @@ void application_impl::shutdown()
    else
       ilog( "P2P network is disabled" );
 
+   if( _trx_ingest_done.valid() && !_trx_ingest_done.ready() )
+   {
+      ilog( "Stopping P2P transaction ingestion" );
+      _trx_ingest_done.cancel_and_wait( "application shutdown" );
+   }
+   for( auto& queued : _trx_ingest_queue )
+      queued.result->set_exception( std::make_shared<fc::canceled_exception>() );
+   _trx_ingest_queue.clear();
+
+   // the precomputation of prepared sync blocks refers to the database
+   for( auto& prepared : _prepared_sync_blocks )
+   {
+      try
+      {
+         prepared.second->precomputed.wait();
+      }
+      catch( const fc::exception& )
+      {
+      }
+   }
+   _prepared_sync_blocks.clear();
+
    if( _chain_db )
    {
       ilog( "Closing chain database" );
@@ -1119,11 +1369,18 @@ void application::set_program_options(boost::program_options::options_descriptio
                                       boost::program_options::options_description& configuration_file_options) const
 {
    const auto& default_opts = application_options::get_default();
+   const graphene::chain::replay_pipeline_options default_replay_opts;
    configuration_file_options.add_options()
          ("enable-p2p-network", bpo::value<bool>()->implicit_value(true),
           "Whether to enable P2P network. Note: if delayed_node plugin is enabled, "
           "this option will be ignored and P2P network will always be disabled.")
          ("p2p-endpoint", bpo::value<string>(), "Endpoint for P2P node to listen on")
+         ("p2p-transaction-batch-size", bpo::value<uint32_t>()->default_value(256),
+          "Maximum number of transactions received from the P2P network whose signatures are checked together "
+          "on the parallel threads before they are pushed in arrival order. 1 to handle them one at a time")
+         ("p2p-transaction-batch-latency-ms", bpo::value<uint32_t>()->default_value(0),
+          "Time in milliseconds a transaction received from the P2P network may wait for others to fill its batch. "
+          "With 0, transactions that arrive while a batch is being processed form the next batch")
          ("seed-node,s", bpo::value<vector<string>>()->composing(),
           "P2P nodes to connect to on startup (may specify multiple times)")
          ("seed-nodes", bpo::value<string>()->composing(),
@@ -1151,6 +1408,47 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("enable-standby-votes-tracking", bpo::value<bool>()->implicit_value(true),
           "Whether to enable tracking of votes of standby witnesses and committee members. "
           "Set it to true to provide accurate data to API clients, set to false for slightly better performance.")
+         ("incremental-vote-tally", bpo::value<bool>()->implicit_value(true),
+          "Whether to keep the vote tally between maintenance intervals and only recompute the votes of accounts "
+          "that changed, instead of tallying the votes of all accounts on every maintenance (default true)")
+         ("vote-tally-partition-size", bpo::value<uint32_t>()->default_value(0),
+          "Number of accounts whose votes each thread tallies during a full vote tally, 0 to split the accounts "
+          "evenly across the threads in partitions of at least 10000 accounts")
+         ("enable-mapped-block-reads", bpo::value<bool>()->implicit_value(true),
+          "Whether to memory-map the block log for reading, so that block queries from API threads "
+          "do not serialize on a shared file stream")
+         ("enable-transaction-id-index", bpo::value<bool>()->implicit_value(true),
+          "Whether to maintain a persistent index of transaction IDs to their block number and position, "
+          "required by the get_transaction_by_id API")
+         ("signature-cache-size",
+          bpo::value<uint32_t>()->default_value(graphene::protocol::signature_cache::default_max_entries),
+          "Number of public keys recovered from transaction signatures to keep cached, so that transactions "
+          "already seen do not have their signatures checked again when they arrive in a block. 0 to disable")
+         ("enable-incremental-object-db-checkpoints", bpo::value<bool>()->implicit_value(true),
+          "Whether to save only the objects changed since the last save when writing the object database "
+          "to disk, as deltas on top of the last full snapshot. Speeds up shutdown and restart of nodes "
+          "with large databases.")
+         ("object-db-max-checkpoint-deltas", bpo::value<uint32_t>()->default_value(16),
+          "Number of incremental object database checkpoints after which a full snapshot is written")
+         ("object-db-max-changed-objects", bpo::value<uint64_t>()->default_value(1000000),
+          "Number of changed objects after which an incremental object database checkpoint is written early, "
+          "to bound the memory used to track them. 0 means no limit")
+         ("object-db-checkpoint-interval", bpo::value<uint32_t>()->default_value(0),
+          "Number of blocks after which the object database and the undo history of the reversible blocks are "
+          "saved to disk, so that a node restarting after a crash only replays the blocks since the last save. "
+          "Without incremental object database checkpoints every save writes the whole database while blocks "
+          "wait to be applied. 0 to save on shutdown only")
+         ("replay-read-batch-size", bpo::value<uint32_t>()->default_value(default_replay_opts.read_batch_size),
+          "Number of blocks read from disk at once while replaying the blockchain")
+         ("replay-read-queue-size", bpo::value<uint32_t>()->default_value(default_replay_opts.read_queue_size),
+          "Maximum number of blocks being read ahead from disk while replaying the blockchain")
+         ("replay-deserialize-queue-size",
+          bpo::value<uint32_t>()->default_value(default_replay_opts.deserialize_queue_size),
+          "Maximum number of blocks waiting to be or being unpacked while replaying the blockchain")
+         ("replay-precompute-queue-size",
+          bpo::value<uint32_t>()->default_value(default_replay_opts.precompute_queue_size),
+          "Maximum number of blocks waiting for or in signature and transaction precomputation "
+          "while replaying the blockchain")
          ("api-limit-get-account-history-operations",
           bpo::value<uint64_t>()->default_value(default_opts.api_limit_get_account_history_operations),
           "For history_api::get_account_history_operations to set max limit value")
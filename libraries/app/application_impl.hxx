@@ -3,10 +3,13 @@
 #include <fc/network/http/websocket.hpp>
 #include <fc/thread/parallel.hpp>
 
+#include <deque>
+
 #include <graphene/app/application.hpp>
 #include <graphene/app/api_access.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/protocol/types.hpp>
+#include <graphene/net/config.hpp>
 #include <graphene/net/message.hpp>
 
 namespace graphene { namespace app { namespace detail {
@@ -65,7 +68,25 @@ class application_impl : public net::node_delegate, public std::enable_shared_fr
       bool handle_block(const graphene::net::block_message& blk_msg, bool sync_mode,
                         std::vector<graphene::net::message_hash_type>& contained_transaction_msg_ids) override;
 
-      void handle_transaction(const graphene::net::trx_message& transaction_message) override;
+      void handle_transaction(const graphene::net::trx_message& transaction_message,
+                              const graphene::net::message_hash_type& message_id) override;
+
+      /**
+       * Starts precomputing a sync block received ahead of the blocks being handled, @ref handle_block pushes
+       * the prepared copy once the block is due.
+       */
+      void prepare_sync_block(const graphene::net::block_message& blk_msg) override;
+
+      /// Remembers the message id of a transaction accepted from the network for @ref handle_block
+      void remember_trx_message_id(const graphene::protocol::precomputable_transaction& trx,
+                                   const graphene::net::message_hash_type& message_id);
+
+      /**
+       * Drains @ref _trx_ingest_queue: takes up to @ref _trx_batch_size queued transactions at a time,
+       * precomputes them together on the parallel threads, then pushes them to the chain database in the
+       * order they were received and reports each result back to its @ref handle_transaction call.
+       */
+      void ingest_transactions();
 
       void handle_message(const graphene::net::message& message_to_process) override;
 
@@ -225,6 +246,52 @@ class application_impl : public net::node_delegate, public std::enable_shared_fr
       bool _is_finished_syncing = false;
 
       fc::serial_valve valve;
+
+      /// A transaction received from the p2p network, waiting to be batched by @ref ingest_transactions
+      struct queued_transaction
+      {
+         graphene::protocol::precomputable_transaction trx;
+         graphene::net::message_hash_type              message_id;
+         fc::promise<void>::ptr                        result;
+         fc::time_point                                received;
+      };
+      std::deque<queued_transaction> _trx_ingest_queue;
+      /// Running @ref ingest_transactions task, if any
+      fc::future<void>               _trx_ingest_done;
+      /// Set while @ref ingest_transactions waits for a batch to fill up
+      fc::promise<void>::ptr         _trx_batch_full;
+      /// Maximum number of transactions precomputed together, 1 disables batching
+      uint32_t                       _trx_batch_size = 256;
+      /// How long the oldest queued transaction may wait for others to join its batch
+      fc::microseconds               _trx_batch_latency;
+
+      /// A copy of a sync block whose precomputation was started by @ref prepare_sync_block
+      struct prepared_sync_block
+      {
+         /// Shared with the precomputation task, which must not own the future it is stored in
+         std::shared_ptr<const graphene::protocol::signed_block> block;
+         fc::future<void>                 precomputed;
+         /// Order in which the blocks were prepared, the oldest ones are dropped first
+         uint64_t                         sequence = 0;
+      };
+      /// Prepared sync blocks by block id, entries are dropped when the chain has passed their block number
+      std::map<graphene::protocol::block_id_type, std::shared_ptr<prepared_sync_block>> _prepared_sync_blocks;
+      /// Sequence number of the next prepared sync block
+      uint64_t                       _next_prepared_sync_block = 0;
+      /// Maximum number of prepared sync blocks, blocks of abandoned forks are never passed by the chain
+      size_t                         _max_prepared_sync_blocks = 2 * graphene::net::MAX_SYNC_BLOCKS_TO_PREPARE;
+
+      /// The message id a transaction accepted from the network was received with
+      struct received_trx_message
+      {
+         graphene::net::message_hash_type message_id;
+         /// The signatures are part of the message but not of the transaction id
+         vector<graphene::protocol::signature_type> signatures;
+         fc::time_point_sec               expiration;
+      };
+      /// Message ids of the transactions accepted from the network by transaction id, entries are dropped when
+      /// the transaction is included in a block or has expired
+      std::map<graphene::protocol::transaction_id_type, received_trx_message> _received_trx_messages;
    };
 
 }}} // namespace graphene namespace app namespace detail
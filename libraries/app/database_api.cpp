@@ -212,7 +212,7 @@ optional<block_header> database_api::get_block_header(uint32_t block_num)const
 
 optional<block_header> database_api_impl::get_block_header(uint32_t block_num) const
 {
-   auto result = _db.fetch_block_by_number(block_num);
+   auto result = _db.fetch_block_header_by_number(block_num);
    if(result)
       return *result;
    return {};
@@ -270,6 +270,32 @@ optional<signed_transaction> database_api_impl::get_recent_transaction_by_id(con
    }
 }
 
+optional<located_transaction> database_api::get_transaction_by_id( const transaction_id_type& id )const
+{
+   return my->get_transaction_by_id( id );
+}
+
+optional<located_transaction> database_api_impl::get_transaction_by_id( const transaction_id_type& id )const
+{
+   auto location = _db.find_transaction_location( id );
+   if( !location.valid() )
+      return optional<located_transaction>();
+
+   // The index is not rewound when blocks are popped, so check the location against the current chain
+   auto opt_block = _db.fetch_block_by_number( location->block_num );
+   if( !opt_block.valid() || opt_block->transactions.size() <= location->trx_in_block )
+      return optional<located_transaction>();
+   const auto& trx = opt_block->transactions[location->trx_in_block];
+   if( trx.id() != id )
+      return optional<located_transaction>();
+
+   located_transaction result;
+   result.block_num = location->block_num;
+   result.trx_in_block = location->trx_in_block;
+   result.trx = trx;
+   return result;
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Globals                                                          //
@@ -1779,6 +1805,25 @@ uint64_t database_api_impl::get_witness_count()const
    return _db.get_index_type<witness_index>().indices().size();
 }
 
+vector<witness_object> database_api::get_top_witnesses( uint32_t limit )const
+{
+   return my->get_top_witnesses( limit );
+}
+
+vector<witness_object> database_api_impl::get_top_witnesses( uint32_t limit )const
+{
+   FC_ASSERT( _app_options, "Internal error" );
+   const auto configured_limit = _app_options->api_limit_lookup_witness_accounts;
+   FC_ASSERT( limit <= configured_limit,
+              "limit can not be greater than ${configured_limit}",
+              ("configured_limit", configured_limit) );
+
+   vector<witness_object> result;
+   for( const witness_object& witness : _db.get_witness_ranking().top( limit ) )
+      result.push_back( witness );
+   return result;
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Committee members                                                //
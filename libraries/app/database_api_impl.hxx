@@ -57,6 +57,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       optional<signed_block> get_block(uint32_t block_num)const;
       processed_transaction get_transaction( uint32_t block_num, uint32_t trx_in_block )const;
       optional<signed_transaction> get_recent_transaction_by_id(const transaction_id_type& id )const;
+      optional<located_transaction> get_transaction_by_id( const transaction_id_type& id )const;
 
       // Globals
       chain_property_object get_chain_properties()const;
@@ -145,6 +146,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       fc::optional<witness_object> get_witness_by_account(const std::string account_id_or_name)const;
       map<string, witness_id_type> lookup_witness_accounts(const string& lower_bound_name, uint32_t limit)const;
       uint64_t get_witness_count()const;
+      vector<witness_object> get_top_witnesses( uint32_t limit )const;
 
       // Committee members
       vector<optional<committee_member_object>> get_committee_members(
@@ -152,6 +152,13 @@ namespace graphene { namespace app {
       optional<share_type> total_backing_collateral;
    };
 
+   struct located_transaction
+   {
+      uint32_t              block_num    = 0;
+      uint32_t              trx_in_block = 0;
+      processed_transaction trx;
+   };
+
 } }
 
 FC_REFLECT( graphene::app::more_data,
@@ -192,3 +199,5 @@ FC_REFLECT( graphene::app::market_trade, (sequence)(date)(price)(amount)(value)(
 
 FC_REFLECT_DERIVED( graphene::app::extended_asset_object, (graphene::chain::asset_object),
                     (total_in_collateral)(total_backing_collateral) )
+
+FC_REFLECT( graphene::app::located_transaction, (block_num)(trx_in_block)(trx) )
@@ -195,6 +195,15 @@ class database_api
        */
       optional<signed_transaction> get_recent_transaction_by_id( const transaction_id_type& txid )const;
 
+      /**
+       * @brief Get a transaction of the current chain by its ID, no matter how old it is
+       * @param txid hash of the transaction
+       * @return the transaction and its position in the blockchain, or null if it is not included in the chain
+       *
+       * @note This requires the node to run with the @a enable-transaction-id-index option
+       */
+      optional<located_transaction> get_transaction_by_id( const transaction_id_type& txid )const;
+
       /////////////
       // Globals //
       /////////////
@@ -661,6 +670,13 @@ class database_api
        */
       uint64_t get_witness_count()const;
 
+      /**
+       * @brief Get the witnesses with the most votes
+       * @param limit Maximum number of results to return -- must not exceed 1000
+       * @return The witnesses ordered by their votes in the last vote tally, most votes first
+       */
+      vector<witness_object> get_top_witnesses( uint32_t limit )const;
+
       ///////////////////////
       // Committee members //
       ///////////////////////
@@ -990,6 +1006,7 @@ FC_API(graphene::app::database_api,
    (get_block)
    (get_transaction)
    (get_recent_transaction_by_id)
+   (get_transaction_by_id)
 
    // Globals
    (get_chain_properties)
@@ -1052,6 +1069,7 @@ FC_API(graphene::app::database_api,
    (get_witness_by_account)
    (lookup_witness_accounts)
    (get_witness_count)
+   (get_top_witnesses)
 
    // Committee members
    (get_committee_members)
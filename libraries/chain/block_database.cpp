@@ -23,9 +23,15 @@
  */
 #include <graphene/chain/block_database.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
+#include <fc/interprocess/file_mapping.hpp>
 #include <fc/io/raw.hpp>
 #include <boost/endian/buffers.hpp>
 
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+
 namespace graphene { namespace chain {
 
 struct index_entry
@@ -38,29 +44,359 @@ struct index_entry
    boost::endian::little_uint32_buf_t block_size;
    block_id_type                      block_id;
 };
+
+/// Position of the packed header of a block in the headers file, indexed by block number
+struct header_index_entry
+{
+   header_index_entry() {
+      header_pos = 0;
+      header_size = 0;
+      transaction_count = 0;
+   };
+   boost::endian::little_uint64_buf_t header_pos;
+   boost::endian::little_uint32_buf_t header_size;
+   boost::endian::little_uint32_buf_t transaction_count;
+};
+
+/// A read-only mapping of the range [offset, offset + size) of a file
+struct mapped_segment
+{
+   mapped_segment( const fc::file_mapping& mapping, uint64_t offset, uint64_t size )
+   : region( mapping, fc::read_only, offset, size ),
+     data( (const char*)region.get_address() ),
+     offset( offset ),
+     size( size )
+   {}
+
+   fc::mapped_region region;
+   const char*       data;
+   uint64_t          offset;
+   uint64_t          size;
+};
+
+/**
+ * A read-only mapping of a file, covering a whole number of records of @c granularity bytes. It is made of
+ * consecutive segments, so that data appended to the file is mapped without mapping the rest again.
+ */
+struct mapped_file
+{
+   /// Maps @p filename, sharing the segments of @p previous if it is a mapping of the same file
+   mapped_file( const fc::path& filename, uint64_t granularity, const mapped_file* previous )
+   {
+      const uint64_t file_size = fc::file_size( filename );
+      const uint64_t mapped_end = file_size - file_size % granularity;
+      if( previous != nullptr && previous->size <= mapped_end )
+      {
+         mapping = previous->mapping;
+         segments = previous->segments;
+         size = previous->size;
+      }
+      if( mapped_end == size )
+         return;
+      if( !mapping )
+         mapping = std::make_shared<fc::file_mapping>( filename.generic_string().c_str(), fc::read_only );
+      segments.push_back( std::make_shared<mapped_segment>( *mapping, size, mapped_end - size ) );
+      size = mapped_end;
+      // Segments are merged while the newest one is at least as large as the one before it. This keeps their
+      // number logarithmic in the size of the file, and each byte is mapped again only a logarithmic number
+      // of times.
+      while( segments.size() >= 2 && segments.back()->size >= segments[segments.size() - 2]->size )
+      {
+         const uint64_t offset = segments[segments.size() - 2]->offset;
+         segments.pop_back();
+         segments.pop_back();
+         segments.push_back( std::make_shared<mapped_segment>( *mapping, offset, size - offset ) );
+      }
+   }
+
+   /// The mapped data of [pos, pos + count) if it lies within one segment, nullptr otherwise
+   const char* find( uint64_t pos, uint64_t count )const
+   {
+      if( pos + count > size )
+         return nullptr;
+      auto itr = std::upper_bound( segments.begin(), segments.end(), pos,
+            []( uint64_t p, const std::shared_ptr<const mapped_segment>& s ) { return p < s->offset; } );
+      if( itr == segments.begin() )
+         return nullptr;
+      const mapped_segment& segment = **( itr - 1 );
+      if( pos + count > segment.offset + segment.size )
+         return nullptr;
+      return segment.data + ( pos - segment.offset );
+   }
+
+   /// Copies [pos, pos + count) to @p dest, returns false if it is not mapped
+   bool read( uint64_t pos, char* dest, uint64_t count )const
+   {
+      if( pos + count > size )
+         return false;
+      while( count > 0 )
+      {
+         auto itr = std::upper_bound( segments.begin(), segments.end(), pos,
+               []( uint64_t p, const std::shared_ptr<const mapped_segment>& s ) { return p < s->offset; } );
+         const mapped_segment& segment = **( itr - 1 );
+         const uint64_t part = std::min( count, segment.offset + segment.size - pos );
+         memcpy( dest, segment.data + ( pos - segment.offset ), part );
+         dest += part;
+         pos += part;
+         count -= part;
+      }
+      return true;
+   }
+
+   std::shared_ptr<const fc::file_mapping>            mapping;
+   std::vector< std::shared_ptr<const mapped_segment> > segments;
+   uint64_t                                           size = 0;
+};
+
+/**
+ * An immutable read-only view of the block database files as they were at the time of mapping.
+ * The blocks and headers files are append-only, so everything inside the mapped range never changes.
+ * Index entries can still be rewritten in place on fork switches, readers of the mapped index check
+ * block_database::_index_write_sequence to detect that. The files are only truncated on open, before
+ * anything is mapped.
+ */
+struct mapped_block_files
+{
+   /// Maps the files, only mapping what was appended since @p previous if it is not null
+   mapped_block_files( const fc::path& index_file, const fc::path& blocks_file,
+                       const fc::path& header_index_file, const fc::path& headers_file,
+                       const mapped_block_files* previous )
+   : index( index_file, sizeof(index_entry), previous ? &previous->index : nullptr ),
+     blocks( blocks_file, 1, previous ? &previous->blocks : nullptr ),
+     header_index( header_index_file, sizeof(header_index_entry), previous ? &previous->header_index : nullptr ),
+     headers( headers_file, 1, previous ? &previous->headers : nullptr )
+   {}
+
+   const mapped_file index;
+   const mapped_file blocks;
+   const mapped_file header_index;
+   const mapped_file headers;
+};
+
+/// Set in index_entry::block_size if the block is stored inside a chunk starting at block_pos
+static const uint32_t chunked_entry_flag = 0x80000000u;
+static const uint32_t chunk_magic = 0x4b4e4843u; // "CHNK"
+
+enum chunk_codec : uint32_t
+{
+   chunk_codec_zlib = 1
+};
+
+/**
+ * Precedes every chunk in the chunked blocks file. It is followed by @c block_count little-endian
+ * 32-bit offsets of the blocks within the uncompressed payload, and then by the compressed payload.
+ */
+struct chunk_header
+{
+   boost::endian::little_uint32_buf_t magic;
+   boost::endian::little_uint32_buf_t codec;
+   boost::endian::little_uint32_buf_t first_block_num;
+   boost::endian::little_uint32_buf_t block_count;
+   boost::endian::little_uint32_buf_t uncompressed_size;
+   boost::endian::little_uint32_buf_t compressed_size;
+};
+
+/// A decompressed chunk
+struct block_chunk
+{
+   uint32_t         first_block_num = 0;
+   vector<uint32_t> offsets; ///< block_count + 1 entries, the last one is the payload size
+   vector<char>     data;
+};
+
+/// Number of decompressed chunks kept in memory, enough for sequential reads by a few threads
+static const size_t chunk_cache_size = 8;
+
+/// Upper limit of a single read of adjacent blocks in fetch_packed_range
+static const uint64_t max_range_read_size = 64 * 1024 * 1024;
+
+/// Marks a rewrite of index entries for readers of the mapped index, the writer must hold the lock of the database
+class index_write_section
+{
+   public:
+      explicit index_write_section( std::atomic<uint64_t>& sequence ) : _sequence( sequence )
+      {
+         _sequence.fetch_add( 1, std::memory_order_relaxed );
+         std::atomic_thread_fence( std::memory_order_release );
+      }
+      ~index_write_section()
+      {
+         _sequence.fetch_add( 1, std::memory_order_release );
+      }
+
+   private:
+      std::atomic<uint64_t>& _sequence;
+};
+
  }}
 FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
+FC_REFLECT( graphene::chain::header_index_entry, (header_pos)(header_size)(transaction_count) );
 
 namespace graphene { namespace chain {
 
-void block_database::open( const fc::path& dbdir )
+void block_database::open( const fc::path& dbdir, block_log_format format_if_new )
 { try {
    fc::create_directories(dbdir);
-   _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-   _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+   {
+      std::lock_guard<std::mutex> guard( _lock );
+      unmap();
+      _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+      _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+      _header_index.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+      _headers.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+
+      if( fc::exists( dbdir / "chunked_index" ) )
+         _format = block_log_format::chunked;
+      else if( fc::exists( dbdir / "index" ) )
+         _format = block_log_format::raw;
+      else
+         _format = format_if_new;
+
+      // the chunked format uses different file names so that older versions do not misinterpret it
+      if( _format == block_log_format::chunked )
+      {
+         ilog( "Opening chunked block log, new blocks are stored uncompressed until it is converted again "
+               "with block_converter" );
+         _index_filename = dbdir / "chunked_index";
+         _blocks_filename = dbdir / "chunked_blocks";
+      }
+      else
+      {
+         _index_filename = dbdir / "index";
+         _blocks_filename = dbdir / "blocks";
+      }
+      if( !fc::exists( _index_filename ) )
+      {
+        _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+        _blocks.open( _blocks_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+      }
+      else
+      {
+        _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+        _blocks.open( _blocks_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+      }
+
+      _header_index_filename = dbdir / "header_index";
+      _headers_filename = dbdir / "headers";
+      if( !fc::exists( _header_index_filename ) || !fc::exists( _headers_filename ) )
+      {
+        _header_index.open( _header_index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+        _headers.open( _headers_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+      }
+      else
+      {
+        _header_index.open( _header_index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+        _headers.open( _headers_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+      }
+
+      _blocks_read_pos = 0;
+      {
+         std::lock_guard<std::mutex> cache_guard( _chunk_cache_lock );
+         _chunk_cache.clear();
+      }
+   }
+
+   truncate_index();
+   build_header_index();
+
+   std::lock_guard<std::mutex> guard( _lock );
+   if( _use_mapped_reads )
+      remap();
+} FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
-   _index_filename = dbdir / "index";
-   if( !fc::exists( _index_filename ) )
+void block_database::truncate_index()
+{
+   int64_t index_size;
    {
-     _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+      std::lock_guard<std::mutex> guard( _lock );
+      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+      index_size = _block_num_to_pos.tellg();
    }
-   else
+
+   int64_t pos = index_size - index_size % sizeof(index_entry);
+   while( pos > 0 )
    {
-     _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+      index_entry e;
+      if( read_index_entry( uint32_t( pos / sizeof(index_entry) ) - 1, e ) && e.block_size.value() > 0 )
+      {
+         try
+         {
+            // read_block() verifies the block id
+            read_block( e );
+            break;
+         }
+         catch (const fc::exception&)
+         {
+         }
+         catch (const std::exception&)
+         {
+         }
+      }
+      pos -= sizeof(index_entry);
    }
-} FC_CAPTURE_AND_RETHROW( (dbdir) ) }
+   if( pos == index_size )
+      return;
+
+   wlog( "Dropping ${n} bytes at the end of ${f} which do not refer to stored blocks",
+         ("n", index_size - pos)("f", _index_filename) );
+   std::lock_guard<std::mutex> guard( _lock );
+   _block_num_to_pos.flush();
+   fc::resize_file( _index_filename, pos );
+}
+
+void block_database::build_header_index()
+{
+   uint32_t first_missing;
+   uint32_t end;
+   {
+      std::lock_guard<std::mutex> guard( _lock );
+      _header_index.seekg( 0, _header_index.end );
+      first_missing = uint32_t( int64_t( _header_index.tellg() ) / sizeof(header_index_entry) );
+      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+      end = uint32_t( int64_t( _block_num_to_pos.tellg() ) / sizeof(index_entry) );
+   }
+   if( first_missing >= end )
+      return;
+
+   ilog( "Building block header index for blocks ${first} to ${last}", ("first", first_missing)("last", end - 1) );
+   for( uint32_t block_num = std::max( first_missing, 1u ); block_num < end; ++block_num )
+   {
+      index_entry e;
+      if( !read_index_entry( block_num, e ) || e.block_size.value() == 0 )
+         continue;
+      try
+      {
+         const signed_block block = read_block( e );
+         std::lock_guard<std::mutex> guard( _lock );
+         store_header( block_num, block );
+      }
+      catch (const fc::exception&)
+      {
+         // unreadable blocks are left out, header queries fall back to the block
+      }
+      catch (const std::exception&)
+      {
+      }
+      if( block_num % 1000000 == 0 )
+         ilog( "   ${i} of ${n}", ("i", block_num)("n", end - 1) );
+   }
+   std::lock_guard<std::mutex> guard( _lock );
+   _headers.flush();
+   _header_index.flush();
+}
+
+void block_database::store_header( uint32_t block_num, const signed_block& b )
+{
+   auto vec = fc::raw::pack( static_cast<const signed_block_header&>( b ) );
+   header_index_entry e;
+   _headers.seekp( 0, _headers.end );
+   e.header_pos = _headers.tellp();
+   e.header_size = uint32_t( vec.size() );
+   e.transaction_count = uint32_t( b.transactions.size() );
+   _headers.write( vec.data(), vec.size() );
+   _header_index.seekp( sizeof( header_index_entry ) * int64_t(block_num) );
+   _header_index.write( (char*)&e, sizeof(e) );
+}
 
 bool block_database::is_open()const
 {
@@ -69,14 +405,25 @@ bool block_database::is_open()const
 
 void block_database::close()
 {
+  std::lock_guard<std::mutex> guard( _lock );
+  unmap();
   _blocks.close();
   _block_num_to_pos.close();
+  _headers.close();
+  _header_index.close();
+  std::lock_guard<std::mutex> cache_guard( _chunk_cache_lock );
+  _chunk_cache.clear();
 }
 
 void block_database::flush()
 {
+  std::lock_guard<std::mutex> guard( _lock );
   _blocks.flush();
   _block_num_to_pos.flush();
+  _headers.flush();
+  _header_index.flush();
+  if( _use_mapped_reads )
+     remap();
 }
 
 void block_database::store( const block_id_type& _id, const signed_block& b )
@@ -87,19 +434,36 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
       id = b.id();
       elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
    }
-   _block_num_to_pos.seekp( sizeof( index_entry ) * int64_t(block_header::num_from_id(id)) );
-   index_entry e;
-   _blocks.seekp( 0, _blocks.end );
    auto vec = fc::raw::pack( b );
-   e.block_pos  = _blocks.tellp();
-   e.block_size = vec.size();
-   e.block_id   = id;
-   _blocks.write( vec.data(), vec.size() );
-   _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   FC_ASSERT( vec.size() < chunked_entry_flag, "Block ${id} is too large to be stored", ("id", id) );
+
+   std::lock_guard<std::mutex> guard( _lock );
+   {
+      index_write_section section( _index_write_sequence );
+      _block_num_to_pos.seekp( sizeof( index_entry ) * int64_t(block_header::num_from_id(id)) );
+      index_entry e;
+      _blocks.seekp( 0, _blocks.end );
+      e.block_pos  = _blocks.tellp();
+      e.block_size = vec.size();
+      e.block_id   = id;
+      _blocks.write( vec.data(), vec.size() );
+      _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      store_header( block_header::num_from_id(id), b );
+
+      if( _use_mapped_reads )
+      {
+         // the entries may overwrite ones inside the mapped range, make them visible to mapped readers
+         _block_num_to_pos.flush();
+         _header_index.flush();
+      }
+   }
+   if( _use_mapped_reads )
+      remap();
 }
 
 void block_database::remove( const block_id_type& id )
 { try {
+   std::lock_guard<std::mutex> guard( _lock );
    index_entry e;
    int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
    _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
@@ -111,24 +475,150 @@ void block_database::remove( const block_id_type& id )
 
    if( e.block_id == id )
    {
+      index_write_section section( _index_write_sequence );
       e.block_size = 0;
       _block_num_to_pos.seekp( sizeof(e) * int64_t(block_header::num_from_id(id)) );
       _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      if( _use_mapped_reads )
+         _block_num_to_pos.flush();
    }
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
+void block_database::store_chunk( const vector<signed_block>& blocks, int compression_level )
+{ try {
+   FC_ASSERT( _format == block_log_format::chunked, "Chunks can only be stored in the chunked format" );
+   FC_ASSERT( !blocks.empty() );
+
+   const uint32_t first_block_num = blocks.front().block_num();
+   vector<index_entry> entries;
+   vector<boost::endian::little_uint32_buf_t> offsets;
+   entries.reserve( blocks.size() );
+   offsets.reserve( blocks.size() );
+   vector<char> payload;
+   for( const auto& b : blocks )
+   {
+      FC_ASSERT( b.block_num() == first_block_num + entries.size(), "Blocks in a chunk must be consecutive" );
+      auto vec = fc::raw::pack( b );
+      FC_ASSERT( vec.size() < chunked_entry_flag && payload.size() + vec.size() < chunked_entry_flag,
+                 "Chunk is too large" );
+      offsets.emplace_back();
+      offsets.back() = uint32_t( payload.size() );
+      entries.emplace_back();
+      entries.back().block_size = uint32_t( vec.size() ) | chunked_entry_flag;
+      entries.back().block_id = b.id();
+      payload.insert( payload.end(), vec.begin(), vec.end() );
+   }
+
+   uLongf compressed_size = compressBound( payload.size() );
+   vector<char> compressed( compressed_size );
+   const int rc = compress2( (Bytef*)compressed.data(), &compressed_size,
+                             (const Bytef*)payload.data(), payload.size(), compression_level );
+   FC_ASSERT( rc == Z_OK, "Failed to compress chunk: ${rc}", ("rc", rc) );
+
+   chunk_header header;
+   header.magic = chunk_magic;
+   header.codec = chunk_codec_zlib;
+   header.first_block_num = first_block_num;
+   header.block_count = uint32_t( blocks.size() );
+   header.uncompressed_size = uint32_t( payload.size() );
+   header.compressed_size = uint32_t( compressed_size );
+
+   std::lock_guard<std::mutex> guard( _lock );
+   {
+      index_write_section section( _index_write_sequence );
+      _blocks.seekp( 0, _blocks.end );
+      const uint64_t chunk_pos = _blocks.tellp();
+      _blocks.write( (const char*)&header, sizeof(header) );
+      _blocks.write( (const char*)offsets.data(), offsets.size() * sizeof(offsets.front()) );
+      _blocks.write( compressed.data(), compressed_size );
+
+      _block_num_to_pos.seekp( sizeof( index_entry ) * int64_t(first_block_num) );
+      for( auto& e : entries )
+      {
+         e.block_pos = chunk_pos;
+         _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      }
+      for( const auto& b : blocks )
+         store_header( b.block_num(), b );
+
+      if( _use_mapped_reads )
+      {
+         _block_num_to_pos.flush();
+         _header_index.flush();
+      }
+   }
+   if( _use_mapped_reads )
+      remap();
+} FC_CAPTURE_AND_RETHROW( (blocks.size()) ) }
+
+void block_database::convert( const fc::path& src_dir, const fc::path& dst_dir, block_log_format dst_format,
+                              uint32_t blocks_per_chunk, int compression_level )
+{ try {
+   FC_ASSERT( blocks_per_chunk > 0 );
+   FC_ASSERT( fc::exists( src_dir / "index" ) || fc::exists( src_dir / "chunked_index" ),
+              "No block database found in ${d}", ("d", src_dir) );
+   FC_ASSERT( !fc::exists( dst_dir / "index" ) && !fc::exists( dst_dir / "chunked_index" ),
+              "A block database already exists in ${d}", ("d", dst_dir) );
+
+   block_database src;
+   src.open( src_dir );
+   block_database dst;
+   dst.open( dst_dir, dst_format );
+
+   const optional<block_id_type> last_id = src.last_id();
+   const uint32_t last_block_num = last_id.valid() ? block_header::num_from_id( *last_id ) : 0;
+   ilog( "Converting ${n} blocks from ${src} to ${dst}", ("n", last_block_num)("src", src_dir)("dst", dst_dir) );
+
+   vector<signed_block> pending;
+   pending.reserve( blocks_per_chunk );
+   const auto store_pending = [&dst, &pending, compression_level]() {
+      if( pending.empty() )
+         return;
+      dst.store_chunk( pending, compression_level );
+      pending.clear();
+   };
+
+   uint32_t missing = 0;
+   for( uint32_t block_num = 1; block_num <= last_block_num; ++block_num )
+   {
+      optional<signed_block> block = src.fetch_by_number( block_num );
+      if( !block.valid() )
+      {
+         // chunks hold consecutive blocks only
+         store_pending();
+         ++missing;
+         continue;
+      }
+      if( dst_format == block_log_format::chunked )
+      {
+         pending.emplace_back( std::move( *block ) );
+         if( pending.size() >= blocks_per_chunk )
+            store_pending();
+      }
+      else
+         dst.store( block->id(), *block );
+
+      if( block_num % 100000 == 0 )
+         ilog( "   ${i} of ${n}", ("i", block_num)("n", last_block_num) );
+   }
+   store_pending();
+
+   if( missing > 0 )
+      wlog( "${m} blocks were missing in the source database", ("m", missing) );
+   ilog( "Converted ${n} blocks, ${old} bytes before, ${new} bytes after",
+         ("n", last_block_num - missing)("old", src.total_block_size())("new", dst.total_block_size()) );
+   dst.close();
+   src.close();
+} FC_CAPTURE_AND_RETHROW( (src_dir)(dst_dir)(blocks_per_chunk)(compression_level) ) }
+
 bool block_database::contains( const block_id_type& id )const
 {
    if( id == block_id_type() )
       return false;
 
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() < int64_t(index_pos + sizeof(e)) )
+   if( !read_index_entry( block_header::num_from_id(id), e ) )
       return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
    return e.block_id == id && e.block_size.value() > 0;
 }
@@ -137,14 +627,9 @@ block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_num);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_index_entry( block_num, e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
    return e.block_id;
 }
@@ -154,23 +639,12 @@ optional<signed_block> block_database::fetch_optional( const block_id_type& id )
    try
    {
       index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_header::num_from_id(id), e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
       if( e.block_id != id ) return optional<signed_block>();
 
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      if (e.block_size.value())
-         _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      return read_block( e );
    }
    catch (const fc::exception&)
    {
@@ -186,19 +660,136 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    try
    {
       index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_num);
+      if( !read_index_entry( block_num, e ) )
+         return {};
+
+      return read_block( e );
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return optional<signed_block>();
+}
+
+vector<packed_block> block_database::fetch_packed_range( uint32_t first_block_num, uint32_t count )const
+{ try {
+   vector<packed_block> result;
+   if( count == 0 )
+      return result;
+
+   // all index entries of the range with one read, they are verified through the block ids by the caller
+   vector<index_entry> entries;
+   const uint64_t index_pos = sizeof(index_entry) * uint64_t(first_block_num);
+   auto mapping = current_mapping();
+   if( mapping && index_pos + sizeof(index_entry) * uint64_t(count) <= mapping->index.size )
+   {
+      entries.resize( count );
+      if( !read_mapped_index( *mapping, index_pos, (char*)entries.data(), sizeof(index_entry) * entries.size() ) )
+         entries.clear();
+   }
+   if( entries.empty() )
+   {
+      std::lock_guard<std::mutex> guard( _lock );
       _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      const int64_t index_size = _block_num_to_pos.tellg();
+      if( index_size < int64_t(index_pos + sizeof(index_entry)) )
+         return result;
+      entries.resize( std::min<uint64_t>( count, ( index_size - index_pos ) / sizeof(index_entry) ) );
+      _block_num_to_pos.seekg( index_pos );
+      _block_num_to_pos.read( (char*)entries.data(), sizeof(index_entry) * entries.size() );
+   }
+
+   result.reserve( entries.size() );
+   size_t next = 0;
+   while( next < entries.size() && entries[next].block_size.value() != 0 )
+   {
+      const index_entry& e = entries[next];
+      const uint32_t block_num = first_block_num + uint32_t(next);
+      if( e.block_size.value() & chunked_entry_flag )
+      {
+         const auto chunk = load_chunk( e.block_pos.value() );
+         const size_t slot = block_num - chunk->first_block_num;
+         if( block_num < chunk->first_block_num || slot + 1 >= chunk->offsets.size() )
+            break;
+         packed_block block;
+         block.block_num = block_num;
+         block.block_id = e.block_id;
+         block.block_pos = e.block_pos.value();
+         block.data.assign( chunk->data.data() + chunk->offsets[slot], chunk->data.data() + chunk->offsets[slot + 1] );
+         result.push_back( std::move(block) );
+         _blocks_read_pos = e.block_pos.value();
+         ++next;
+         continue;
+      }
+
+      // extend the read over all following blocks that are stored right behind this one
+      const uint64_t run_begin = e.block_pos.value();
+      uint64_t run_end = run_begin + e.block_size.value();
+      size_t run_last = next + 1;
+      while( run_last < entries.size() && run_end - run_begin < max_range_read_size
+             && entries[run_last].block_size.value() != 0
+             && !( entries[run_last].block_size.value() & chunked_entry_flag )
+             && entries[run_last].block_pos.value() == run_end )
+      {
+         run_end += entries[run_last].block_size.value();
+         ++run_last;
+      }
+
+      vector<char> buffer;
+      const char* run_data = mapping ? mapping->blocks.find( run_begin, run_end - run_begin ) : nullptr;
+      if( run_data == nullptr && mapping && run_end <= mapping->blocks.size )
+      {
+         // the run spans mapped segments
+         buffer.resize( run_end - run_begin );
+         mapping->blocks.read( run_begin, buffer.data(), buffer.size() );
+         run_data = buffer.data();
+      }
+      if( run_data == nullptr )
+      {
+         buffer.resize( run_end - run_begin );
+         std::lock_guard<std::mutex> guard( _lock );
+         _blocks.seekg( run_begin );
+         _blocks.read( buffer.data(), buffer.size() );
+         FC_ASSERT( _blocks.gcount() == int64_t(buffer.size()), "Blocks file ends within block ${n}",
+                    ("n", block_num) );
+         run_data = buffer.data();
+      }
+
+      for( ; next < run_last; ++next )
+      {
+         const index_entry& entry = entries[next];
+         const char* begin = run_data + ( entry.block_pos.value() - run_begin );
+         packed_block block;
+         block.block_num = first_block_num + uint32_t(next);
+         block.block_id = entry.block_id;
+         block.block_pos = entry.block_pos.value();
+         block.data.assign( begin, begin + entry.block_size.value() );
+         result.push_back( std::move(block) );
+      }
+      _blocks_read_pos = run_end;
+   }
+   return result;
+} FC_CAPTURE_AND_RETHROW( (first_block_num)(count) ) }
+
+optional<stored_block_header> block_database::fetch_header_by_number( uint32_t block_num )const
+{
+   try
+   {
+      index_entry e;
+      if( !read_index_entry( block_num, e ) || e.block_size.value() == 0 )
          return {};
 
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+      stored_block_header result;
+      if( read_header( block_num, e.block_id, result ) )
+         return result;
 
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
+      // not in the header index, e.g. after an unclean shutdown, so decode the whole block
+      const signed_block block = read_block( e );
+      result.header = block;
+      result.transaction_count = uint32_t( block.transactions.size() );
       return result;
    }
    catch (const fc::exception&)
@@ -207,7 +798,209 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    catch (const std::exception&)
    {
    }
-   return optional<signed_block>();
+   return optional<stored_block_header>();
+}
+
+bool block_database::read_header( uint32_t block_num, const block_id_type& id, stored_block_header& result )const
+{
+   try
+   {
+      const uint64_t index_pos = sizeof(header_index_entry) * uint64_t(block_num);
+      header_index_entry e;
+      vector<char> data;
+      const char* header_data = nullptr;
+
+      auto mapping = current_mapping();
+      if( mapping && mapping->header_index.read( index_pos, (char*)&e, sizeof(e) ) )
+         header_data = mapping->headers.find( e.header_pos.value(), e.header_size.value() );
+      if( header_data == nullptr )
+      {
+         std::lock_guard<std::mutex> guard( _lock );
+         _header_index.seekg( 0, _header_index.end );
+         if( _header_index.tellg() < int64_t(index_pos + sizeof(e)) )
+            return false;
+         _header_index.seekg( index_pos );
+         _header_index.read( (char*)&e, sizeof(e) );
+         if( e.header_size.value() == 0 )
+            return false;
+         data.resize( e.header_size.value() );
+         _headers.seekg( e.header_pos.value() );
+         _headers.read( data.data(), data.size() );
+         header_data = data.data();
+      }
+      if( e.header_size.value() == 0 )
+         return false;
+
+      fc::datastream<const char*> ds( header_data, e.header_size.value() );
+      fc::raw::unpack( ds, result.header );
+      result.transaction_count = e.transaction_count.value();
+      // a stale or torn entry does not hash to the id of the block in the index
+      return result.header.id() == id;
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return false;
+}
+
+bool block_database::read_index_entry( uint32_t block_num, index_entry& e )const
+{
+   const uint64_t index_pos = sizeof(e) * uint64_t(block_num);
+
+   auto mapping = current_mapping();
+   if( mapping && index_pos + sizeof(e) <= mapping->index.size
+         && read_mapped_index( *mapping, index_pos, (char*)&e, sizeof(e) ) )
+      return true;
+
+   std::lock_guard<std::mutex> guard( _lock );
+   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+   if ( _block_num_to_pos.tellg() < int64_t(index_pos + sizeof(e)) )
+      return false;
+
+   _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
+   _block_num_to_pos.read( (char*)&e, sizeof(e) );
+   return true;
+}
+
+bool block_database::read_mapped_index( const mapped_block_files& mapping, uint64_t pos, char* dest, size_t size )const
+{
+   // a seqlock, the entries are only rewritten while the sequence number is odd
+   const uint64_t sequence = _index_write_sequence.load( std::memory_order_acquire );
+   if( sequence & 1 )
+      return false;
+   if( !mapping.index.read( pos, dest, size ) )
+      return false;
+   std::atomic_thread_fence( std::memory_order_acquire );
+   return _index_write_sequence.load( std::memory_order_relaxed ) == sequence;
+}
+
+signed_block block_database::read_block( const index_entry& e )const
+{
+   const uint64_t block_pos  = e.block_pos.value();
+   const uint32_t block_size = e.block_size.value() & ~chunked_entry_flag;
+
+   if( e.block_size.value() & chunked_entry_flag )
+   {
+      const auto chunk = load_chunk( block_pos );
+      const uint32_t block_num = block_header::num_from_id( e.block_id );
+      FC_ASSERT( block_num >= chunk->first_block_num
+                    && block_num - chunk->first_block_num + 1 < chunk->offsets.size(),
+                 "Block ${n} is not contained in the chunk at ${p}", ("n", block_num)("p", block_pos) );
+      const size_t slot = block_num - chunk->first_block_num;
+      const uint32_t begin = chunk->offsets[slot];
+      const uint32_t end = chunk->offsets[slot + 1];
+      FC_ASSERT( begin <= end && end - begin == block_size, "Corrupt chunk at ${p}", ("p", block_pos) );
+
+      fc::datastream<const char*> ds( chunk->data.data() + begin, block_size );
+      signed_block result;
+      fc::raw::unpack( ds, result );
+      FC_ASSERT( result.id() == e.block_id );
+      _blocks_read_pos = block_pos;
+      return result;
+   }
+
+   auto mapping = current_mapping();
+   const char* mapped_data = ( mapping && block_size > 0 ) ? mapping->blocks.find( block_pos, block_size ) : nullptr;
+   if( mapped_data != nullptr )
+   {
+      try
+      {
+         fc::datastream<const char*> ds( mapped_data, block_size );
+         signed_block result;
+         fc::raw::unpack( ds, result );
+         if( result.id() == e.block_id )
+         {
+            _blocks_read_pos = block_pos + block_size;
+            return result;
+         }
+      }
+      catch (const fc::exception&)
+      {
+         // fall back to the stream
+      }
+   }
+
+   vector<char> data( block_size );
+   {
+      std::lock_guard<std::mutex> guard( _lock );
+      _blocks.seekg( block_pos );
+      if( block_size )
+         _blocks.read( data.data(), block_size );
+      _blocks_read_pos = block_pos + block_size;
+   }
+   auto result = fc::raw::unpack<signed_block>(data);
+   FC_ASSERT( result.id() == e.block_id );
+   return result;
+}
+
+std::shared_ptr<const block_chunk> block_database::load_chunk( uint64_t chunk_pos )const
+{
+   {
+      std::lock_guard<std::mutex> cache_guard( _chunk_cache_lock );
+      for( const auto& item : _chunk_cache )
+         if( item.first == chunk_pos )
+            return item.second;
+   }
+
+   chunk_header header;
+   vector<char> body;
+   const char* body_data = nullptr;
+
+   // chunks are never rewritten, so a mapped chunk can be used without validating against the stream
+   auto mapping = current_mapping();
+   if( mapping && mapping->blocks.read( chunk_pos, (char*)&header, sizeof(header) ) )
+   {
+      FC_ASSERT( header.magic.value() == chunk_magic, "No chunk found at ${p}", ("p", chunk_pos) );
+      const uint64_t body_size = uint64_t(header.block_count.value()) * sizeof(uint32_t)
+                                 + header.compressed_size.value();
+      body_data = mapping->blocks.find( chunk_pos + sizeof(header), body_size );
+   }
+   if( body_data == nullptr )
+   {
+      std::lock_guard<std::mutex> guard( _lock );
+      _blocks.seekg( chunk_pos );
+      _blocks.read( (char*)&header, sizeof(header) );
+      FC_ASSERT( header.magic.value() == chunk_magic, "No chunk found at ${p}", ("p", chunk_pos) );
+      body.resize( uint64_t(header.block_count.value()) * sizeof(uint32_t) + header.compressed_size.value() );
+      _blocks.read( body.data(), body.size() );
+      body_data = body.data();
+   }
+   FC_ASSERT( header.codec.value() == chunk_codec_zlib, "Unsupported chunk codec ${c}", ("c", header.codec.value()) );
+   FC_ASSERT( header.block_count.value() > 0 );
+
+   auto chunk = std::make_shared<block_chunk>();
+   chunk->first_block_num = header.first_block_num.value();
+   const uint32_t block_count = header.block_count.value();
+   const uint32_t uncompressed_size = header.uncompressed_size.value();
+   chunk->offsets.reserve( block_count + 1 );
+   for( uint32_t i = 0; i < block_count; ++i )
+   {
+      boost::endian::little_uint32_buf_t offset;
+      memcpy( (char*)&offset, body_data + i * sizeof(uint32_t), sizeof(uint32_t) );
+      FC_ASSERT( offset.value() <= uncompressed_size
+                    && ( chunk->offsets.empty() || offset.value() >= chunk->offsets.back() ),
+                 "Corrupt offset table in chunk at ${p}", ("p", chunk_pos) );
+      chunk->offsets.push_back( offset.value() );
+   }
+   chunk->offsets.push_back( uncompressed_size );
+
+   chunk->data.resize( uncompressed_size );
+   uLongf data_size = uncompressed_size;
+   const int rc = uncompress( (Bytef*)chunk->data.data(), &data_size,
+                              (const Bytef*)( body_data + block_count * sizeof(uint32_t) ),
+                              header.compressed_size.value() );
+   FC_ASSERT( rc == Z_OK && data_size == uncompressed_size,
+              "Failed to decompress chunk at ${p}: ${rc}", ("p", chunk_pos)("rc", rc) );
+
+   std::shared_ptr<const block_chunk> result = std::move( chunk );
+   std::lock_guard<std::mutex> cache_guard( _chunk_cache_lock );
+   _chunk_cache.emplace_front( chunk_pos, result );
+   if( _chunk_cache.size() > chunk_cache_size )
+      _chunk_cache.pop_back();
+   return result;
 }
 
 optional<index_entry> block_database::last_index_entry()const {
@@ -215,33 +1008,27 @@ optional<index_entry> block_database::last_index_entry()const {
    {
       index_entry e;
 
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      std::streampos pos = _block_num_to_pos.tellg();
+      std::streampos pos;
+      {
+         std::lock_guard<std::mutex> guard( _lock );
+         _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+         pos = _block_num_to_pos.tellg();
+      }
       if( pos < long(sizeof(index_entry)) )
          return optional<index_entry>();
 
       pos -= pos % sizeof(index_entry);
 
-      _blocks.seekg( 0, _block_num_to_pos.end );
-      const std::streampos blocks_size = _blocks.tellg();
+      // entries of removed blocks are skipped, they are dropped from the file on the next open
       while( pos > 0 )
       {
          pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-         if( _block_num_to_pos.gcount() == sizeof(e) && e.block_size.value() > 0
-                && int64_t(e.block_pos.value() + e.block_size.value()) <= blocks_size )
+         if( read_index_entry( uint32_t( pos / sizeof(index_entry) ), e ) && e.block_size.value() > 0 )
             try
             {
-               vector<char> data( e.block_size.value() );
-               _blocks.seekg( e.block_pos.value() );
-               _blocks.read( data.data(), e.block_size.value() );
-               if( _blocks.gcount() == long(e.block_size.value()) )
-               {
-                  const signed_block block = fc::raw::unpack<signed_block>(data);
-                  if( block.id() == e.block_id )
-                     return e;
-               }
+               // read_block() verifies the block id
+               read_block( e );
+               return e;
             }
             catch (const fc::exception&)
             {
@@ -249,7 +1036,6 @@ optional<index_entry> block_database::last_index_entry()const {
             catch (const std::exception&)
             {
             }
-         fc::resize_file( _index_filename, pos );
       }
    }
    catch (const fc::exception&)
@@ -277,13 +1063,53 @@ optional<block_id_type> block_database::last_id()const
 
 size_t block_database::blocks_current_position()const
 {
-   return (size_t)_blocks.tellg();
+   return _blocks_read_pos.load();
 }
 
 size_t block_database::total_block_size()const
 {
+   std::lock_guard<std::mutex> guard( _lock );
    _blocks.seekg( 0, _blocks.end );
    return (size_t)_blocks.tellg();
 }
 
+std::shared_ptr<const mapped_block_files> block_database::current_mapping()const
+{
+   if( !_use_mapped_reads )
+      return std::shared_ptr<const mapped_block_files>();
+   return std::atomic_load( &_mapping );
+}
+
+void block_database::remap()
+{
+   try
+   {
+      _blocks.flush();
+      _block_num_to_pos.flush();
+      _headers.flush();
+      _header_index.flush();
+      const auto previous = std::atomic_load( &_mapping );
+      std::shared_ptr<const mapped_block_files> mapping
+            = std::make_shared<mapped_block_files>( _index_filename, _blocks_filename,
+                                                    _header_index_filename, _headers_filename, previous.get() );
+      std::atomic_store( &_mapping, mapping );
+   }
+   catch (const fc::exception& e)
+   {
+      wlog( "Unable to map block database files, using stream reads: ${e}", ("e", e.to_detail_string()) );
+      unmap();
+   }
+   catch (const std::exception& e)
+   {
+      wlog( "Unable to map block database files, using stream reads: ${e}", ("e", e.what()) );
+      unmap();
+   }
+}
+
+void block_database::unmap()const
+{
+   // readers still holding the previous mapping keep it alive until they are done
+   std::atomic_store( &_mapping, std::shared_ptr<const mapped_block_files>() );
+}
+
 } }
@@ -28,6 +28,7 @@
 #include <graphene/chain/hardfork.hpp>
 
 #include <graphene/chain/block_summary_object.hpp>
+#include <graphene/chain/custom_authority_object.hpp>
 #include <graphene/chain/global_property_object.hpp>
 #include <graphene/chain/operation_history_object.hpp>
 
@@ -82,6 +83,18 @@ optional<signed_block> database::fetch_block_by_number( uint32_t num )const
       return _block_id_to_block.fetch_by_number(num);
 }
 
+optional<signed_block_header> database::fetch_block_header_by_number( uint32_t num )const
+{
+   auto results = _fork_db.fetch_block_by_number(num);
+   if( results.size() == 1 )
+      return signed_block_header( results[0]->data );
+
+   auto stored = _block_id_to_block.fetch_header_by_number(num);
+   if( stored.valid() )
+      return stored->header;
+   return optional<signed_block_header>();
+}
+
 const signed_transaction& database::get_recent_transaction(const transaction_id_type& trx_id) const
 {
    auto& index = get_index_type<transaction_index>().indices().get<by_trx_id>();
@@ -90,6 +103,12 @@ const signed_transaction& database::get_recent_transaction(const transaction_id_
    return itr->trx;
 }
 
+optional<transaction_location> database::find_transaction_location( const transaction_id_type& trx_id )const
+{
+   FC_ASSERT( _trx_locations.is_open(), "The transaction location index is not enabled" );
+   return _trx_locations.find( trx_id );
+}
+
 std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of_fork) const
 {
   pair<fork_database::branch_type, fork_database::branch_type> branches = _fork_db.fetch_branch_from(head_block_id(), head_of_fork);
@@ -124,6 +143,10 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
       [&]()
       {
          result = _push_block(new_block);
+         // the pending transactions are not applied here, so the undo history only contains whole blocks
+         if( ( _object_db_checkpoint_interval > 0 && head_block_num() % _object_db_checkpoint_interval == 0 )
+               || checkpoint_due() )
+            save_object_db_checkpoint();
       });
    });
    return result;
@@ -290,7 +313,7 @@ processed_transaction database::_push_transaction( const precomputable_transacti
    // apply the changes.
 
    auto temp_session = _undo_db.start_undo_session();
-   auto processed_trx = _apply_transaction( trx );
+   auto processed_trx = _apply_transaction( trx, true );
    _pending_tx.push_back(processed_trx);
 
    // notify_changed_objects();
@@ -302,6 +325,16 @@ processed_transaction database::_push_transaction( const precomputable_transacti
    return processed_trx;
 }
 
+void database::prune_pending_authority_checks()
+{
+   if( _pending_authority_checks.size() == 0 )
+      return;
+   std::set<transaction_id_type> pending;
+   for( const auto& tx : _pending_tx )
+      pending.insert( tx.id() );
+   _pending_authority_checks.retain( pending );
+}
+
 processed_transaction database::validate_transaction( const signed_transaction& trx )
 {
    auto session = _undo_db.start_undo_session();
@@ -436,7 +469,7 @@ signed_block database::_generate_block(
       try
       {
          auto temp_session = _undo_db.start_undo_session();
-         processed_transaction ptx = _apply_transaction( tx );
+         processed_transaction ptx = _apply_transaction( tx, true );
 
          // We have to recompute pack_size(ptx) because it may be different
          // than pack_size(tx) (i.e. if one or more results increased
@@ -639,6 +672,13 @@ void database::_apply_block( const signed_block& next_block )
    if( !_node_property_object.debug_updates.empty() )
       apply_debug_updates();
 
+   if( _trx_locations.is_open() )
+   {
+      for( uint32_t i = 0; i < next_block.transactions.size(); ++i )
+         _trx_locations.store( next_block.transactions[i].id(), { next_block_num, i } );
+      _trx_locations.set_head_block_num( next_block_num );
+   }
+
    // notify observers that the block has been applied
    notify_applied_block( next_block ); //emit
    _applied_ops.clear();
@@ -658,7 +698,7 @@ processed_transaction database::apply_transaction(const signed_transaction& trx,
    return result;
 }
 
-processed_transaction database::_apply_transaction(const signed_transaction& trx)
+processed_transaction database::_apply_transaction(const signed_transaction& trx, bool pending)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
 
@@ -677,17 +717,37 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    const chain_parameters& chain_parameters = get_global_properties().parameters;
    eval_state._trx = &trx;
 
-   if( !(skip & skip_transaction_signatures) )
+   const uint32_t max_authority_depth = chain_parameters.max_authority_depth;
+   if( !(skip & skip_transaction_signatures)
+         && !( pending && _pending_authority_checks.is_verified( trx, max_authority_depth ) ) )
    {
+      // a pending transaction remembers the accounts its check looked at, unless it depends on custom
+      // authorities, which may change by time alone
+      bool remember = pending;
+      flat_set<account_id_type> accounts;
       bool allow_non_immediate_owner = true;
-      auto get_active = [this]( account_id_type id ) { return &id(*this).active; };
-      auto get_owner  = [this]( account_id_type id ) { return &id(*this).owner;  };
-      auto get_custom = [this]( account_id_type id, const operation& op, rejected_predicate_map* rejects ) {
+      auto get_active = [this,&remember,&accounts]( account_id_type id ) {
+         if( remember ) accounts.insert( id );
+         return &id(*this).active;
+      };
+      auto get_owner  = [this,&remember,&accounts]( account_id_type id ) {
+         if( remember ) accounts.insert( id );
+         return &id(*this).owner;
+      };
+      auto get_custom = [this,&remember]( account_id_type id, const operation& op, rejected_predicate_map* rejects ) {
+         if( remember )
+         {
+            const auto& by_account = get_index_type<custom_authority_index>().indices().get<by_account_custom>();
+            auto itr = by_account.lower_bound( boost::make_tuple( id ) );
+            remember = ( itr == by_account.end() || itr->account != id );
+         }
          return get_viable_custom_authorities(id, op, rejects);
       };
 
       trx.verify_authority(chain_id, get_active, get_owner, get_custom, allow_non_immediate_owner,
-                           false, get_global_properties().parameters.max_authority_depth);
+                           false, max_authority_depth);
+      if( remember )
+         _pending_authority_checks.add( trx, max_authority_depth, std::move(accounts) );
    }
 
    //Skip all manner of expiration and TaPoS checking if we're on block 1; It's impossible that the transaction is
@@ -808,7 +868,25 @@ void database::_precompute_parallel( const Trx* trx, const size_t count, const u
       if( !(skip&skip_transaction_dupe_check) )
          trx->id();
       if( !(skip&skip_transaction_signatures) )
-         trx->get_signature_keys( get_chain_id() );
+         trx->get_signature_keys( get_chain_id(), _signature_cache );
+   }
+}
+
+template<typename Trx>
+void database::_precompute_chunked( const Trx* trx, const size_t count, const uint32_t skip,
+                                    std::vector<fc::future<void>>& workers )const
+{
+   if( (skip & skip_expensive) == skip_expensive )
+      _precompute_parallel( trx, count, skip );
+   else
+   {
+      uint32_t chunks = fc::asio::default_io_service_scope::get_num_threads();
+      size_t chunk_size = ( count + chunks - 1 ) / chunks;
+      workers.reserve( workers.size() + chunks + 1 );
+      for( size_t base = 0; base < count; base += chunk_size )
+         workers.push_back( fc::do_parallel( [this,trx,base,chunk_size,count,skip] () {
+            _precompute_parallel( trx + base, base + chunk_size < count ? chunk_size : count - base, skip );
+         }) );
    }
 }
 
@@ -816,22 +894,7 @@ fc::future<void> database::precompute_parallel( const signed_block& block, const
 { try {
    std::vector<fc::future<void>> workers;
    if( !block.transactions.empty() )
-   {
-      if( (skip & skip_expensive) == skip_expensive )
-         _precompute_parallel( &block.transactions[0], block.transactions.size(), skip );
-      else
-      {
-         uint32_t chunks = fc::asio::default_io_service_scope::get_num_threads();
-         uint32_t chunk_size = ( block.transactions.size() + chunks - 1 ) / chunks;
-         workers.reserve( chunks + 1 );
-         for( size_t base = 0; base < block.transactions.size(); base += chunk_size )
-            workers.push_back( fc::do_parallel( [this,&block,base,chunk_size,skip] () {
-               _precompute_parallel( &block.transactions[base],
-                                     base + chunk_size < block.transactions.size() ? chunk_size : block.transactions.size() - base,
-                                     skip );
-            }) );
-      }
-   }
+      _precompute_chunked( &block.transactions[0], block.transactions.size(), skip, workers );
 
    if( !(skip&skip_witness_signature) )
       workers.push_back( fc::do_parallel( [&block] () { block.signee(); } ) );
@@ -849,6 +912,17 @@ fc::future<void> database::precompute_parallel( const signed_block& block, const
    return *first;
 } FC_LOG_AND_RETHROW() }
 
+void database::precompute_serial( const signed_block& block, const uint32_t skip )const
+{
+   if( !block.transactions.empty() )
+      _precompute_parallel( &block.transactions[0], block.transactions.size(), skip );
+   if( !(skip&skip_witness_signature) )
+      block.signee();
+   if( !(skip&skip_merkle_check) )
+      block.calculate_merkle_root();
+   block.id();
+}
+
 fc::future<void> database::precompute_parallel( const precomputable_transaction& trx )const
 {
    return fc::do_parallel([this,&trx] () {
@@ -856,4 +930,32 @@ fc::future<void> database::precompute_parallel( const precomputable_transaction&
    });
 }
 
+void database::precompute_batch( const precomputable_transaction* trxs, const size_t count )const
+{
+   std::vector<fc::future<void>> workers;
+   if( count > 0 )
+      _precompute_chunked( trxs, count, skip_nothing, workers );
+
+   // wait for all chunks even if one fails, the caller is free to touch the transactions afterwards
+   fc::exception_ptr error;
+   for( auto& worker : workers )
+   {
+      try
+      {
+         worker.wait();
+      }
+      catch( const fc::canceled_exception& )
+      {
+         throw;
+      }
+      catch( const fc::exception& e )
+      {
+         if( !error )
+            error = e.dynamic_copy_exception();
+      }
+   }
+   if( error )
+      error->dynamic_rethrow_exception();
+}
+
 } }
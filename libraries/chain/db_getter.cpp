@@ -147,4 +147,14 @@ const witness_schedule_object& database::get_witness_schedule_object()const
    return *_p_witness_schedule_obj;
 }
 
+const vote_ranking_index<witness_object>& database::get_witness_ranking()const
+{
+   return *_witness_ranking;
+}
+
+const vote_ranking_index<committee_member_object>& database::get_committee_member_ranking()const
+{
+   return *_committee_member_ranking;
+}
+
 } }
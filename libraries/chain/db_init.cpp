@@ -151,24 +151,32 @@ void database::initialize_indexes()
 {
    reset_indexes();
    _undo_db.set_max_size( GRAPHENE_MIN_UNDO_HISTORY );
+   _vote_tally.reset();
+   _pending_authority_checks.clear();
 
    //Protocol object indexes
    add_index< primary_index<asset_index, 13> >(); // 8192 assets per chunk
    add_index< primary_index<force_settlement_index> >();
 
-   add_index< primary_index<account_index, 20> >(); // ~1 million accounts per chunk
-   add_index< primary_index<committee_member_index, 8> >(); // 256 members per chunk
-   add_index< primary_index<witness_index, 10> >(); // 1024 witnesses per chunk
+   auto acnt_index = add_index< primary_index<account_index, 20> >(); // ~1 million accounts per chunk
+   acnt_index->add_secondary_index<vote_tally_account_observer>( &_vote_tally );
+   acnt_index->add_secondary_index<pending_authority_account_observer>( &_pending_authority_checks );
+   auto cm_index = add_index< primary_index<committee_member_index, 8> >(); // 256 members per chunk
+   _committee_member_ranking = cm_index->add_secondary_index< vote_ranking_index<committee_member_object> >();
+   auto wit_index = add_index< primary_index<witness_index, 10> >(); // 1024 witnesses per chunk
+   _witness_ranking = wit_index->add_secondary_index< vote_ranking_index<witness_object> >();
    add_index< primary_index<limit_order_index > >();
    add_index< primary_index<call_order_index > >();
    add_index< primary_index<proposal_index > >();
    add_index< primary_index<withdraw_permission_index > >();
-   add_index< primary_index<vesting_balance_index> >();
+   auto vbal_index = add_index< primary_index<vesting_balance_index> >();
+   vbal_index->add_secondary_index<vote_tally_vesting_observer>( &_vote_tally );
    add_index< primary_index<worker_index> >();
    add_index< primary_index<balance_index> >();
    add_index< primary_index<ico_balance_index> >();
    add_index< primary_index< htlc_index> >();
-   add_index< primary_index< custom_authority_index> >();
+   auto custom_auth_index = add_index< primary_index< custom_authority_index> >();
+   custom_auth_index->add_secondary_index<pending_authority_custom_observer>( &_pending_authority_checks );
    add_index< primary_index<ticket_index> >();
 
    //Implementation object indexes
@@ -180,7 +188,8 @@ void database::initialize_indexes()
    add_index< primary_index<asset_bitasset_data_index,                 13 > >(); // 8192
    add_index< primary_index<simple_index<global_property_object          >> >();
    add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
-   add_index< primary_index<account_stats_index,                       20 > >(); // 1 Mi
+   auto stats_index = add_index< primary_index<account_stats_index,    20 > >(); // 1 Mi
+   stats_index->add_secondary_index<vote_tally_stats_observer>( &_vote_tally );
    add_index< primary_index<simple_index<asset_dynamic_data_object       >> >();
    add_index< primary_index<simple_index<block_summary_object            >> >();
    add_index< primary_index<simple_index<chain_property_object          > > >();
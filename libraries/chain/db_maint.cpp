@@ -25,6 +25,7 @@
  */
 
 #include <fc/uint128.hpp>
+#include <fc/thread/parallel.hpp>
 
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/fba_accumulator_id.hpp>
@@ -46,35 +47,15 @@
 #include <graphene/chain/witness_object.hpp>
 #include <graphene/chain/worker_object.hpp>
 #include <graphene/chain/custom_authority_object.hpp>
+#include <graphene/chain/parallel_blocking.hpp>
 
 namespace graphene { namespace chain {
 
-template<class Index>
-vector<std::reference_wrapper<const typename Index::object_type>> database::sort_votable_objects(size_t count) const
-{
-   using ObjectType = typename Index::object_type;
-   const auto& all_objects = get_index_type<Index>().indices();
-   count = std::min(count, all_objects.size());
-   vector<std::reference_wrapper<const ObjectType>> refs;
-   refs.reserve(all_objects.size());
-   std::transform(all_objects.begin(), all_objects.end(),
-                  std::back_inserter(refs),
-                  [](const ObjectType& o) { return std::cref(o); });
-   std::partial_sort(refs.begin(), refs.begin() + count, refs.end(),
-                   [this](const ObjectType& a, const ObjectType& b)->bool {
-      share_type oa_vote = _vote_tally_buffer[a.vote_id];
-      share_type ob_vote = _vote_tally_buffer[b.vote_id];
-      if( oa_vote != ob_vote )
-         return oa_vote > ob_vote;
-      return a.vote_id < b.vote_id;
-   });
-
-   refs.resize(count, refs.front());
-   return refs;
-}
+/// Unless a partition size is set, voters are only split across threads in partitions of at least this many accounts
+static const size_t vote_tally_min_partition_size = 10000;
 
 template<class Type>
-void database::perform_account_maintenance(Type tally_helper)
+void database::perform_account_maintenance(Type& tally_helper)
 {
    const auto& bal_idx = get_index_type< account_balance_index >().indices().get< by_maintenance_flag >();
    if( bal_idx.begin() != bal_idx.end() )
@@ -96,6 +77,34 @@ void database::perform_account_maintenance(Type tally_helper)
       }
    }
 
+   if( tally_helper.is_incremental() )
+   {
+      // Only visit the accounts which changed since the last maintenance, in the same order as below.
+      // Processing fees may change accounts which come later, those are visited too.
+      auto worklist = tally_helper.take_worklist();
+      tally_helper.verify_unchanged( worklist );
+      while( !worklist.empty() )
+      {
+         const string cursor = worklist.begin()->first;
+         const account_object& acc_obj = get( worklist.begin()->second );
+         worklist.erase( worklist.begin() );
+         const account_statistics_object& acc_stat = acc_obj.statistics( *this );
+
+         if( acc_stat.has_some_core_voting() )
+            tally_helper.update_voter( acc_obj, acc_stat );
+         else
+            tally_helper.remove_voter( acc_obj.id );
+
+         if( acc_stat.has_pending_fees() )
+            acc_stat.process_fees( acc_obj, *this );
+
+         tally_helper.requeue_changed( cursor, worklist );
+      }
+
+      tally_helper.tally();
+      return;
+   }
+
    const auto& stats_idx = get_index_type< account_stats_index >().indices().get< by_maintenance_seq >();
    auto stats_itr = stats_idx.lower_bound( true );
 
@@ -106,12 +115,13 @@ void database::perform_account_maintenance(Type tally_helper)
       ++stats_itr;
 
       if( acc_stat.has_some_core_voting() )
-         tally_helper( acc_obj, acc_stat );
+         tally_helper.add_voter( acc_obj, acc_stat );
 
       if( acc_stat.has_pending_fees() )
          acc_stat.process_fees( acc_obj, *this );
    }
 
+   tally_helper.tally();
 }
 
 /// @brief A visitor for @ref worker_type which calls pay_worker on the worker within
@@ -252,7 +262,8 @@ void database::update_active_witnesses()
    witness_count = std::max( witness_count*2+1, (size_t)cpo.immutable_parameters.min_witness_count );
    // R-Squared: limit witnesses top list to max 63
    witness_count = std::min( witness_count, static_cast<size_t>(gpo.parameters.rsquared_witnesses_top_max));
-   auto wits = sort_votable_objects<witness_index>( witness_count );
+   _witness_ranking->update( _vote_tally_buffer );
+   auto wits = _witness_ranking->top( witness_count );
 
    // R-Squared: Get accounts of top witnesses
    vector<account_id_type> wits_acc;
@@ -418,7 +429,8 @@ void database::update_active_committee_members()
    const chain_property_object& cpo = get_chain_properties();
 
    committee_member_count = std::max( committee_member_count*2+1, (size_t)cpo.immutable_parameters.min_committee_member_count );
-   auto committee_members = sort_votable_objects<committee_member_index>( committee_member_count );
+   _committee_member_ranking->update( _vote_tally_buffer );
+   auto committee_members = _committee_member_ranking->top( committee_member_count );
 
    auto update_committee_member_total_votes = [this]( const committee_member_object& cm ) {
       modify( cm, [this]( committee_member_object& obj )
@@ -975,6 +987,18 @@ namespace detail {
          stake_to_subtract /= GRAPHENE_100_PERCENT;
          return stake - static_cast<uint64_t>(stake_to_subtract);
       }
+
+      // return the earliest time at which get_recalced_voting_stake returns a different value for last_vote_time
+      time_point_sec get_next_recalc_time( const time_point_sec last_vote_time,
+                                           const vote_recalc_times& recalc_times ) const
+      {
+         if( last_vote_time <= recalc_times.zero_power_time )
+            return time_point_sec::maximum();
+         if( last_vote_time > recalc_times.full_power_time )
+            return last_vote_time + full_power_seconds;
+         uint32_t diff = recalc_times.full_power_time.sec_since_epoch() - last_vote_time.sec_since_epoch();
+         return last_vote_time + full_power_seconds + ( diff / seconds_per_step + 1 ) * seconds_per_step;
+      }
    };
 
    const vote_recalc_options vote_recalc_options::witness()
@@ -1008,11 +1032,39 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
    create_buyback_orders(*this);
 
    struct vote_tally_helper {
+      /// An account whose stake is tallied, see @ref add_voter
+      struct voter
+      {
+         const account_object*            stake_account;
+         const account_statistics_object* stats;
+         uint64_t                         cashback_balance;
+      };
+
+      /// Tally of a partition of the voters, merged into the database buffers by @ref tally
+      struct tally_buffers
+      {
+         vector<uint64_t>                vote_tally;
+         vector<uint64_t>                cm_vote_for_worker;
+         vector<vector<account_id_type>> cm_support_worker;
+         vector<uint64_t>                witness_count_histogram;
+         vector<uint64_t>                committee_count_histogram;
+         uint64_t                        total_voting_stake[2] = { 0, 0 };
+         /// Contributions of the voters of the partition, kept for the incremental tally
+         vector<voter_contribution>      contributions;
+      };
+
       database& d;
       const global_property_object& props;
       const dynamic_global_property_object& dprops;
       const time_point_sec now;
       const bool pob_activated;
+      const vote_tally_parameters params;
+
+      vote_tally_tracker& tracker;
+      /// Whether to keep the contributions of the voters for the incremental tally of the next maintenance
+      const bool track_contributions;
+      /// Whether only the voters which changed since the last maintenance are tallied
+      const bool incremental;
 
       optional<detail::vote_recalc_times> witness_recalc_times;
       optional<detail::vote_recalc_times> committee_recalc_times;
@@ -1021,10 +1073,20 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
 
       vector<account_id_type> committee_members;
 
+      vector<voter> voters;
+
+      /// Votes of the committee members, which are tallied anew on every incremental maintenance
+      tally_buffers committee_buffers;
+
       vote_tally_helper( database& db )
          : d(db), props( d.get_global_properties() ), dprops( d.get_dynamic_global_properties() ),
            now( d.head_block_time() ),
-           pob_activated( dprops.total_pob > 0 || dprops.total_inactive > 0 )
+           pob_activated( dprops.total_pob > 0 || dprops.total_inactive > 0 ),
+           params{ pob_activated, props.parameters.count_non_member_votes,
+                   props.parameters.maximum_witness_count, props.parameters.maximum_committee_count },
+           tracker( d._vote_tally ),
+           track_contributions( d._incremental_vote_tally ),
+           incremental( track_contributions && tracker.is_synced( dprops.next_maintenance_time, params ) )
       {
          d._vote_tally_buffer.resize( props.next_available_vote_id, 0 );
          d._cm_vote_for_worker_buffer.resize( props.next_available_vote_id, 0 );
@@ -1051,16 +1113,239 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
             ilog( "         - ${n}", ("n", c(d).name) );
          }
          */
+
+         // the tally is out of sync until the maintenance completes, see mark_synced
+         tracker.invalidate();
+         tracker.stop_recording();
+         if( !incremental )
+            tracker.clear_changes();
+         if( !track_contributions )
+            tracker.reset_tally( {}, {}, {}, { 0, 0 } );
+      }
+
+      bool is_incremental()const { return incremental; }
+
+      /// Queues an account for @ref tally. Its cashback is read now, because processing the fees of accounts
+      /// visited later may deposit into it.
+      void add_voter( const account_object& stake_account, const account_statistics_object& stats )
+      {
+         voters.push_back( make_voter( stake_account, stats ) );
+      }
+
+      voter make_voter( const account_object& stake_account, const account_statistics_object& stats )const
+      {
+         const uint64_t cashback = stake_account.cashback_vb.valid()
+                                   ? (*stake_account.cashback_vb)(d).balance.amount.value : 0;
+         return { &stake_account, &stats, cashback };
+      }
+
+      /// Collects the accounts whose contribution may have changed since the last maintenance, keyed by name to
+      /// visit them in the same order as the full tally does
+      std::map<string, account_id_type> take_worklist()
+      {
+         tracker.resize( props.next_available_vote_id );
+         committee_buffers.cm_vote_for_worker.resize( props.next_available_vote_id, 0 );
+         committee_buffers.cm_support_worker.resize( props.next_available_vote_id );
+
+         std::set<account_id_type> changed = tracker.take_changed( now );
+         // the committee member votes are not kept by the tracker
+         changed.insert( committee_members.begin(), committee_members.end() );
+         std::map<string, account_id_type> worklist;
+         for( account_id_type account : changed )
+         {
+            const account_object* stake_account = d.find( account );
+            if( stake_account != nullptr )
+               worklist.emplace( stake_account->name, account );
+            else
+               tracker.update_contribution( account, voter_contribution() );
+         }
+         tracker.start_recording();
+         return worklist;
+      }
+
+      /// Asserts that the stored contributions of the voters which are not in @p worklist are still valid
+      void verify_unchanged( const std::map<string, account_id_type>& worklist )const
+      {
+         if( !d._verify_vote_tally )
+            return;
+         tally_buffers unused;
+         const auto& stats_idx = d.get_index_type< account_stats_index >().indices().get< by_maintenance_seq >();
+         for( auto itr = stats_idx.lower_bound( true ); itr != stats_idx.end(); ++itr )
+         {
+            if( !itr->has_some_core_voting() || worklist.count( itr->name ) > 0 )
+               continue;
+            const voter_contribution expected = tally_voter( make_voter( itr->owner( d ), *itr ), unused );
+            const voter_contribution* stored = tracker.find_contribution( itr->owner );
+            FC_ASSERT( stored != nullptr ? *stored == expected : expected.empty(),
+                       "Incremental vote tally is stale for account ${a}", ("a", itr->name) );
+         }
+         for( const auto& item : tracker.contributions() )
+         {
+            const account_object& stake_account = item.first( d );
+            FC_ASSERT( worklist.count( stake_account.name ) > 0
+                       || stake_account.statistics( d ).has_some_core_voting(),
+                       "Incremental vote tally counts non-voting account ${a}", ("a", stake_account.name) );
+         }
+      }
+
+      /// Recomputes the contribution of a voter of the incremental tally
+      void update_voter( const account_object& stake_account, const account_statistics_object& stats )
+      {
+         tracker.update_contribution( stake_account.id,
+                                      tally_voter( make_voter( stake_account, stats ), committee_buffers ) );
+      }
+
+      /// Removes the contribution of an account which no longer votes from the incremental tally
+      void remove_voter( account_id_type account )
+      {
+         tracker.update_contribution( account, voter_contribution() );
+      }
+
+      /// Adds the accounts changed while processing fees which come after @p cursor to @p worklist
+      void requeue_changed( const string& cursor, std::map<string, account_id_type>& worklist )
+      {
+         for( account_id_type account : tracker.take_recorded() )
+         {
+            const account_object* stake_account = d.find( account );
+            if( stake_account != nullptr && stake_account->name > cursor )
+               worklist.emplace( stake_account->name, account );
+         }
       }
 
-      void operator()( const account_object& stake_account, const account_statistics_object& stats )
+      /// Called when the maintenance completes, so that the next one may tally incrementally
+      void mark_synced()
       {
+         if( track_contributions )
+            tracker.set_synced( d.get_dynamic_global_properties().next_maintenance_time, params );
+      }
+
+      /// Tallies the queued voters in partitions on the parallel threads, then adds the partial results to the
+      /// database buffers in partition order, which gives the same results as tallying them one by one.
+      /// For an incremental tally, copies the tracked totals instead.
+      void tally()
+      {
+         if( incremental )
+         {
+            tally_incremental();
+            return;
+         }
+
+         if( voters.empty() )
+         {
+            if( track_contributions )
+               tracker.reset_tally( d._vote_tally_buffer, d._witness_count_histogram_buffer,
+                                    d._committee_count_histogram_buffer, d._total_voting_stake );
+            return;
+         }
+
+         const size_t threads = std::max<size_t>( 1, fc::asio::default_io_service_scope::get_num_threads() );
+         const size_t partition_size = d._vote_tally_partition_size > 0 ? d._vote_tally_partition_size
+                                       : std::max( vote_tally_min_partition_size,
+                                                   ( voters.size() + threads - 1 ) / threads );
+         const size_t partitions = ( voters.size() + partition_size - 1 ) / partition_size;
+         vector<tally_buffers> results( partitions );
+         auto tally_partition = [this,&results,partition_size]( size_t p ) {
+            tally_buffers& buf = results[p];
+            buf.vote_tally.resize( d._vote_tally_buffer.size(), 0 );
+            buf.cm_vote_for_worker.resize( d._cm_vote_for_worker_buffer.size(), 0 );
+            buf.cm_support_worker.resize( d._cm_support_worker_buffer.size() );
+            buf.witness_count_histogram.resize( d._witness_count_histogram_buffer.size(), 0 );
+            buf.committee_count_histogram.resize( d._committee_count_histogram_buffer.size(), 0 );
+            const size_t end = std::min( voters.size(), ( p + 1 ) * partition_size );
+            if( track_contributions )
+               buf.contributions.reserve( end - p * partition_size );
+            for( size_t i = p * partition_size; i < end; ++i )
+            {
+               voter_contribution contribution = tally_voter( voters[i], buf );
+               add_contribution( contribution, buf );
+               if( track_contributions )
+                  buf.contributions.push_back( std::move( contribution ) );
+            }
+         };
+
+         // maintenance must not be interleaved with other tasks of this thread while the partitions read the
+         // accounts, and all of them have to finish before an error is reported because they refer to this object
+         run_parallel_blocking( partitions, tally_partition );
+
+         for( const tally_buffers& buf : results )
+         {
+            for( size_t i = 0; i < buf.vote_tally.size(); ++i )
+               d._vote_tally_buffer[i] += buf.vote_tally[i];
+            for( size_t i = 0; i < buf.cm_vote_for_worker.size(); ++i )
+               d._cm_vote_for_worker_buffer[i] += buf.cm_vote_for_worker[i];
+            for( size_t i = 0; i < buf.cm_support_worker.size(); ++i )
+               d._cm_support_worker_buffer[i].insert( d._cm_support_worker_buffer[i].end(),
+                                                      buf.cm_support_worker[i].begin(),
+                                                      buf.cm_support_worker[i].end() );
+            for( size_t i = 0; i < buf.witness_count_histogram.size(); ++i )
+               d._witness_count_histogram_buffer[i] += buf.witness_count_histogram[i];
+            for( size_t i = 0; i < buf.committee_count_histogram.size(); ++i )
+               d._committee_count_histogram_buffer[i] += buf.committee_count_histogram[i];
+            d._total_voting_stake[0] += buf.total_voting_stake[0];
+            d._total_voting_stake[1] += buf.total_voting_stake[1];
+         }
+
+         if( track_contributions )
+         {
+            tracker.reset_tally( d._vote_tally_buffer, d._witness_count_histogram_buffer,
+                                 d._committee_count_histogram_buffer, d._total_voting_stake );
+            for( size_t p = 0; p < partitions; ++p )
+            {
+               for( size_t i = 0; i < results[p].contributions.size(); ++i )
+                  tracker.load_contribution( voters[ p * partition_size + i ].stake_account->id,
+                                             std::move( results[p].contributions[i] ) );
+            }
+         }
+         voters.clear();
+      }
+
+      void tally_incremental()
+      {
+         tracker.stop_recording();
+         if( d._verify_vote_tally )
+            tracker.verify_totals();
+
+         const vector<uint64_t>& vote_tally = tracker.vote_tally();
+         std::copy( vote_tally.begin(), vote_tally.begin() + d._vote_tally_buffer.size(),
+                    d._vote_tally_buffer.begin() );
+         d._witness_count_histogram_buffer = tracker.witness_count_histogram();
+         d._committee_count_histogram_buffer = tracker.committee_count_histogram();
+         d._total_voting_stake[0] = tracker.total_voting_stake(0);
+         d._total_voting_stake[1] = tracker.total_voting_stake(1);
+         d._cm_vote_for_worker_buffer = std::move( committee_buffers.cm_vote_for_worker );
+         d._cm_support_worker_buffer = std::move( committee_buffers.cm_support_worker );
+      }
+
+      static void add_contribution( const voter_contribution& contribution, tally_buffers& buf )
+      {
+         for( const auto& vote : contribution.votes )
+            buf.vote_tally[vote.first] += vote.second;
+         if( contribution.witness_count_stake > 0 )
+            buf.witness_count_histogram[contribution.witness_count_offset] += contribution.witness_count_stake;
+         if( contribution.committee_count_stake > 0 )
+            buf.committee_count_histogram[contribution.committee_count_offset]
+                  += contribution.committee_count_stake;
+         buf.total_voting_stake[0] += contribution.total_voting_stake[0];
+         buf.total_voting_stake[1] += contribution.total_voting_stake[1];
+      }
+
+      /// Computes what the stake of a voter adds to the tally. The votes of committee members for workers are
+      /// added to @p buf directly.
+      voter_contribution tally_voter( const voter& v, tally_buffers& buf )const
+      {
+         voter_contribution result;
+         const account_object& stake_account = *v.stake_account;
+         const account_statistics_object& stats = *v.stats;
+
          // PoB activation
          if( pob_activated && stats.total_core_pob == 0 && stats.total_core_inactive == 0 )
-            return;
+            return result;
 
          if( props.parameters.count_non_member_votes || stake_account.is_member( now ) )
          {
+            if( !props.parameters.count_non_member_votes )
+               result.recalc_time = stake_account.membership_expiration_date;
+
             // There may be a difference between the account whose stake is voting and the one specifying opinions.
             // Usually they're the same, but if the stake account has specified a voting_account, that account is the
             // one specifying the opinions.
@@ -1071,7 +1356,7 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
             uint64_t voting_stake[3]; // 0=committee, 1=witness, 2=worker, as in vote_id_type::vote_type
             uint64_t num_committee_voting_stake; // number of committee members
             voting_stake[2] = ( pob_activated ? 0 : stats.total_core_in_orders.value )
-                  + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value: 0)
+                  + v.cashback_balance
                   + stats.core_in_balance.value;
 
             //PoB
@@ -1121,13 +1406,16 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
 
             // Shortcut
             if( voting_stake[2] == 0 )
-               return;
+               return result;
 
             // Recalculate votes
             if( !directly_voting )
             {
                voting_stake[2] = detail::vote_recalc_options::delegator().get_recalced_voting_stake(
                                        voting_stake[2], stats.last_vote_time, *delegator_recalc_times );
+               result.recalc_time = std::min( result.recalc_time,
+                                       detail::vote_recalc_options::delegator().get_next_recalc_time(
+                                             stats.last_vote_time, *delegator_recalc_times ) );
             }
             const account_statistics_object& opinion_account_stats = ( directly_voting ? stats
                                        : opinion_account.statistics( d ) );
@@ -1140,6 +1428,13 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
                voting_stake[0] /= opinion_account.num_committee_voted;
             voting_stake[2] = detail::vote_recalc_options::worker().get_recalced_voting_stake(
                                  voting_stake[2], opinion_account_stats.last_vote_time, *worker_recalc_times );
+            result.recalc_time = std::min( { result.recalc_time,
+                                    detail::vote_recalc_options::witness().get_next_recalc_time(
+                                          opinion_account_stats.last_vote_time, *witness_recalc_times ),
+                                    detail::vote_recalc_options::committee().get_next_recalc_time(
+                                          opinion_account_stats.last_vote_time, *committee_recalc_times ),
+                                    detail::vote_recalc_options::worker().get_next_recalc_time(
+                                          opinion_account_stats.last_vote_time, *worker_recalc_times ) } );
 
             bool is_committee_members = false;
             const account_id_type account = stake_account.id;
@@ -1158,31 +1453,33 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
                if (is_committee_members && type == vote_id_type::vote_type::worker)
                {
                   // Add up only the committee members votes
-                  d._cm_vote_for_worker_buffer[offset] += voting_stake[type];
-                  d._cm_support_worker_buffer[offset].push_back(account);
+                  buf.cm_vote_for_worker[offset] += voting_stake[type];
+                  buf.cm_support_worker[offset].push_back(account);
                }
 
-               d._vote_tally_buffer[offset] += voting_stake[type];
+               if( voting_stake[type] > 0 )
+                  result.votes.emplace_back( offset, voting_stake[type] );
             }
 
             // votes for a number greater than maximum_witness_count are skipped here
             if( voting_stake[1] > 0
                   && opinion_account.options.num_witness <= props.parameters.maximum_witness_count )
             {
-               uint16_t offset = opinion_account.options.num_witness / 2;
-               d._witness_count_histogram_buffer[offset] += voting_stake[1];
+               result.witness_count_offset = opinion_account.options.num_witness / 2;
+               result.witness_count_stake = voting_stake[1];
             }
             // votes for a number greater than maximum_committee_count are skipped here
             if( num_committee_voting_stake > 0
                   && opinion_account.options.num_committee <= props.parameters.maximum_committee_count )
             {
-               uint16_t offset = opinion_account.options.num_committee / 2;
-               d._committee_count_histogram_buffer[offset] += num_committee_voting_stake;
+               result.committee_count_offset = opinion_account.options.num_committee / 2;
+               result.committee_count_stake = num_committee_voting_stake;
             }
 
-            d._total_voting_stake[0] += num_committee_voting_stake;
-            d._total_voting_stake[1] += voting_stake[1];
+            result.total_voting_stake[0] = num_committee_voting_stake;
+            result.total_voting_stake[1] = voting_stake[1];
          }
+         return result;
       }
    } tally_helper(*this);
 
@@ -1263,6 +1560,8 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
       at.clear();
    }
    _cm_support_worker_buffer.clear();
+
+   tally_helper.mark_synced();
 }
 
 void database::maintenance_prng::seed(uint64_t seed)
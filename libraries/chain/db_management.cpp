@@ -33,12 +33,15 @@
 #include <graphene/protocol/fee_schedule.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/thread/parallel.hpp>
+#include <fc/thread/thread.hpp>
 
+#include <atomic>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iostream>
-#include <queue>
-#include <tuple>
 
 namespace graphene { namespace chain {
 
@@ -53,6 +56,60 @@ database::~database()
    clear_pending();
 }
 
+namespace {
+
+/// Work done by one stage of the replay pipeline, updated by the threads of the stage
+struct replay_stage_counter
+{
+   std::atomic<uint64_t> blocks{0};
+   std::atomic<uint64_t> bytes{0};
+};
+
+struct replay_read_batch
+{
+   uint32_t                                           first_block_num = 0;
+   uint32_t                                           count = 0;
+   fc::future< std::shared_ptr< vector<packed_block> > > result;
+};
+
+struct replay_unpacked_block
+{
+   uint32_t                                     block_num = 0;
+   uint64_t                                     block_pos = 0;
+   fc::future< std::shared_ptr<signed_block> >  result;
+};
+
+struct replay_precomputed_block
+{
+   std::shared_ptr<signed_block> block;
+   uint64_t                      block_pos = 0;
+   uint32_t                      skip = 0;
+   fc::future<void>              result;
+};
+
+template<typename Future>
+void wait_ignoring_errors( Future& f )
+{
+   try
+   {
+      if( f.valid() )
+         f.wait();
+   }
+   catch( ... )
+   {
+   }
+}
+
+} // anonymous namespace
+
+void database::set_replay_pipeline_options( const replay_pipeline_options& options )
+{
+   FC_ASSERT( options.read_batch_size > 0 && options.read_queue_size > 0
+              && options.deserialize_queue_size > 0 && options.precompute_queue_size > 0,
+              "Replay queue sizes must be positive" );
+   _replay_options = options;
+}
+
 void database::reindex( fc::path data_dir )
 { try {
    auto last_block = _block_id_to_block.last();
@@ -71,62 +128,207 @@ void database::reindex( fc::path data_dir )
    ilog( "Replaying blocks, starting at ${next}...", ("next",head_block_num() + 1) );
    if( head_block_num() >= undo_point )
    {
-      if( head_block_num() > 0 )
+      // the fork database may have been restored along with the undo history already
+      if( head_block_num() > 0 && !_fork_db.head() )
          _fork_db.start_block( *fetch_block_by_number( head_block_num() ) );
    }
    else
+   {
+      // the blocks up to the undo point are applied without undo history, so a restored one no longer fits
+      _undo_db.clear();
+      _fork_db.reset();
       _undo_db.disable();
+   }
 
    uint32_t skip = node_properties().skip_flags;
 
    size_t total_block_size = _block_id_to_block.total_block_size();
    const auto& gpo = get_global_properties();
-   std::queue< std::tuple< size_t, signed_block, fc::future< void > > > blocks;
-   uint32_t next_block_num = head_block_num() + 1;
-   uint32_t i = next_block_num;
-   while( next_block_num <= last_block_num || !blocks.empty() )
+   const fc::time_point_sec dupe_check_start = last_block->timestamp - gpo.parameters.maximum_time_until_expiration;
+   const replay_pipeline_options options = _replay_options;
+
+   // The pipeline: a dedicated thread reads batches of packed blocks sequentially, the worker pool
+   // unpacks and then precomputes individual blocks, and this thread applies them in order.
+   // Every stage is a queue in block number order, bounded by the limits in the options.
+   fc::thread reader( "replay_reader" );
+   std::deque< replay_read_batch >        read_queue;
+   std::deque< replay_unpacked_block >    unpack_queue;
+   std::deque< replay_precomputed_block > precompute_queue;
+   replay_stage_counter read_counter;
+   replay_stage_counter unpack_counter;
+   replay_stage_counter precompute_counter;
+
+   auto drain = [&]() {
+      for( auto& batch : read_queue )
+         wait_ignoring_errors( batch.result );
+      for( auto& item : unpack_queue )
+         wait_ignoring_errors( item.result );
+      for( auto& item : precompute_queue )
+         wait_ignoring_errors( item.result );
+   };
+
+   uint32_t next_read = head_block_num() + 1;
+   uint32_t end_block_num = last_block_num + 1; // exclusive, lowered if a gap is found
+   uint32_t blocks_reading = 0;
+
+   auto handle_gap = [&]( uint32_t gap_block_num ) {
+      wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", gap_block_num) );
+      // the reader must be idle before blocks are removed
+      for( auto& batch : read_queue )
+         wait_ignoring_errors( batch.result );
+      read_queue.clear();
+      blocks_reading = 0;
+      while( !unpack_queue.empty() && unpack_queue.back().block_num >= gap_block_num )
+      {
+         wait_ignoring_errors( unpack_queue.back().result );
+         unpack_queue.pop_back();
+      }
+      end_block_num = gap_block_num;
+      next_read = end_block_num;
+
+      uint32_t dropped_count = 0;
+      while( true )
+      {
+         fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
+         // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
+         if( !last_id.valid() )
+            break;
+         // we've caught up to the gap
+         if( block_header::num_from_id( *last_id ) < gap_block_num )
+            break;
+         _block_id_to_block.remove( *last_id );
+         dropped_count++;
+      }
+      wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
+   };
+
+   // progress reporting
+   fc::time_point last_report = start;
+   uint64_t reported_read = 0;
+   uint64_t reported_read_bytes = 0;
+   uint64_t reported_unpacked = 0;
+   uint64_t reported_precomputed = 0;
+   uint64_t applied = 0;
+   uint64_t reported_applied = 0;
+   fc::microseconds apply_stalled;
+
+   uint32_t i = next_read;
+   try
    {
-      if( next_block_num <= last_block_num && blocks.size() < 20 )
+      while( i < end_block_num )
       {
-         const size_t processed_block_size = _block_id_to_block.blocks_current_position();
-         fc::optional< signed_block > block = _block_id_to_block.fetch_by_number( next_block_num++ );
-         if( block.valid() )
+         // read stage
+         while( next_read < end_block_num
+                && ( blocks_reading == 0 || blocks_reading + options.read_batch_size <= options.read_queue_size ) )
          {
-            if( block->timestamp >= last_block->timestamp - gpo.parameters.maximum_time_until_expiration )
-               skip &= ~skip_transaction_dupe_check;
-            blocks.emplace( processed_block_size, std::move(*block), fc::future<void>() );
-            std::get<2>(blocks.back()) = precompute_parallel( std::get<1>(blocks.back()), skip );
+            const uint32_t first = next_read;
+            const uint32_t count = std::min( options.read_batch_size, end_block_num - first );
+            replay_read_batch batch;
+            batch.first_block_num = first;
+            batch.count = count;
+            batch.result = reader.async( [this,first,count,&read_counter]() {
+               auto packed = std::make_shared< vector<packed_block> >(
+                                   _block_id_to_block.fetch_packed_range( first, count ) );
+               uint64_t bytes = 0;
+               for( const auto& block : *packed )
+                  bytes += block.data.size();
+               read_counter.blocks += packed->size();
+               read_counter.bytes += bytes;
+               return packed;
+            }, "replay_read" );
+            read_queue.push_back( std::move(batch) );
+            next_read += count;
+            blocks_reading += count;
          }
-         else
+
+         // unpack stage, waits for the reader only if there is nothing else to do
+         while( !read_queue.empty()
+                && ( unpack_queue.empty()
+                     || ( read_queue.front().result.ready()
+                          && unpack_queue.size() + read_queue.front().count <= options.deserialize_queue_size ) ) )
          {
-            wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
-            uint32_t dropped_count = 0;
-            while( true )
+            const auto packed = read_queue.front().result.wait();
+            const uint32_t first = read_queue.front().first_block_num;
+            const uint32_t count = read_queue.front().count;
+            read_queue.pop_front();
+            blocks_reading -= count;
+
+            for( auto& block : *packed )
             {
-               fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
-               // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
-               if( !last_id.valid() )
-                  break;
-               // we've caught up to the gap
-               if( block_header::num_from_id( *last_id ) <= i )
-                  break;
-               _block_id_to_block.remove( *last_id );
-               dropped_count++;
+               auto data = std::make_shared<packed_block>( std::move(block) );
+               replay_unpacked_block item;
+               item.block_num = data->block_num;
+               item.block_pos = data->block_pos;
+               item.result = fc::do_parallel( [data,&unpack_counter]() {
+                  auto result = std::make_shared<signed_block>();
+                  fc::datastream<const char*> ds( data->data.data(), data->data.size() );
+                  fc::raw::unpack( ds, *result );
+                  FC_ASSERT( result->id() == data->block_id, "Block does not match the id in the index" );
+                  ++unpack_counter.blocks;
+                  unpack_counter.bytes += data->data.size();
+                  return result;
+               }, "replay_unpack" );
+               unpack_queue.push_back( std::move(item) );
+            }
+            if( packed->size() < count )
+            {
+               handle_gap( first + uint32_t( packed->size() ) );
+               break;
             }
-            wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
-            next_block_num = last_block_num + 1; // don't load more blocks
          }
-      }
-      else
-      {
-         std::get<2>(blocks.front()).wait();
-         const signed_block& block = std::get<1>(blocks.front());
+
+         // precompute stage
+         while( !unpack_queue.empty()
+                && ( precompute_queue.empty()
+                     || ( unpack_queue.front().result.ready()
+                          && precompute_queue.size() < options.precompute_queue_size ) ) )
+         {
+            std::shared_ptr<signed_block> block;
+            try
+            {
+               block = unpack_queue.front().result.wait();
+            }
+            catch( const fc::exception& e )
+            {
+               wlog( "Unable to read block ${n}: ${e}", ("n", unpack_queue.front().block_num)("e", e.to_string()) );
+               handle_gap( unpack_queue.front().block_num );
+               break;
+            }
+            if( block->timestamp >= dupe_check_start )
+               skip &= ~skip_transaction_dupe_check;
+
+            replay_precomputed_block item;
+            item.block = block;
+            item.block_pos = unpack_queue.front().block_pos;
+            item.skip = skip;
+            item.result = fc::do_parallel( [this,block,skip,&precompute_counter]() {
+               precompute_serial( *block, skip );
+               ++precompute_counter.blocks;
+            }, "replay_precompute" );
+            unpack_queue.pop_front();
+            precompute_queue.push_back( std::move(item) );
+         }
+
+         if( precompute_queue.empty() )
+            continue; // a gap was found
+
+         // apply stage
+         replay_precomputed_block& item = precompute_queue.front();
+         if( !item.result.ready() )
+         {
+            const auto wait_start = fc::time_point::now();
+            item.result.wait();
+            apply_stalled += fc::time_point::now() - wait_start;
+         }
+         else
+            item.result.wait(); // rethrows errors
+         const signed_block& block = *item.block;
 
          if( i % 10000 == 0 )
          {
             std::stringstream bysize;
             std::stringstream bynum;
-            size_t current_pos = std::get<0>(blocks.front());
+            size_t current_pos = item.block_pos;
             if( current_pos > total_block_size )
                total_block_size = current_pos;
             bysize << std::fixed << std::setprecision(5) << double(current_pos) / total_block_size * 100;
@@ -140,24 +342,67 @@ void database::reindex( fc::path data_dir )
                ("i", i)
                ("last", last_block_num)
             );
+
+            const auto now = fc::time_point::now();
+            const double seconds = std::max( double( (now - last_report).count() ) / 1000000.0, 0.000001 );
+            const uint64_t read = read_counter.blocks.load();
+            const uint64_t read_bytes = read_counter.bytes.load();
+            const uint64_t unpacked = unpack_counter.blocks.load();
+            const uint64_t precomputed = precompute_counter.blocks.load();
+            auto rate = []( uint64_t count, double secs ) { return uint64_t( double(count) / secs ); };
+            std::stringstream stalled;
+            stalled << std::fixed << std::setprecision(1)
+                    << double(apply_stalled.count()) / 10000.0 / seconds;
+            ilog(
+               "   [blocks/s read: ${r} (${rmb} MiB/s)  unpack: ${u}  precompute: ${p}  apply: ${a}]"
+               "   [queued read: ${qr}  unpack: ${qu}  precompute: ${qp}]   [apply stalled: ${st}%]",
+               ("r", rate( read - reported_read, seconds ))
+               ("rmb", rate( read_bytes - reported_read_bytes, seconds ) / ( 1024 * 1024 ))
+               ("u", rate( unpacked - reported_unpacked, seconds ))
+               ("p", rate( precomputed - reported_precomputed, seconds ))
+               ("a", rate( applied - reported_applied, seconds ))
+               ("qr", blocks_reading)
+               ("qu", unpack_queue.size())
+               ("qp", precompute_queue.size())
+               ("st", stalled.str())
+            );
+            last_report = now;
+            reported_read = read;
+            reported_read_bytes = read_bytes;
+            reported_unpacked = unpacked;
+            reported_precomputed = precomputed;
+            reported_applied = applied;
+            apply_stalled = fc::microseconds();
          }
          if( i == undo_point )
          {
             ilog( "Writing database to disk at block ${i}", ("i",i) );
-            flush();
+            checkpoint();
             ilog( "Done" );
          }
+         else if( i < undo_point && checkpoint_due() )
+         {
+            // the set of changed objects would otherwise grow with every block of the replay
+            ilog( "Writing changed objects to disk at block ${i}", ("i",i) );
+            checkpoint();
+         }
          if( i < undo_point )
-            apply_block( block, skip );
+            apply_block( block, item.skip );
          else
          {
             _undo_db.enable();
-            push_block( block, skip );
+            push_block( block, item.skip );
          }
-         blocks.pop();
+         precompute_queue.pop_front();
          i++;
+         applied++;
       }
    }
+   catch( ... )
+   {
+      drain();
+      throw;
+   }
    _undo_db.enable();
    auto end = fc::time_point::now();
    ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
@@ -199,6 +444,8 @@ void database::open(
           version_file.close();
       }
 
+      // the incremental vote tally is kept in memory only, the first maintenance after opening tallies in full
+      _vote_tally.invalidate();
       object_database::open(data_dir);
 
       _block_id_to_block.open(data_dir / "database" / "block_num_to_block");
@@ -215,6 +462,17 @@ void database::open(
          _p_witness_schedule_obj = &get( witness_schedule_id_type() );
       }
 
+      if( _track_trx_locations )
+      {
+         _trx_locations.open( data_dir / "database" / "trx_locations" );
+         // catch up with the blocks that have been applied while the index was disabled
+         if( _trx_locations.head_block_num() < head_block_num() )
+            index_transaction_locations( _trx_locations.head_block_num() + 1, head_block_num() );
+      }
+
+      if( _undo_db.size() > 0 )
+         restore_fork_database();
+
       fc::optional<block_id_type> last_block = _block_id_to_block.last_id();
       if( last_block.valid() )
       {
@@ -228,6 +486,94 @@ void database::open(
    FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
 }
 
+void database::restore_fork_database()
+{
+   try
+   {
+      FC_ASSERT( _undo_db.size() <= head_block_num(), "The undo history is longer than the chain" );
+      // a fork switch after the last save replaced the saved head block and maybe some of its ancestors in the
+      // block log, so undo them back to the common ancestor and let the replay apply the new fork
+      uint32_t popped = 0;
+      while( _undo_db.size() > 0 && !_block_id_to_block.contains( head_block_id() ) )
+      {
+         pop_undo();
+         ++popped;
+      }
+      if( popped > 0 )
+         ilog( "Undid ${n} saved blocks which are no longer in the block log, back to block ${head}",
+               ("n",popped)("head",head_block_num()) );
+      if( _undo_db.size() == 0 )
+         return;
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Unable to undo the saved blocks of an abandoned fork: ${e}", ("e",e.to_detail_string()) );
+      throw;
+   }
+
+   // the undo states belong to the last blocks up to the head block, one state per block
+   const uint32_t head_num = head_block_num();
+   const uint32_t states = uint32_t( _undo_db.size() );
+   try
+   {
+      _fork_db.reset();
+      _fork_db.set_max_size( states + 1 );
+      const uint32_t first = head_num - states;
+      if( first > 0 )
+      {
+         const auto block = fetch_block_by_number( first );
+         FC_ASSERT( block.valid(), "Block ${n} is missing", ("n",first) );
+         _fork_db.start_block( *block );
+      }
+      for( uint32_t num = first + 1; num <= head_num; ++num )
+      {
+         const auto block = fetch_block_by_number( num );
+         FC_ASSERT( block.valid(), "Block ${n} is missing", ("n",num) );
+         _fork_db.push_block( *block );
+      }
+      FC_ASSERT( _fork_db.head() && _fork_db.head()->id == head_block_id(),
+                 "The block log does not contain the head block" );
+      ilog( "Restored undo history and fork database for blocks ${first} to ${head}",
+            ("first",first + 1)("head",head_num) );
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Discarding the restored undo history: ${e}", ("e",e.to_detail_string()) );
+      _undo_db.clear();
+      _fork_db.reset();
+   }
+}
+
+void database::save_object_db_checkpoint()
+{
+   try
+   {
+      // the blocks must be on disk before the state that results from them
+      _block_id_to_block.flush();
+      ilog( "Saving object database at block ${n}", ("n",head_block_num()) );
+      object_database::checkpoint();
+   }
+   catch( const fc::exception& e )
+   {
+      // the block has been applied already, failing to save it is no reason to reject it
+      elog( "Unable to save the object database: ${e}", ("e",e.to_detail_string()) );
+   }
+}
+
+void database::index_transaction_locations( uint32_t first, uint32_t last )
+{ try {
+   ilog( "Indexing transaction locations of blocks ${first} to ${last}", ("first",first)("last",last) );
+   for( uint32_t num = first; num <= last; ++num )
+   {
+      const auto block = fetch_block_by_number( num );
+      FC_ASSERT( block.valid(), "Block ${num} is missing", ("num",num) );
+      for( uint32_t i = 0; i < block->transactions.size(); ++i )
+         _trx_locations.store( block->transactions[i].id(), { num, i } );
+   }
+   _trx_locations.set_head_block_num( last );
+   _trx_locations.flush();
+} FC_CAPTURE_AND_RETHROW( (first)(last) ) }
+
 void database::close(bool rewind)
 {
    if (!_opened)
@@ -263,12 +609,15 @@ void database::close(bool rewind)
    // DB state (issue #336).
    clear_pending();
 
-   object_database::flush();
+   object_database::checkpoint();
    object_database::close();
 
    if( _block_id_to_block.is_open() )
       _block_id_to_block.close();
 
+   if( _trx_locations.is_open() )
+      _trx_locations.close();
+
    _fork_db.reset();
 
    _opened = false;
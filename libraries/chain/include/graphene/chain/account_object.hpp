@@ -448,6 +448,13 @@ MAP_OBJECT_ID_TO_TYPE(graphene::chain::account_object)
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::account_balance_object)
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::account_statistics_object)
 
+MAP_OBJECT_TO_PRIMARY_INDEX(graphene::chain::account_object,
+                            graphene::db::primary_index<graphene::chain::account_index, 20>)
+MAP_OBJECT_TO_PRIMARY_INDEX(graphene::chain::account_balance_object,
+                            graphene::db::primary_index<graphene::chain::account_balance_index>)
+MAP_OBJECT_TO_PRIMARY_INDEX(graphene::chain::account_statistics_object,
+                            graphene::db::primary_index<graphene::chain::account_stats_index, 20>)
+
 FC_REFLECT_TYPENAME( graphene::chain::account_object )
 FC_REFLECT_TYPENAME( graphene::chain::account_balance_object )
 FC_REFLECT_TYPENAME( graphene::chain::account_statistics_object )
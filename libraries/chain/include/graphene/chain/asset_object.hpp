@@ -24,6 +24,7 @@
 #pragma once
 #include <graphene/chain/types.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <graphene/db/simple_index.hpp>
 #include <graphene/protocol/asset_ops.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
@@ -405,6 +406,13 @@ MAP_OBJECT_ID_TO_TYPE(graphene::chain::asset_object)
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::asset_dynamic_data_object)
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::asset_bitasset_data_object)
 
+MAP_OBJECT_TO_PRIMARY_INDEX(graphene::chain::asset_object,
+                            graphene::db::primary_index<graphene::chain::asset_index, 13>)
+MAP_OBJECT_TO_PRIMARY_INDEX(graphene::chain::asset_dynamic_data_object,
+                            graphene::db::primary_index<graphene::db::simple_index<graphene::chain::asset_dynamic_data_object>>)
+MAP_OBJECT_TO_PRIMARY_INDEX(graphene::chain::asset_bitasset_data_object,
+                            graphene::db::primary_index<graphene::chain::asset_bitasset_data_index, 13>)
+
 FC_REFLECT_DERIVED( graphene::chain::price_feed_with_icr, (graphene::protocol::price_feed),
                     (initial_collateral_ratio) )
 
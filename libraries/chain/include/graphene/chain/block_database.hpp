@@ -26,34 +26,169 @@
 #include <graphene/protocol/block.hpp>
 
 #include <fc/filesystem.hpp>
+#include <fc/time.hpp>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
 
 namespace graphene { namespace chain {
    struct index_entry;
+   struct mapped_block_files;
+   struct block_chunk;
    using namespace graphene::protocol;
 
+   /// On-disk layouts understood by @ref block_database
+   enum class block_log_format
+   {
+      /// Blocks are stored individually as packed @c signed_block, files @c index and @c blocks
+      raw = 1,
+      /**
+       * Runs of consecutive blocks are stored as compressed chunks, each with its own offset table,
+       * files @c chunked_index and @c chunked_blocks. Blocks stored one by one after the chunks were
+       * written are kept uncompressed in the same file until the log is converted again.
+       * @note A running node never writes chunks, @ref store always appends raw blocks. Chunks are only
+       *       produced by @ref convert, i.e. offline with the @c block_converter program.
+       */
+      chunked = 2
+   };
+
+   /// Header of a stored block along with the number of transactions in it
+   struct stored_block_header
+   {
+      signed_block_header header;
+      uint32_t            transaction_count = 0;
+   };
+
+   /// A block as stored in the log, not yet unpacked
+   struct packed_block
+   {
+      uint32_t      block_num = 0;
+      block_id_type block_id;  ///< id recorded in the index, the packed data is not verified against it
+      uint64_t      block_pos = 0;
+      vector<char>  data;
+   };
+
+   /**
+    * @brief Stores blocks by number in an append-only @c blocks file plus a fixed-width @c index file.
+    *
+    * All access to the underlying file streams is serialized by a mutex. Optionally, both files can
+    * be memory-mapped for reading (see @ref enable_mapped_reads). In that mode, blocks that lie within
+    * the currently mapped range are read without taking the lock or issuing any syscalls, so that
+    * concurrent API threads do not contend with each other or with @ref store. The mapping is extended
+    * by the data appended to the files from within @ref store and @ref flush, without mapping the rest
+    * of the files again.
+    *
+    * Next to the blocks, a side index of packed block headers and transaction counts is kept in the
+    * @c header_index and @c headers files, so that headers can be served without decoding whole
+    * blocks. It is built from the blocks on @ref open if it is missing.
+    *
+    * The format of an existing database is detected on @ref open, see @ref block_log_format. Use
+    * @ref convert to rewrite a database from one format into the other.
+    */
    class block_database 
    {
       public:
-         void open( const fc::path& dbdir );
+         /**
+          * Enable or disable memory-mapped reads. Takes effect on the next call to @ref open.
+          * @note The mapped files must not be truncated by other processes while open.
+          */
+         void enable_mapped_reads( bool enable ) { _use_mapped_reads = enable; }
+         bool mapped_reads_enabled()const { return _use_mapped_reads; }
+
+         /**
+          * Opens the database in @p dbdir, creating it in @p format_if_new if there is none yet.
+          * The format of an existing database takes precedence.
+          */
+         void open( const fc::path& dbdir, block_log_format format_if_new = block_log_format::raw );
          bool is_open()const;
+         block_log_format format()const { return _format; }
          void flush();
          void close();
 
+         /// Appends @p b uncompressed, also in the chunked format
          void store( const block_id_type& id, const signed_block& b );
          void remove( const block_id_type& id );
 
+         /**
+          * Stores consecutive blocks as one compressed chunk. Only valid in the chunked format.
+          * @param blocks blocks with consecutive block numbers, must not be empty
+          * @param compression_level zlib compression level, 1 is fastest
+          */
+         void store_chunk( const vector<signed_block>& blocks, int compression_level = 1 );
+
+         /**
+          * Copies all blocks of the database in @p src_dir into a new database in @p dst_dir using
+          * @p dst_format. @p dst_dir must not contain a block database yet.
+          */
+         static void convert( const fc::path& src_dir, const fc::path& dst_dir, block_log_format dst_format,
+                              uint32_t blocks_per_chunk = 64, int compression_level = 1 );
+
          bool                   contains( const block_id_type& id )const;
          block_id_type          fetch_block_id( uint32_t block_num )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
+         /// Fetches the header of a block without decoding its transactions
+         optional<stored_block_header> fetch_header_by_number( uint32_t block_num )const;
+         /**
+          * Reads up to @p count consecutive blocks starting at @p first_block_num without unpacking them,
+          * stopping early at the end of the log or at the first missing block. Blocks that are stored next
+          * to each other in the blocks file are fetched with a single large read.
+          * @note Callers must check that each unpacked block has the id in its @ref packed_block
+          */
+         vector<packed_block>   fetch_packed_range( uint32_t first_block_num, uint32_t count )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
          size_t                 blocks_current_position()const;
          size_t                 total_block_size()const;
       private:
          optional<index_entry> last_index_entry()const;
+         /// Drops entries at the end of the index which do not refer to a readable block, only done on @ref open
+         void truncate_index();
+
+         /// Copies @p size bytes of the mapped index at @p pos, returns false if entries were rewritten meanwhile
+         bool read_mapped_index( const mapped_block_files& mapping, uint64_t pos, char* dest, size_t size )const;
+
+         /// Reads the index entry at @p block_num, returns false if it is beyond the end of the index
+         bool read_index_entry( uint32_t block_num, index_entry& e )const;
+         /// Reads and unpacks the block referenced by @p e, verifying its id
+         signed_block read_block( const index_entry& e )const;
+         /// Returns the decompressed chunk starting at @p chunk_pos, from cache if possible
+         std::shared_ptr<const block_chunk> load_chunk( uint64_t chunk_pos )const;
+         /// Reads the header of @p block_num from the header index, returns false if missing or not matching @p id
+         bool read_header( uint32_t block_num, const block_id_type& id, stored_block_header& result )const;
+
+         /// Appends the header of @p b to the header index, caller must hold _lock
+         void store_header( uint32_t block_num, const signed_block& b );
+         /// Fills the header index for blocks stored before it existed
+         void build_header_index();
+
+         /// Maps the data appended to the files since the last mapping, caller must hold _lock
+         void remap();
+         void unmap()const;
+
+         std::shared_ptr<const mapped_block_files> current_mapping()const;
+
+         block_log_format _format = block_log_format::raw;
          fc::path _index_filename;
+         fc::path _blocks_filename;
          mutable std::fstream _blocks;
          mutable std::fstream _block_num_to_pos;
+         fc::path _header_index_filename;
+         fc::path _headers_filename;
+         mutable std::fstream _header_index;
+         mutable std::fstream _headers;
+         mutable std::mutex   _lock;
+
+         bool                                              _use_mapped_reads = false;
+         mutable std::shared_ptr<const mapped_block_files> _mapping;
+         mutable std::atomic<size_t>                       _blocks_read_pos{0};
+         /// Odd while index entries are rewritten, see @ref read_mapped_index
+         std::atomic<uint64_t>                             _index_write_sequence{0};
+
+         /// Recently decompressed chunks keyed by file position, most recently used first
+         mutable std::deque< std::pair< uint64_t, std::shared_ptr<const block_chunk> > > _chunk_cache;
+         mutable std::mutex                                                             _chunk_cache_lock;
    };
 } }
@@ -33,6 +33,10 @@
 #include <graphene/chain/commit_reveal_object.hpp>
 #include <graphene/chain/fork_database.hpp>
 #include <graphene/chain/block_database.hpp>
+#include <graphene/chain/transaction_location_database.hpp>
+#include <graphene/chain/vote_ranking_index.hpp>
+#include <graphene/chain/vote_tally.hpp>
+#include <graphene/chain/pending_authority_cache.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/chain/evaluator.hpp>
 
@@ -57,6 +61,7 @@ namespace graphene { namespace chain {
    class chain_property_object;
    class witness_schedule_object;
    class witness_object;
+   class committee_member_object;
    class force_settlement_object;
    class limit_order_object;
    class call_order_object;
@@ -64,6 +69,19 @@ namespace graphene { namespace chain {
    struct budget_record;
    enum class vesting_balance_type;
 
+   /**
+    * Queue limits of the stages of the replay pipeline in @ref database::reindex. Blocks are read in
+    * batches by a dedicated thread, unpacked and precomputed on the worker pool, and finally applied
+    * in order. Each limit is the maximum number of blocks waiting in or being processed by a stage.
+    */
+   struct replay_pipeline_options
+   {
+      uint32_t read_batch_size        = 256;
+      uint32_t read_queue_size        = 2048;
+      uint32_t deserialize_queue_size = 1024;
+      uint32_t precompute_queue_size  = 256;
+   };
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -117,6 +135,16 @@ namespace graphene { namespace chain {
           */
          void reindex(fc::path data_dir);
 
+         /// Set the queue limits of the replay pipeline used by @ref reindex
+         void set_replay_pipeline_options( const replay_pipeline_options& options );
+
+         /**
+          * Save the object database to disk every @p blocks blocks, along with the undo history of the reversible
+          * blocks, so that after a crash the node resumes from the last save instead of the last clean shutdown.
+          * 0 disables periodic saves.
+          */
+         inline void set_object_db_checkpoint_interval( uint32_t blocks ) { _object_db_checkpoint_interval = blocks; }
+
          /**
           * @brief wipe Delete database from disk, and potentially the raw chain as well.
           * @param data_dir the path to store the database
@@ -138,7 +166,14 @@ namespace graphene { namespace chain {
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+         /// Like @ref fetch_block_by_number, but avoids decoding the transactions of stored blocks
+         optional<signed_block_header> fetch_block_header_by_number( uint32_t num )const;
          const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
+         /**
+          * @brief Look up where a transaction was included, requires the transaction location index to be enabled
+          * @note The result is not verified, it may point to a block that has been popped since
+          */
+         optional<transaction_location> find_transaction_location( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
          /**
@@ -155,6 +190,8 @@ namespace graphene { namespace chain {
          processed_transaction push_transaction( const precomputable_transaction& trx, uint32_t skip = skip_nothing );
          bool _push_block( const signed_block& b );
          processed_transaction _push_transaction( const precomputable_transaction& trx );
+         /// Forgets the authority checks of transactions which are no longer pending
+         void prune_pending_authority_checks();
 
          ///@throws fc::exception if the proposed transaction fails to apply.
          processed_transaction push_proposal( const proposal_object& proposal );
@@ -279,6 +316,9 @@ namespace graphene { namespace chain {
          const fee_schedule&                    current_fee_schedule()const;
          const account_statistics_object&       get_account_stats_by_owner( account_id_type owner )const;
          const witness_schedule_object&         get_witness_schedule_object()const;
+         /// Witnesses and committee members ordered by votes, see @ref vote_ranking_index
+         const vote_ranking_index<witness_object>&          get_witness_ranking()const;
+         const vote_ranking_index<committee_member_object>& get_committee_member_ranking()const;
 
          time_point_sec   head_block_time()const;
          uint32_t         head_block_num()const;
@@ -525,6 +565,29 @@ namespace graphene { namespace chain {
          /// Enable or disable tracking of votes of standby witnesses and committee members
          inline void enable_standby_votes_tracking(bool enable)  { _track_standby_votes = enable; }
 
+         /// Enable or disable the incremental vote tally, which only recomputes the votes of accounts that
+         /// changed since the last maintenance
+         inline void enable_incremental_vote_tally(bool enable)  { _incremental_vote_tally = enable; }
+
+         /// Enable or disable checking the incremental vote tally against the votes of all accounts, for tests
+         inline void enable_vote_tally_verification(bool enable)  { _verify_vote_tally = enable; }
+
+         /// Set the number of voters tallied by each thread during a full vote tally, 0 to split the voters
+         /// evenly across the threads in partitions of at least 10000 accounts
+         inline void set_vote_tally_partition_size(size_t voters)  { _vote_tally_partition_size = voters; }
+
+         /// Enable or disable memory-mapped reads of the block log, takes effect when the database is opened
+         inline void enable_mapped_block_reads(bool enable)  { _block_id_to_block.enable_mapped_reads( enable ); }
+
+         /// Enable or disable the persistent transaction id to location index, takes effect when the database is opened
+         inline void enable_transaction_location_index(bool enable)  { _track_trx_locations = enable; }
+
+         /// Set the number of public keys recovered from transaction signatures to keep cached, 0 disables the cache
+         inline void set_signature_cache_size(size_t max_entries)  { _signature_cache.set_max_entries( max_entries ); }
+
+         /// Cache of public keys recovered from transaction signatures, shared by all precomputations
+         inline const signature_cache& get_signature_cache()const  { return _signature_cache; }
+
          /** Precomputes digests, signatures and operation validations depending
           *  on skip flags. "Expensive" computations may be done in a parallel
           *  thread.
@@ -544,10 +607,27 @@ namespace graphene { namespace chain {
           *         precomputations applied
           */
          fc::future<void> precompute_parallel( const precomputable_transaction& trx )const;
+
+         /** Precomputes digests, signatures and operation validations of a batch of transactions,
+          *  spreading the work over the parallel threads. Returns when all of them are done.
+          *
+          * @param trxs the first of the transactions to preprocess
+          * @param count the number of transactions
+          * @throws the first error encountered; transactions in the same chunk after the failing one
+          *         may not have been preprocessed
+          */
+         void precompute_batch( const precomputable_transaction* trxs, const size_t count )const;
    private:
          template<typename Trx>
          void _precompute_parallel( const Trx* trx, const size_t count, const uint32_t skip )const;
 
+         template<typename Trx>
+         void _precompute_chunked( const Trx* trx, const size_t count, const uint32_t skip,
+                                   std::vector<fc::future<void>>& workers )const;
+
+         /// Performs the precomputations of @ref precompute_parallel for one block in the calling thread
+         void precompute_serial( const signed_block& block, const uint32_t skip )const;
+
    protected:
          //Mark pop_undo() as protected -- we do not want outside calling pop_undo(); it should call pop_block() instead
          void pop_undo() { object_database::pop_undo(); }
@@ -559,9 +639,6 @@ namespace graphene { namespace chain {
          optional<undo_database::session>       _pending_tx_session;
          vector< unique_ptr<op_evaluator> >     _operation_evaluators;
 
-         template<class Index>
-         vector<std::reference_wrapper<const typename Index::object_type>> sort_votable_objects(size_t count)const;
-
          //////////////////// db_block.cpp ////////////////////
 
       public:
@@ -572,7 +649,9 @@ namespace graphene { namespace chain {
 
       private:
          void                  _apply_block( const signed_block& next_block );
-         processed_transaction _apply_transaction( const signed_transaction& trx );
+         /// @param pending whether @p trx is applied to the pending state, in which case its authority check is
+         ///        remembered in and skipped if found in @ref _pending_authority_checks
+         processed_transaction _apply_transaction( const signed_transaction& trx, bool pending = false );
          void                  _cancel_bids_and_revive_mpa( const asset_object& bitasset, const asset_bitasset_data_object& bad );
 
          ///Steps involved in applying a new block
@@ -623,13 +702,18 @@ namespace graphene { namespace chain {
          void process_bitassets();
 
          template<class Type>
-         void perform_account_maintenance( Type tally_helper );
+         void perform_account_maintenance( Type& tally_helper );
          ///@}
          ///@}
 
          vector< processed_transaction >        _pending_tx;
          fork_database                          _fork_db;
 
+         /// Rebuilds the fork database for the blocks covered by the undo history restored by @ref open
+         void restore_fork_database();
+         /// Saves the object database at the current head block, see @ref set_object_db_checkpoint_interval
+         void save_object_db_checkpoint();
+
          /**
           *  Note: we can probably store blocks by block num rather than
           *  block id because after the undo window is past the block ID
@@ -641,6 +725,11 @@ namespace graphene { namespace chain {
           */
          block_database   _block_id_to_block;
 
+         /// Maps ids of transactions in applied blocks to their location, only maintained if enabled
+         transaction_location_database  _trx_locations;
+         /// Store the locations of the transactions of blocks [first, last] from the block log
+         void index_transaction_locations( uint32_t first, uint32_t last );
+
          /**
           * Contains the set of ops that are in the process of being applied from
           * the current block.  It contains real and virtual operations in the
@@ -670,6 +759,32 @@ namespace graphene { namespace chain {
          /// Set it to true to provide accurate data to API clients, set to false to have better performance.
          bool                              _track_standby_votes = true;
 
+         /// Witnesses and committee members ordered by their votes in the last tally
+         vote_ranking_index<witness_object>*          _witness_ranking = nullptr;
+         vote_ranking_index<committee_member_object>* _committee_member_ranking = nullptr;
+
+         /// Votes of the last maintenance interval, see @ref enable_incremental_vote_tally
+         vote_tally_tracker                _vote_tally;
+         bool                              _incremental_vote_tally = true;
+         bool                              _verify_vote_tally = false;
+         /// see @ref set_vote_tally_partition_size
+         size_t                            _vote_tally_partition_size = 0;
+
+         /// Whether to maintain @ref _trx_locations
+         bool                              _track_trx_locations = false;
+
+         replay_pipeline_options           _replay_options;
+
+         /// Number of blocks between periodic saves of the object database, 0 to disable
+         uint32_t                          _object_db_checkpoint_interval = 0;
+
+         /// Pending transactions which passed the authority check, see @ref _apply_transaction
+         pending_authority_cache           _pending_authority_checks;
+
+         /// Keys recovered while precomputing pending transactions and blocks, so that a transaction seen
+         /// before does not need its signatures recovered again when it shows up in a block or after a fork switch
+         mutable signature_cache           _signature_cache;
+
          /**
           * Whether database is successfully opened or not.
           *
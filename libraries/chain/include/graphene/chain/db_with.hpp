@@ -76,9 +76,14 @@ struct pending_transactions_restorer
 
    ~pending_transactions_restorer()
    {
+      // expired transactions are dropped without applying them
+      const bool check_expiration = ( _db.head_block_num() > 0 );
+      const fc::time_point_sec now = _db.head_block_time();
       for( const auto& tx : _db._popped_tx )
       {
          try {
+            if( check_expiration && tx.expiration < now )
+               continue;
             if( !_db.is_known_transaction( tx.id() ) ) {
                _db._push_transaction( tx );
             }
@@ -90,6 +95,8 @@ struct pending_transactions_restorer
       {
          try
          {
+            if( check_expiration && tx.expiration < now )
+               continue;
             if( !_db.is_known_transaction( tx.id() ) ) {
                _db._push_transaction( tx );
             }
@@ -98,6 +105,7 @@ struct pending_transactions_restorer
          { // ignore invalid transactions
          }
       }
+      _db.prune_pending_authority_checks();
    }
 
    database& _db;
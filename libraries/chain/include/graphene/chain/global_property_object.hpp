@@ -26,6 +26,7 @@
 #include <graphene/protocol/chain_parameters.hpp>
 #include <graphene/chain/types.hpp>
 #include <graphene/db/object.hpp>
+#include <graphene/db/simple_index.hpp>
 
 namespace graphene { namespace chain {
 
@@ -125,6 +126,11 @@ namespace graphene { namespace chain {
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::dynamic_global_property_object)
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::global_property_object)
 
+MAP_OBJECT_TO_PRIMARY_INDEX(graphene::chain::dynamic_global_property_object,
+                            graphene::db::primary_index<graphene::db::simple_index<graphene::chain::dynamic_global_property_object>>)
+MAP_OBJECT_TO_PRIMARY_INDEX(graphene::chain::global_property_object,
+                            graphene::db::primary_index<graphene::db::simple_index<graphene::chain::global_property_object>>)
+
 FC_REFLECT_TYPENAME( graphene::chain::dynamic_global_property_object )
 FC_REFLECT_TYPENAME( graphene::chain::global_property_object )
 
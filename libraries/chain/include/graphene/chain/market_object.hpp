@@ -238,6 +238,11 @@ MAP_OBJECT_ID_TO_TYPE(graphene::chain::limit_order_object)
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::call_order_object)
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::force_settlement_object)
 
+MAP_OBJECT_TO_PRIMARY_INDEX(graphene::chain::limit_order_object,
+                            graphene::db::primary_index<graphene::chain::limit_order_index>)
+MAP_OBJECT_TO_PRIMARY_INDEX(graphene::chain::call_order_object,
+                            graphene::db::primary_index<graphene::chain::call_order_index>)
+
 FC_REFLECT_TYPENAME( graphene::chain::limit_order_object )
 FC_REFLECT_TYPENAME( graphene::chain::call_order_object )
 FC_REFLECT_TYPENAME( graphene::chain::force_settlement_object )
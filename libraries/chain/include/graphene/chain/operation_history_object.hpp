@@ -96,6 +96,7 @@ namespace graphene { namespace chain {
          operation_history_id_type            operation_id;
          uint64_t                             sequence = 0; /// the operation position within the given account
          account_transaction_history_id_type  next;
+         uint16_t                             operation_type = 0; /// the operation's tag, see operation::which()
    };
 
    typedef multi_index_container<
@@ -110,6 +111,7 @@ namespace graphene { namespace chain {
    struct by_seq;
    struct by_op;
    struct by_opid;
+   struct by_type;
 
    typedef multi_index_container<
       account_transaction_history_object,
@@ -129,6 +131,13 @@ namespace graphene { namespace chain {
          >,
          ordered_non_unique< tag<by_opid>,
             member< account_transaction_history_object, operation_history_id_type, &account_transaction_history_object::operation_id>
+         >,
+         ordered_unique< tag<by_type>,
+            composite_key< account_transaction_history_object,
+               member< account_transaction_history_object, account_id_type, &account_transaction_history_object::account>,
+               member< account_transaction_history_object, uint16_t, &account_transaction_history_object::operation_type>,
+               member< account_transaction_history_object, uint64_t, &account_transaction_history_object::sequence>
+            >
          >
       >
    > account_transaction_history_multi_index_type;
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <fc/thread/parallel.hpp>
+
+#include <exception>
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief Runs @p work( part ) for every part in [0, @p parts), part 0 on the calling thread and the others
+    *        on the fc io service threads, and blocks the calling thread until all of them are done.
+    *
+    * Waiting on the futures of fc::do_parallel yields to the other tasks of the calling fc thread, which may
+    * modify the database while the parts still read it. This blocks the thread instead, so the parts must not
+    * wait for anything the calling thread does. The first exception thrown by a part is rethrown once all
+    * parts have finished.
+    */
+   template< typename Work >
+   void run_parallel_blocking( size_t parts, const Work& work )
+   {
+      std::vector< std::future<void> > done;
+      done.reserve( parts > 0 ? parts - 1 : 0 );
+      for( size_t part = 1; part < parts; ++part )
+      {
+         // the task may still hold the promise after the caller is woken up, so it owns it
+         auto promise = std::make_shared< std::promise<void> >();
+         done.push_back( promise->get_future() );
+         fc::do_parallel( [promise,&work,part]() {
+            try
+            {
+               work( part );
+               promise->set_value();
+            }
+            catch( ... )
+            {
+               promise->set_exception( std::current_exception() );
+            }
+         });
+      }
+
+      std::exception_ptr error;
+      if( parts > 0 )
+      {
+         try
+         {
+            work( 0 );
+         }
+         catch( ... )
+         {
+            error = std::current_exception();
+         }
+      }
+      for( auto& part_done : done )
+      {
+         try
+         {
+            part_done.get();
+         }
+         catch( ... )
+         {
+            if( !error )
+               error = std::current_exception();
+         }
+      }
+      if( error )
+         std::rethrow_exception( error );
+   }
+
+} } // graphene::chain
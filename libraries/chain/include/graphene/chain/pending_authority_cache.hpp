@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/types.hpp>
+#include <graphene/protocol/transaction.hpp>
+#include <graphene/db/index.hpp>
+
+#include <map>
+#include <set>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief Remembers the pending transactions which passed the authority check, along with the accounts whose
+    *        authorities the check looked at, so that re-applying the pending transactions after a block or a
+    *        popped block only verifies the authorities again if one of these accounts changed in between.
+    *
+    * Any change of the authorities of an account, including one that is undone, drops the transactions that
+    * depend on it. Any change of a custom authority drops all transactions.
+    */
+   class pending_authority_cache
+   {
+      public:
+         /// @return whether @p trx passed the check with @p max_depth and none of its accounts changed since
+         bool is_verified( const signed_transaction& trx, uint32_t max_depth )const;
+         /// Remembers that @p trx passed the check with @p max_depth, looking at the authorities of @p accounts
+         void add( const signed_transaction& trx, uint32_t max_depth, flat_set<account_id_type>&& accounts );
+
+         /// Drops the transactions which depend on the authorities of @p account
+         void account_changed( account_id_type account );
+         /// Drops the transactions whose id is not in @p pending
+         void retain( const std::set<transaction_id_type>& pending );
+         void clear();
+
+         size_t size()const { return _entries.size(); }
+
+      private:
+         struct entry
+         {
+            vector<signature_type>    signatures;
+            uint32_t                  max_depth = 0;
+            flat_set<account_id_type> accounts;
+         };
+
+         void remove( std::map< transaction_id_type, entry >::iterator itr );
+
+         std::map< transaction_id_type, entry >                        _entries;
+         /// Maps each account to the transactions whose check looked at its authorities
+         std::map< account_id_type, std::set< transaction_id_type > >  _dependents;
+   };
+
+   /// Tells the pending authority cache about accounts whose owner or active authority changes
+   class pending_authority_account_observer : public secondary_index
+   {
+      public:
+         explicit pending_authority_account_observer( pending_authority_cache* cache ) : _cache( cache ) {}
+
+         virtual void objects_loaded( const vector<const object*>& objs ) override {}
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+      private:
+         pending_authority_cache* _cache;
+         /// Whether the authorities of the account being modified were saved, which is skipped if nothing is cached
+         bool                     _saved = false;
+         authority                _owner;
+         authority                _active;
+   };
+
+   /// Tells the pending authority cache about any change of custom authorities
+   class pending_authority_custom_observer : public secondary_index
+   {
+      public:
+         explicit pending_authority_custom_observer( pending_authority_cache* cache ) : _cache( cache ) {}
+
+         virtual void object_inserted( const object& obj ) override { _cache->clear(); }
+         virtual void objects_loaded( const vector<const object*>& objs ) override {}
+         virtual void object_removed( const object& obj ) override { _cache->clear(); }
+         virtual void object_modified( const object& after  ) override { _cache->clear(); }
+
+      private:
+         pending_authority_cache* _cache;
+   };
+
+} } // graphene::chain
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/types.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/interprocess/file_mapping.hpp>
+
+#include <memory>
+#include <mutex>
+
+namespace graphene { namespace chain {
+   using namespace graphene::protocol;
+
+   /// Position of a transaction in the blockchain
+   struct transaction_location
+   {
+      uint32_t block_num    = 0;
+      uint32_t trx_in_block = 0;
+   };
+
+   /**
+    * @brief A persistent mapping from transaction ids to their position in the blockchain.
+    *
+    * The mapping is an open addressing hash table with linear probing in a single memory-mapped file,
+    * which doubles in size when it becomes 70% full. Entries are never removed: a transaction that is
+    * included again after a fork switch overwrites its previous location, and entries of popped blocks
+    * stay behind. Callers must therefore verify a location against the blocks of the current chain.
+    */
+   class transaction_location_database
+   {
+      public:
+         void open( const fc::path& dbdir );
+         bool is_open()const;
+         void flush();
+         void close();
+
+         void                           store( const transaction_id_type& id, const transaction_location& location );
+         optional<transaction_location> find( const transaction_id_type& id )const;
+
+         /// Number of the last block whose transactions have all been stored
+         uint32_t head_block_num()const;
+         void     set_head_block_num( uint32_t block_num );
+
+         /// Number of stored transactions
+         uint64_t size()const;
+
+      private:
+         char* base()const { return (char*)_region->get_address(); }
+         void  map_file();
+         void  unmap_file();
+         void  grow();
+
+         fc::path                            _filename;
+         std::unique_ptr<fc::file_mapping>   _mapping;
+         std::unique_ptr<fc::mapped_region>  _region;
+         mutable std::mutex                  _lock;
+   };
+} }
+
+FC_REFLECT( graphene::chain::transaction_location, (block_num)(trx_in_block) )
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/vote.hpp>
+#include <graphene/db/index.hpp>
+
+#include <functional>
+#include <map>
+#include <set>
+
+namespace graphene { namespace chain {
+   using namespace graphene::db;
+
+   /**
+    * @brief Orders the objects of a votable index, i.e. witnesses or committee members, by their votes in the
+    *        last tally, most votes first and ties by vote id.
+    *
+    * The ranking is refreshed from the vote tally by @ref update during chain maintenance, which only re-ranks the
+    * objects whose votes changed, and is kept until the next maintenance. Selecting the top N objects is a walk
+    * over the first N entries.
+    *
+    * Between maintenances the ranking follows the @c total_votes of the objects: objects loaded from disk are
+    * ranked by it, and so are objects whose @c total_votes change, which includes undoing a maintenance when its
+    * block is popped. Without standby vote tracking, standby objects keep the votes of their last tracked tally.
+    */
+   template< typename ObjectType >
+   class vote_ranking_index : public secondary_index
+   {
+      public:
+         struct entry
+         {
+            uint64_t          votes;
+            vote_id_type      vote_id;
+            const ObjectType* object;
+         };
+
+         struct entry_order
+         {
+            bool operator()( const entry& a, const entry& b )const
+            {
+               if( a.votes != b.votes )
+                  return a.votes > b.votes;
+               return a.vote_id < b.vote_id;
+            }
+         };
+
+         using ranking_type = std::set< entry, entry_order >;
+
+         virtual void object_inserted( const object& obj ) override
+         {
+            const ObjectType& o = static_cast<const ObjectType&>( obj );
+            _positions[o.vote_id] = _ranking.insert( entry{ o.total_votes, o.vote_id, &o } ).first;
+         }
+
+         virtual void object_removed( const object& obj ) override
+         {
+            auto itr = _positions.find( static_cast<const ObjectType&>( obj ).vote_id );
+            if( itr == _positions.end() )
+               return;
+            _ranking.erase( itr->second );
+            _positions.erase( itr );
+         }
+
+         virtual void about_to_modify( const object& before ) override
+         {
+            _votes_before_modify = static_cast<const ObjectType&>( before ).total_votes;
+         }
+
+         virtual void object_modified( const object& after ) override
+         {
+            const ObjectType& o = static_cast<const ObjectType&>( after );
+            if( o.total_votes == _votes_before_modify )
+               return;
+            auto itr = _positions.find( o.vote_id );
+            if( itr != _positions.end() )
+               rerank( itr->second, o.total_votes );
+         }
+
+         /// Re-ranks the objects whose votes in @p vote_tally differ from the ranking
+         void update( const vector<uint64_t>& vote_tally )
+         {
+            for( auto& position : _positions )
+            {
+               const uint32_t offset = position.first.instance();
+               const uint64_t votes = ( offset < vote_tally.size() ? vote_tally[offset] : 0 );
+               rerank( position.second, votes );
+            }
+         }
+
+         /// @return the first @p count objects of the ranking
+         vector< std::reference_wrapper<const ObjectType> > top( size_t count )const
+         {
+            vector< std::reference_wrapper<const ObjectType> > result;
+            result.reserve( std::min( count, _ranking.size() ) );
+            for( auto itr = _ranking.begin(); itr != _ranking.end() && result.size() < count; ++itr )
+               result.push_back( std::cref( *itr->object ) );
+            return result;
+         }
+
+         const ranking_type& ranking()const { return _ranking; }
+
+      private:
+         void rerank( typename ranking_type::const_iterator& position, uint64_t votes )
+         {
+            if( position->votes == votes )
+               return;
+            entry e = *position;
+            e.votes = votes;
+            _ranking.erase( position );
+            position = _ranking.insert( e ).first;
+         }
+
+         ranking_type                                                 _ranking;
+         std::map< vote_id_type, typename ranking_type::const_iterator > _positions;
+         uint64_t                                                     _votes_before_modify = 0;
+   };
+
+} } // graphene::chain
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/types.hpp>
+#include <graphene/protocol/account.hpp>
+#include <graphene/db/index.hpp>
+
+#include <map>
+#include <set>
+
+namespace graphene { namespace chain {
+
+   /// What the stake of one account adds to the vote tally of a maintenance interval
+   struct voter_contribution
+   {
+      /// Offsets into the vote tally and the stake added to each of them
+      vector< pair< uint32_t, uint64_t > > votes;
+      uint16_t       witness_count_offset = 0;
+      uint64_t       witness_count_stake = 0;
+      uint16_t       committee_count_offset = 0;
+      uint64_t       committee_count_stake = 0;
+      uint64_t       total_voting_stake[2] = { 0, 0 }; // 0=committee, 1=witness
+      /// The earliest time at which the contribution may change although no object of the account was modified,
+      /// i.e. when its votes lose power or its membership expires
+      time_point_sec recalc_time = time_point_sec::maximum();
+
+      bool empty()const
+      {
+         return votes.empty() && total_voting_stake[0] == 0 && total_voting_stake[1] == 0;
+      }
+
+      friend bool operator == ( const voter_contribution& a, const voter_contribution& b );
+   };
+
+   /// Chain parameters the contributions were computed with, any change requires a full tally
+   struct vote_tally_parameters
+   {
+      bool     pob_activated = false;
+      bool     count_non_member_votes = true;
+      uint16_t maximum_witness_count = 0;
+      uint16_t maximum_committee_count = 0;
+
+      friend bool operator == ( const vote_tally_parameters& a, const vote_tally_parameters& b )
+      {
+         return a.pob_activated == b.pob_activated && a.count_non_member_votes == b.count_non_member_votes
+                && a.maximum_witness_count == b.maximum_witness_count
+                && a.maximum_committee_count == b.maximum_committee_count;
+      }
+   };
+
+   /**
+    * @brief Keeps the vote tally of the last maintenance interval along with the contribution of every voter,
+    *        so that the next maintenance only needs to recompute the voters whose objects changed in between
+    *        or whose votes lose power over time.
+    *
+    * The tracker lives in memory only. It is invalidated at the start of every maintenance and marked in sync
+    * with the next maintenance time when the maintenance completes, so a restart, a popped maintenance block or
+    * a failed maintenance leads to a full tally on the next maintenance.
+    */
+   class vote_tally_tracker
+   {
+      public:
+         /// Forgets all contributions, changes and proxies
+         void reset();
+
+         /// @return whether the tally is valid for a maintenance at @p next_maintenance_time with @p params
+         bool is_synced( time_point_sec next_maintenance_time, const vote_tally_parameters& params )const;
+         void set_synced( time_point_sec next_maintenance_time, const vote_tally_parameters& params );
+         void invalidate() { _synced = false; }
+
+         /// Notes that the contribution of @p account may have changed. If @p opinion_changed, the contributions
+         /// of the accounts that use it as their voting account may have changed too.
+         void mark_changed( account_id_type account, bool opinion_changed );
+         void set_voting_account( account_id_type account, account_id_type old_proxy, account_id_type new_proxy );
+
+         /// Returns the accounts which need to be recomputed at @p now and forgets the changes
+         std::set< account_id_type > take_changed( time_point_sec now );
+         /// Forgets the changes, for a full tally
+         void clear_changes();
+
+         /// While recording, changed accounts and their dependents are also collected for @ref take_recorded
+         void start_recording() { _recording = true; }
+         void stop_recording() { _recording = false; _recorded.clear(); }
+         vector< account_id_type > take_recorded();
+
+         /// Replaces all contributions and the totals by the results of a full tally, the contributions are
+         /// added with @ref load_contribution afterwards
+         void reset_tally( const vector<uint64_t>& vote_tally, const vector<uint64_t>& witness_count_histogram,
+                           const vector<uint64_t>& committee_count_histogram,
+                           const uint64_t (&total_voting_stake)[2] );
+         /// Stores a contribution which is already included in the totals
+         void load_contribution( account_id_type account, voter_contribution&& contribution );
+         /// Replaces the contribution of @p account and updates the totals
+         void update_contribution( account_id_type account, voter_contribution&& contribution );
+         /// Grows the vote tally to @p vote_ids entries
+         void resize( size_t vote_ids );
+
+         /// @return the stored contribution of @p account, or nullptr if it contributes nothing
+         const voter_contribution* find_contribution( account_id_type account )const;
+         const std::map< account_id_type, voter_contribution >& contributions()const { return _contributions; }
+
+         const vector<uint64_t>& vote_tally()const { return _vote_tally; }
+         const vector<uint64_t>& witness_count_histogram()const { return _witness_count_histogram; }
+         const vector<uint64_t>& committee_count_histogram()const { return _committee_count_histogram; }
+         uint64_t total_voting_stake( size_t i )const { return _total_voting_stake[i]; }
+
+         /// Asserts that the totals equal the sum of the stored contributions
+         void verify_totals()const;
+
+      private:
+         void apply( const voter_contribution& contribution, bool add );
+
+         bool                                               _synced = false;
+         time_point_sec                                     _synced_next_maintenance_time;
+         vote_tally_parameters                              _synced_params;
+
+         vector<uint64_t>                                   _vote_tally;
+         vector<uint64_t>                                   _witness_count_histogram;
+         vector<uint64_t>                                   _committee_count_histogram;
+         uint64_t                                           _total_voting_stake[2] = { 0, 0 };
+
+         std::map< account_id_type, voter_contribution >    _contributions;
+         std::set< pair< time_point_sec, account_id_type > > _recalc_queue;
+
+         std::set< account_id_type >                        _changed;
+         std::set< account_id_type >                        _opinion_changed;
+         /// Maps each voting account to the accounts which use it as their proxy
+         std::map< account_id_type, std::set< account_id_type > > _proxied_by;
+
+         bool                                               _recording = false;
+         vector< account_id_type >                          _recorded;
+   };
+
+   /// Tells the vote tally tracker about accounts whose voting options or membership change
+   class vote_tally_account_observer : public secondary_index
+   {
+      public:
+         explicit vote_tally_account_observer( vote_tally_tracker* tracker ) : _tracker( tracker ) {}
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void objects_loaded( const vector<const object*>& objs ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+      private:
+         vote_tally_tracker*               _tracker;
+         account_options                   _options;
+         uint16_t                          _num_committee_voted = 0;
+         optional<vesting_balance_id_type> _cashback_vb;
+         time_point_sec                    _membership_expiration_date;
+   };
+
+   /// Tells the vote tally tracker about accounts whose stake, last vote time or pending fees change
+   class vote_tally_stats_observer : public secondary_index
+   {
+      public:
+         explicit vote_tally_stats_observer( vote_tally_tracker* tracker ) : _tracker( tracker ) {}
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void objects_loaded( const vector<const object*>& objs ) override {}
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+      private:
+         /// The fields of an account_statistics_object which the vote tally depends on
+         struct voting_state
+         {
+            share_type     total_core_in_orders;
+            share_type     core_in_balance;
+            share_type     total_core_pol;
+            share_type     total_core_pob;
+            share_type     total_core_inactive;
+            share_type     total_pol_value;
+            share_type     total_pob_value;
+            bool           is_voting = false;
+            bool           has_cashback_vb = false;
+            bool           has_pending_fees = false;
+            time_point_sec last_vote_time;
+         };
+         static voting_state get_voting_state( const object& obj );
+
+         vote_tally_tracker*               _tracker;
+         voting_state                      _before;
+   };
+
+   /// Tells the vote tally tracker about changes of cashback vesting balances
+   class vote_tally_vesting_observer : public secondary_index
+   {
+      public:
+         explicit vote_tally_vesting_observer( vote_tally_tracker* tracker ) : _tracker( tracker ) {}
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void objects_loaded( const vector<const object*>& objs ) override {}
+         virtual void object_removed( const object& obj ) override;
+         virtual void object_modified( const object& after  ) override;
+
+      private:
+         vote_tally_tracker*               _tracker;
+   };
+
+} } // graphene::chain
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/pending_authority_cache.hpp>
+#include <graphene/chain/account_object.hpp>
+
+namespace graphene { namespace chain {
+
+bool pending_authority_cache::is_verified( const signed_transaction& trx, uint32_t max_depth )const
+{
+   if( _entries.empty() )
+      return false;
+   auto itr = _entries.find( trx.id() );
+   return itr != _entries.end() && itr->second.max_depth == max_depth && itr->second.signatures == trx.signatures;
+}
+
+void pending_authority_cache::add( const signed_transaction& trx, uint32_t max_depth,
+                                   flat_set<account_id_type>&& accounts )
+{
+   const transaction_id_type id = trx.id();
+   auto itr = _entries.find( id );
+   if( itr != _entries.end() )
+      remove( itr );
+   for( const auto& account : accounts )
+      _dependents[account].insert( id );
+   entry& e = _entries[id];
+   e.signatures = trx.signatures;
+   e.max_depth = max_depth;
+   e.accounts = std::move( accounts );
+}
+
+void pending_authority_cache::remove( std::map< transaction_id_type, entry >::iterator itr )
+{
+   for( const auto& account : itr->second.accounts )
+   {
+      auto dep = _dependents.find( account );
+      if( dep == _dependents.end() )
+         continue;
+      dep->second.erase( itr->first );
+      if( dep->second.empty() )
+         _dependents.erase( dep );
+   }
+   _entries.erase( itr );
+}
+
+void pending_authority_cache::account_changed( account_id_type account )
+{
+   auto dep = _dependents.find( account );
+   if( dep == _dependents.end() )
+      return;
+   const std::set< transaction_id_type > ids = std::move( dep->second );
+   _dependents.erase( dep );
+   for( const auto& id : ids )
+   {
+      auto itr = _entries.find( id );
+      if( itr != _entries.end() )
+         remove( itr );
+   }
+}
+
+void pending_authority_cache::retain( const std::set<transaction_id_type>& pending )
+{
+   for( auto itr = _entries.begin(); itr != _entries.end(); )
+   {
+      auto next = std::next( itr );
+      if( pending.find( itr->first ) == pending.end() )
+         remove( itr );
+      itr = next;
+   }
+}
+
+void pending_authority_cache::clear()
+{
+   _entries.clear();
+   _dependents.clear();
+}
+
+void pending_authority_account_observer::object_removed( const object& obj )
+{
+   // an account created by a pending transaction may get a different id when that transaction is re-applied
+   _cache->account_changed( static_cast<const account_object&>( obj ).id );
+}
+
+void pending_authority_account_observer::about_to_modify( const object& before )
+{
+   _saved = ( _cache->size() > 0 );
+   if( !_saved )
+      return;
+   const account_object& a = static_cast<const account_object&>( before );
+   _owner = a.owner;
+   _active = a.active;
+}
+
+void pending_authority_account_observer::object_modified( const object& after )
+{
+   if( !_saved )
+      return;
+   _saved = false;
+   const account_object& a = static_cast<const account_object&>( after );
+   if( _owner != a.owner || _active != a.active )
+      _cache->account_changed( a.id );
+}
+
+} } // graphene::chain
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/transaction_location_database.hpp>
+
+#include <boost/endian/buffers.hpp>
+
+#include <cstring>
+#include <fstream>
+
+namespace graphene { namespace chain {
+
+namespace {
+
+const uint32_t location_file_magic   = 0x434f4c54u; // "TLOC"
+const uint32_t location_file_version = 1;
+const uint64_t initial_slot_count    = 1 << 20;
+
+struct location_file_header
+{
+   boost::endian::little_uint32_buf_t magic;
+   boost::endian::little_uint32_buf_t version;
+   boost::endian::little_uint64_buf_t slot_count;
+   boost::endian::little_uint64_buf_t used_slots;
+   boost::endian::little_uint32_buf_t head_block_num;
+   boost::endian::little_uint32_buf_t reserved;
+};
+
+/// A slot with block_num 0 is empty, block 0 does not contain transactions
+struct location_slot
+{
+   char                               trx_id[sizeof(transaction_id_type)];
+   boost::endian::little_uint32_buf_t block_num;
+   boost::endian::little_uint32_buf_t trx_in_block;
+};
+
+location_file_header& header_of( char* base )
+{
+   return *reinterpret_cast<location_file_header*>( base );
+}
+
+location_slot* slots_of( char* base )
+{
+   return reinterpret_cast<location_slot*>( base + sizeof(location_file_header) );
+}
+
+uint64_t file_size_for( uint64_t slot_count )
+{
+   return sizeof(location_file_header) + slot_count * sizeof(location_slot);
+}
+
+/// Transaction ids are hashes, so their leading bytes are evenly distributed
+uint64_t first_slot( const transaction_id_type& id, uint64_t slot_count )
+{
+   boost::endian::little_uint64_buf_t prefix;
+   memcpy( (char*)&prefix, (const char*)id._hash, sizeof(prefix) );
+   return prefix.value() & ( slot_count - 1 );
+}
+
+/// @return true if a previously empty slot was used
+bool insert_into( char* base, const transaction_id_type& id, const transaction_location& location )
+{
+   const uint64_t slot_count = header_of( base ).slot_count.value();
+   location_slot* slots = slots_of( base );
+   for( uint64_t i = first_slot( id, slot_count ); ; i = ( i + 1 ) & ( slot_count - 1 ) )
+   {
+      location_slot& slot = slots[i];
+      const bool empty = ( slot.block_num.value() == 0 );
+      if( empty || memcmp( slot.trx_id, (const char*)id._hash, sizeof(slot.trx_id) ) == 0 )
+      {
+         memcpy( slot.trx_id, (const char*)id._hash, sizeof(slot.trx_id) );
+         slot.trx_in_block = location.trx_in_block;
+         slot.block_num = location.block_num;
+         return empty;
+      }
+   }
+}
+
+void create_file( const fc::path& filename, uint64_t slot_count, uint32_t head_block_num )
+{
+   location_file_header header;
+   header.magic = location_file_magic;
+   header.version = location_file_version;
+   header.slot_count = slot_count;
+   header.used_slots = 0;
+   header.head_block_num = head_block_num;
+   header.reserved = 0;
+   {
+      std::ofstream out( filename.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      FC_ASSERT( out, "Unable to create ${f}", ("f", filename) );
+      out.write( (const char*)&header, sizeof(header) );
+   }
+   // the slots are zero-filled, i. e. empty
+   fc::resize_file( filename, file_size_for( slot_count ) );
+}
+
+} // anonymous namespace
+
+void transaction_location_database::open( const fc::path& dbdir )
+{ try {
+   fc::create_directories( dbdir );
+   std::lock_guard<std::mutex> guard( _lock );
+   _filename = dbdir / "trx_locations";
+   if( !fc::exists( _filename ) )
+      create_file( _filename, initial_slot_count, 0 );
+
+   map_file();
+   const auto& header = header_of( base() );
+   const uint64_t slot_count = header.slot_count.value();
+   if( header.magic.value() != location_file_magic || header.version.value() != location_file_version
+         || slot_count == 0 || ( slot_count & ( slot_count - 1 ) ) != 0
+         || fc::file_size( _filename ) != file_size_for( slot_count ) )
+   {
+      wlog( "Transaction location database ${f} is incompatible or corrupt, recreating it", ("f", _filename) );
+      unmap_file();
+      create_file( _filename, initial_slot_count, 0 );
+      map_file();
+   }
+} FC_CAPTURE_AND_RETHROW( (dbdir) ) }
+
+bool transaction_location_database::is_open()const
+{
+   return _region != nullptr;
+}
+
+void transaction_location_database::flush()
+{
+   std::lock_guard<std::mutex> guard( _lock );
+   if( _region )
+      _region->flush();
+}
+
+void transaction_location_database::close()
+{
+   std::lock_guard<std::mutex> guard( _lock );
+   if( _region )
+      _region->flush();
+   unmap_file();
+}
+
+void transaction_location_database::store( const transaction_id_type& id, const transaction_location& location )
+{
+   FC_ASSERT( location.block_num > 0, "Transactions in block 0 cannot be stored" );
+   std::lock_guard<std::mutex> guard( _lock );
+   FC_ASSERT( _region, "Transaction location database is not open" );
+
+   if( ( header_of( base() ).used_slots.value() + 1 ) * 10 > header_of( base() ).slot_count.value() * 7 )
+      grow();
+
+   if( insert_into( base(), id, location ) )
+   {
+      auto& header = header_of( base() );
+      header.used_slots = header.used_slots.value() + 1;
+   }
+}
+
+optional<transaction_location> transaction_location_database::find( const transaction_id_type& id )const
+{
+   std::lock_guard<std::mutex> guard( _lock );
+   FC_ASSERT( _region, "Transaction location database is not open" );
+
+   const uint64_t slot_count = header_of( base() ).slot_count.value();
+   const location_slot* slots = slots_of( base() );
+   for( uint64_t i = first_slot( id, slot_count ); ; i = ( i + 1 ) & ( slot_count - 1 ) )
+   {
+      const location_slot& slot = slots[i];
+      if( slot.block_num.value() == 0 )
+         return optional<transaction_location>();
+      if( memcmp( slot.trx_id, (const char*)id._hash, sizeof(slot.trx_id) ) == 0 )
+      {
+         transaction_location result;
+         result.block_num = slot.block_num.value();
+         result.trx_in_block = slot.trx_in_block.value();
+         return result;
+      }
+   }
+}
+
+uint32_t transaction_location_database::head_block_num()const
+{
+   std::lock_guard<std::mutex> guard( _lock );
+   FC_ASSERT( _region, "Transaction location database is not open" );
+   return header_of( base() ).head_block_num.value();
+}
+
+void transaction_location_database::set_head_block_num( uint32_t block_num )
+{
+   std::lock_guard<std::mutex> guard( _lock );
+   FC_ASSERT( _region, "Transaction location database is not open" );
+   header_of( base() ).head_block_num = block_num;
+}
+
+uint64_t transaction_location_database::size()const
+{
+   std::lock_guard<std::mutex> guard( _lock );
+   FC_ASSERT( _region, "Transaction location database is not open" );
+   return header_of( base() ).used_slots.value();
+}
+
+void transaction_location_database::map_file()
+{
+   _mapping = std::make_unique<fc::file_mapping>( _filename.generic_string().c_str(), fc::read_write );
+   _region = std::make_unique<fc::mapped_region>( *_mapping, fc::read_write );
+}
+
+void transaction_location_database::unmap_file()
+{
+   _region.reset();
+   _mapping.reset();
+}
+
+void transaction_location_database::grow()
+{ try {
+   const auto& old_header = header_of( base() );
+   const uint64_t old_slot_count = old_header.slot_count.value();
+   const uint64_t new_slot_count = old_slot_count * 2;
+   ilog( "Growing transaction location database to ${n} slots", ("n", new_slot_count) );
+
+   const fc::path tmp_filename = _filename.parent_path() / "trx_locations.tmp";
+   create_file( tmp_filename, new_slot_count, old_header.head_block_num.value() );
+   {
+      fc::file_mapping new_mapping( tmp_filename.generic_string().c_str(), fc::read_write );
+      fc::mapped_region new_region( new_mapping, fc::read_write );
+      char* new_base = (char*)new_region.get_address();
+
+      const location_slot* old_slots = slots_of( base() );
+      uint64_t used = 0;
+      for( uint64_t i = 0; i < old_slot_count; ++i )
+      {
+         const location_slot& slot = old_slots[i];
+         if( slot.block_num.value() == 0 )
+            continue;
+         transaction_id_type id;
+         memcpy( (char*)id._hash, slot.trx_id, sizeof(slot.trx_id) );
+         transaction_location location;
+         location.block_num = slot.block_num.value();
+         location.trx_in_block = slot.trx_in_block.value();
+         insert_into( new_base, id, location );
+         ++used;
+      }
+      header_of( new_base ).used_slots = used;
+      new_region.flush();
+   }
+
+   unmap_file();
+   fc::rename( tmp_filename, _filename );
+   map_file();
+} FC_CAPTURE_AND_RETHROW() }
+
+} }
@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/vote_tally.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/vesting_balance_object.hpp>
+
+namespace graphene { namespace chain {
+
+bool operator == ( const voter_contribution& a, const voter_contribution& b )
+{
+   return a.votes == b.votes
+          && a.witness_count_offset == b.witness_count_offset && a.witness_count_stake == b.witness_count_stake
+          && a.committee_count_offset == b.committee_count_offset
+          && a.committee_count_stake == b.committee_count_stake
+          && a.total_voting_stake[0] == b.total_voting_stake[0] && a.total_voting_stake[1] == b.total_voting_stake[1]
+          && a.recalc_time == b.recalc_time;
+}
+
+void vote_tally_tracker::reset()
+{
+   *this = vote_tally_tracker();
+}
+
+bool vote_tally_tracker::is_synced( time_point_sec next_maintenance_time, const vote_tally_parameters& params )const
+{
+   return _synced && _synced_next_maintenance_time == next_maintenance_time && _synced_params == params;
+}
+
+void vote_tally_tracker::set_synced( time_point_sec next_maintenance_time, const vote_tally_parameters& params )
+{
+   _synced = true;
+   _synced_next_maintenance_time = next_maintenance_time;
+   _synced_params = params;
+}
+
+void vote_tally_tracker::mark_changed( account_id_type account, bool opinion_changed )
+{
+   _changed.insert( account );
+   if( opinion_changed )
+      _opinion_changed.insert( account );
+   if( _recording )
+   {
+      _recorded.push_back( account );
+      if( opinion_changed )
+      {
+         auto itr = _proxied_by.find( account );
+         if( itr != _proxied_by.end() )
+            _recorded.insert( _recorded.end(), itr->second.begin(), itr->second.end() );
+      }
+   }
+}
+
+void vote_tally_tracker::set_voting_account( account_id_type account, account_id_type old_proxy,
+                                             account_id_type new_proxy )
+{
+   if( old_proxy == new_proxy )
+      return;
+   if( old_proxy != GRAPHENE_PROXY_TO_SELF_ACCOUNT )
+   {
+      auto itr = _proxied_by.find( old_proxy );
+      if( itr != _proxied_by.end() )
+      {
+         itr->second.erase( account );
+         if( itr->second.empty() )
+            _proxied_by.erase( itr );
+      }
+   }
+   if( new_proxy != GRAPHENE_PROXY_TO_SELF_ACCOUNT )
+      _proxied_by[new_proxy].insert( account );
+}
+
+std::set< account_id_type > vote_tally_tracker::take_changed( time_point_sec now )
+{
+   std::set< account_id_type > result;
+   result.swap( _changed );
+   for( account_id_type account : _opinion_changed )
+   {
+      auto itr = _proxied_by.find( account );
+      if( itr != _proxied_by.end() )
+         result.insert( itr->second.begin(), itr->second.end() );
+   }
+   _opinion_changed.clear();
+   for( auto itr = _recalc_queue.begin(); itr != _recalc_queue.end() && itr->first <= now; ++itr )
+      result.insert( itr->second );
+   return result;
+}
+
+void vote_tally_tracker::clear_changes()
+{
+   _changed.clear();
+   _opinion_changed.clear();
+}
+
+vector< account_id_type > vote_tally_tracker::take_recorded()
+{
+   vector< account_id_type > result;
+   result.swap( _recorded );
+   return result;
+}
+
+void vote_tally_tracker::reset_tally( const vector<uint64_t>& vote_tally,
+                                      const vector<uint64_t>& witness_count_histogram,
+                                      const vector<uint64_t>& committee_count_histogram,
+                                      const uint64_t (&total_voting_stake)[2] )
+{
+   _vote_tally = vote_tally;
+   _witness_count_histogram = witness_count_histogram;
+   _committee_count_histogram = committee_count_histogram;
+   _total_voting_stake[0] = total_voting_stake[0];
+   _total_voting_stake[1] = total_voting_stake[1];
+   _contributions.clear();
+   _recalc_queue.clear();
+}
+
+void vote_tally_tracker::load_contribution( account_id_type account, voter_contribution&& contribution )
+{
+   if( contribution.empty() )
+      return;
+   if( contribution.recalc_time != time_point_sec::maximum() )
+      _recalc_queue.emplace( contribution.recalc_time, account );
+   _contributions[account] = std::move( contribution );
+}
+
+void vote_tally_tracker::update_contribution( account_id_type account, voter_contribution&& contribution )
+{
+   auto itr = _contributions.find( account );
+   if( itr != _contributions.end() )
+   {
+      apply( itr->second, false );
+      _recalc_queue.erase( std::make_pair( itr->second.recalc_time, account ) );
+      _contributions.erase( itr );
+   }
+   if( contribution.empty() )
+      return;
+   apply( contribution, true );
+   load_contribution( account, std::move( contribution ) );
+}
+
+void vote_tally_tracker::resize( size_t vote_ids )
+{
+   if( _vote_tally.size() < vote_ids )
+      _vote_tally.resize( vote_ids, 0 );
+}
+
+const voter_contribution* vote_tally_tracker::find_contribution( account_id_type account )const
+{
+   auto itr = _contributions.find( account );
+   return itr == _contributions.end() ? nullptr : &itr->second;
+}
+
+void vote_tally_tracker::apply( const voter_contribution& contribution, bool add )
+{
+   // the totals are sums of unsigned contributions, so subtracting a contribution which was added never wraps
+   auto update = [add]( uint64_t& total, uint64_t stake ) {
+      if( add )
+         total += stake;
+      else
+         total -= stake;
+   };
+   for( const auto& vote : contribution.votes )
+      update( _vote_tally[vote.first], vote.second );
+   if( contribution.witness_count_stake > 0 )
+      update( _witness_count_histogram[contribution.witness_count_offset], contribution.witness_count_stake );
+   if( contribution.committee_count_stake > 0 )
+      update( _committee_count_histogram[contribution.committee_count_offset], contribution.committee_count_stake );
+   update( _total_voting_stake[0], contribution.total_voting_stake[0] );
+   update( _total_voting_stake[1], contribution.total_voting_stake[1] );
+}
+
+void vote_tally_tracker::verify_totals()const
+{
+   vote_tally_tracker sum;
+   sum._vote_tally.resize( _vote_tally.size(), 0 );
+   sum._witness_count_histogram.resize( _witness_count_histogram.size(), 0 );
+   sum._committee_count_histogram.resize( _committee_count_histogram.size(), 0 );
+   for( const auto& item : _contributions )
+      sum.apply( item.second, true );
+   FC_ASSERT( sum._vote_tally == _vote_tally, "Incremental vote tally does not match the voter contributions" );
+   FC_ASSERT( sum._witness_count_histogram == _witness_count_histogram
+              && sum._committee_count_histogram == _committee_count_histogram,
+              "Incremental vote count histograms do not match the voter contributions" );
+   FC_ASSERT( sum._total_voting_stake[0] == _total_voting_stake[0]
+              && sum._total_voting_stake[1] == _total_voting_stake[1],
+              "Incremental total voting stake does not match the voter contributions" );
+}
+
+void vote_tally_account_observer::object_inserted( const object& obj )
+{
+   const account_object& a = static_cast<const account_object&>( obj );
+   _tracker->set_voting_account( a.id, GRAPHENE_PROXY_TO_SELF_ACCOUNT, a.options.voting_account );
+   _tracker->mark_changed( a.id, false );
+}
+
+void vote_tally_account_observer::objects_loaded( const vector<const object*>& objs )
+{
+   // the tally is rebuilt in full after loading, only the proxies are needed
+   for( const object* obj : objs )
+   {
+      const account_object& a = static_cast<const account_object&>( *obj );
+      _tracker->set_voting_account( a.id, GRAPHENE_PROXY_TO_SELF_ACCOUNT, a.options.voting_account );
+   }
+}
+
+void vote_tally_account_observer::object_removed( const object& obj )
+{
+   const account_object& a = static_cast<const account_object&>( obj );
+   _tracker->set_voting_account( a.id, a.options.voting_account, GRAPHENE_PROXY_TO_SELF_ACCOUNT );
+   _tracker->mark_changed( a.id, true );
+}
+
+void vote_tally_account_observer::about_to_modify( const object& before )
+{
+   const account_object& a = static_cast<const account_object&>( before );
+   _options = a.options;
+   _num_committee_voted = a.num_committee_voted;
+   _cashback_vb = a.cashback_vb;
+   _membership_expiration_date = a.membership_expiration_date;
+}
+
+void vote_tally_account_observer::object_modified( const object& after )
+{
+   const account_object& a = static_cast<const account_object&>( after );
+   _tracker->set_voting_account( a.id, _options.voting_account, a.options.voting_account );
+   const bool opinion_changed = _options.votes != a.options.votes
+                                || _options.num_witness != a.options.num_witness
+                                || _options.num_committee != a.options.num_committee
+                                || _num_committee_voted != a.num_committee_voted;
+   if( opinion_changed || _options.voting_account != a.options.voting_account
+         || _cashback_vb != a.cashback_vb || _membership_expiration_date != a.membership_expiration_date )
+      _tracker->mark_changed( a.id, opinion_changed );
+}
+
+vote_tally_stats_observer::voting_state vote_tally_stats_observer::get_voting_state( const object& obj )
+{
+   const account_statistics_object& s = static_cast<const account_statistics_object&>( obj );
+   voting_state result;
+   result.total_core_in_orders = s.total_core_in_orders;
+   result.core_in_balance = s.core_in_balance;
+   result.total_core_pol = s.total_core_pol;
+   result.total_core_pob = s.total_core_pob;
+   result.total_core_inactive = s.total_core_inactive;
+   result.total_pol_value = s.total_pol_value;
+   result.total_pob_value = s.total_pob_value;
+   result.is_voting = s.is_voting;
+   result.has_cashback_vb = s.has_cashback_vb;
+   result.has_pending_fees = s.has_pending_fees();
+   result.last_vote_time = s.last_vote_time;
+   return result;
+}
+
+void vote_tally_stats_observer::object_inserted( const object& obj )
+{
+   _tracker->mark_changed( static_cast<const account_statistics_object&>( obj ).owner, false );
+}
+
+void vote_tally_stats_observer::object_removed( const object& obj )
+{
+   _tracker->mark_changed( static_cast<const account_statistics_object&>( obj ).owner, false );
+}
+
+void vote_tally_stats_observer::about_to_modify( const object& before )
+{
+   _before = get_voting_state( before );
+}
+
+void vote_tally_stats_observer::object_modified( const object& after )
+{
+   const voting_state now = get_voting_state( after );
+   const bool opinion_changed = ( _before.last_vote_time != now.last_vote_time );
+   // accounts whose fees became pending need to be visited by the maintenance to process them
+   if( opinion_changed || ( now.has_pending_fees && !_before.has_pending_fees )
+         || _before.total_core_in_orders != now.total_core_in_orders
+         || _before.core_in_balance != now.core_in_balance
+         || _before.total_core_pol != now.total_core_pol
+         || _before.total_core_pob != now.total_core_pob
+         || _before.total_core_inactive != now.total_core_inactive
+         || _before.total_pol_value != now.total_pol_value
+         || _before.total_pob_value != now.total_pob_value
+         || _before.is_voting != now.is_voting
+         || _before.has_cashback_vb != now.has_cashback_vb )
+      _tracker->mark_changed( static_cast<const account_statistics_object&>( after ).owner, opinion_changed );
+}
+
+void vote_tally_vesting_observer::object_inserted( const object& obj )
+{
+   const vesting_balance_object& vbo = static_cast<const vesting_balance_object&>( obj );
+   if( vbo.balance_type == vesting_balance_type::cashback )
+      _tracker->mark_changed( vbo.owner, false );
+}
+
+void vote_tally_vesting_observer::object_removed( const object& obj )
+{
+   object_inserted( obj );
+}
+
+void vote_tally_vesting_observer::object_modified( const object& after )
+{
+   object_inserted( after );
+}
+
+} } // graphene::chain
@@ -27,12 +27,40 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/mem_fun.hpp>
+#include <boost/mpl/size.hpp>
 
 namespace graphene { namespace db {
 
    using boost::multi_index_container;
    using namespace boost::multi_index;
 
+   namespace detail {
+      /** reserves buckets in hashed indices, other index types cannot preallocate */
+      template<typename Index>
+      auto reserve_if_hashed( Index& idx, size_t count, int ) -> decltype( idx.reserve( count ), void() )
+      {
+         idx.reserve( count );
+      }
+      template<typename Index>
+      void reserve_if_hashed( Index&, size_t, long ) {}
+
+      template<typename Container, int N = 0,
+               int Count = boost::mpl::size<typename Container::index_type_list>::value>
+      struct reserve_hashed_indices
+      {
+         static void apply( Container& c, size_t count )
+         {
+            reserve_if_hashed( c.template get<N>(), count, 0 );
+            reserve_hashed_indices<Container, N + 1, Count>::apply( c, count );
+         }
+      };
+      template<typename Container, int Count>
+      struct reserve_hashed_indices<Container, Count, Count>
+      {
+         static void apply( Container&, size_t ) {}
+      };
+   }
+
    struct by_id;
    /**
     *  Almost all objects can be tracked and managed via a boost::multi_index container that uses
@@ -68,8 +96,15 @@ namespace graphene { namespace db {
          virtual void modify( const object& obj, const std::function<void(object&)>& m )override
          {
             assert(nullptr != dynamic_cast<const ObjectType*>(&obj));
+            static_modify( static_cast<const ObjectType&>(obj), m );
+         }
+
+         /** Modifies @p obj by calling @p m directly, @see primary_index::static_modify */
+         template<typename Lambda>
+         void static_modify( const ObjectType& obj, const Lambda& m )
+         {
             std::exception_ptr exc;
-            auto ok = _indices.modify(_indices.iterator_to(static_cast<const ObjectType&>(obj)),
+            auto ok = _indices.modify(_indices.iterator_to(obj),
                                        [&m, &exc](ObjectType& o) mutable {
                                           try {
                                              m(o);
@@ -112,6 +147,12 @@ namespace graphene { namespace db {
 
          const index_type& indices()const { return _indices; }
 
+         /** Preallocates room for @p count objects before a bulk load */
+         void reserve( size_t count )
+         {
+            detail::reserve_hashed_indices<index_type>::apply( _indices, count );
+         }
+
       private:
          index_type  _indices;
    };
@@ -30,7 +30,9 @@
 #include <fc/crypto/sha256.hpp>
 
 #include <fstream>
+#include <map>
 #include <stack>
+#include <unordered_set>
 
 namespace graphene { namespace db {
    class object_database;
@@ -48,6 +50,8 @@ namespace graphene { namespace db {
          virtual void on_add( const object& obj ){}
          /** called just before obj is removed */
          virtual void on_remove( const object& obj ){}
+         /** called just before obj is modified, with its old value */
+         virtual void about_to_modify( const object& obj ){}
          /** called just after obj is modified with new value*/
          virtual void on_modify( const object& obj ){}
    };
@@ -99,6 +103,25 @@ namespace graphene { namespace db {
          virtual void open( const fc::path& db ) = 0;
          virtual void save( const fc::path& db ) = 0;
 
+         /**
+          *  Opens the index from a full snapshot, then applies the deltas written by @ref save_changes
+          *  since the snapshot was taken, oldest first
+          */
+         virtual void open( const fc::path& db, const std::vector< std::vector<char> >& deltas ) = 0;
+
+         /**
+          *  Writes the objects that were added, modified or removed since the last call to @ref save or
+          *  @ref save_changes as a delta, and starts a new set of changes. Changes are only tracked if
+          *  the object database has incremental checkpoints enabled.
+          *  @return false if nothing has changed, in which case nothing is written
+          */
+         virtual bool save_changes( std::ostream& out ) = 0;
+
+         /** Serializes @p obj, which must belong to this index, e.g. to save the undo history */
+         virtual std::vector<char> pack_object( const object& obj )const = 0;
+         /** Deserializes an object written by @ref pack_object and passes it to @p use */
+         virtual void unpack_object( const std::vector<char>& data,
+                                     const std::function<void(const object&)>& use )const = 0;
 
 
          /** @return the object with id or nullptr if not found */
@@ -141,6 +164,12 @@ namespace graphene { namespace db {
       public:
          virtual ~secondary_index(){};
          virtual void object_inserted( const object& obj ){};
+         /** called instead of object_inserted for objects loaded from disk, in batches */
+         virtual void objects_loaded( const vector<const object*>& objs )
+         {
+            for( const object* obj : objs )
+               object_inserted( *obj );
+         }
          virtual void object_removed( const object& obj ){};
          virtual void about_to_modify( const object& before ){};
          virtual void object_modified( const object& after  ){};
@@ -185,8 +214,13 @@ namespace graphene { namespace db {
          }
 
       protected:
+         /** records that obj has to be written by the next incremental checkpoint */
+         void mark_changed( const object& obj );
+
          vector< shared_ptr<index_observer> >   _observers;
          vector< unique_ptr<secondary_index> >  _sindex;
+         /** instances changed since the last save, see @ref index::save_changes */
+         std::unordered_set<uint64_t>           _changed_instances;
 
       private:
          object_database& _db;
@@ -252,6 +286,15 @@ namespace graphene { namespace db {
             content[instance >> chunkbits][instance & _mask] = static_cast<const Object*>( &obj );
          }
 
+         virtual void objects_loaded( const vector<const object*>& objs )
+         {
+            uint64_t max_instance = 0;
+            for( const object* obj : objs )
+               max_instance = std::max( max_instance, obj->id.instance() );
+            content.reserve( ( max_instance >> chunkbits ) + 1 );
+            secondary_index::objects_loaded( objs );
+         }
+
          virtual void object_removed( const object& obj )
          {
             FC_ASSERT( nullptr != dynamic_cast<const Object*>(&obj), "Wrong object type!" );
@@ -343,22 +386,97 @@ namespace graphene { namespace db {
          }
 
          virtual void open( const path& db )override
-         { 
-            if( !fc::exists( db ) ) return;
-            fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
-            fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
-            fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
-            fc::sha256 open_ver;
-
-            fc::raw::unpack(ds, _next_id);
-            fc::raw::unpack(ds, open_ver);
-            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
-            vector<char> tmp;
-            while( ds.remaining() > 0 )
+         {
+            open( db, std::vector< std::vector<char> >() );
+         }
+
+         virtual void open( const path& db, const std::vector< std::vector<char> >& deltas )override
+         {
+            // latest state of every object touched by the deltas, an empty optional if it was removed
+            std::map< uint64_t, fc::optional< std::vector<char> > > changed;
+            fc::optional<object_id_type> delta_next_id;
+            for( const auto& delta : deltas )
             {
-               fc::raw::unpack( ds, tmp );
-               load( tmp );
+               fc::datastream<const char*> ds( delta.data(), delta.size() );
+               object_id_type next_id;
+               fc::raw::unpack( ds, next_id );
+               delta_next_id = next_id;
+               uint64_t count = 0;
+               fc::raw::unpack( ds, count );
+               for( uint64_t i = 0; i < count; ++i )
+               {
+                  uint64_t instance = 0;
+                  bool present = false;
+                  fc::raw::unpack( ds, instance );
+                  fc::raw::unpack( ds, present );
+                  auto& entry = changed[instance];
+                  entry.reset();
+                  if( present )
+                  {
+                     entry = std::vector<char>();
+                     fc::raw::unpack( ds, *entry );
+                  }
+               }
+            }
+
+            if( fc::exists( db ) )
+            {
+               fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
+               fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
+               fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
+               fc::sha256 open_ver;
+
+               fc::raw::unpack(ds, _next_id);
+               fc::raw::unpack(ds, open_ver);
+               FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+
+               // count the records first, so that the containers can be sized in advance
+               size_t count = 0;
+               {
+                  fc::datastream<const char*> scan( ds.pos(), ds.remaining() );
+                  while( scan.remaining() > 0 )
+                  {
+                     fc::unsigned_int size;
+                     fc::raw::unpack( scan, size );
+                     FC_ASSERT( scan.remaining() >= size.value, "Truncated object in ${db}", ("db",db) );
+                     scan.skip( size.value );
+                     ++count;
+                  }
+               }
+               DerivedIndex::reserve( count );
+
+               // unpack every object straight from the mapped file, notify secondary indexes in batches
+               const size_t batch_size = load_batch_size;
+               vector<const object*> loaded;
+               loaded.reserve( std::min( count, batch_size ) );
+               auto notify_loaded = [this,&loaded]() {
+                  for( const auto& item : _sindex )
+                     item->objects_loaded( loaded );
+                  loaded.clear();
+               };
+               while( ds.remaining() > 0 )
+               {
+                  fc::unsigned_int size;
+                  fc::raw::unpack( ds, size );
+                  fc::datastream<const char*> obj_ds( ds.pos(), size.value );
+                  ds.skip( size.value );
+                  object_type obj;
+                  fc::raw::unpack( obj_ds, obj );
+                  if( !changed.empty() && changed.find( obj.id.instance() ) != changed.end() )
+                     continue;
+                  const object& result = DerivedIndex::insert( std::move(obj) );
+                  loaded.push_back( &result );
+                  if( loaded.size() >= batch_size )
+                     notify_loaded();
+               }
+               notify_loaded();
             }
+
+            for( const auto& item : changed )
+               if( item.second.valid() )
+                  load( *item.second );
+            if( delta_next_id.valid() )
+               _next_id = *delta_next_id;
          }
 
          virtual void save( const path& db ) override 
@@ -374,6 +492,36 @@ namespace graphene { namespace db {
                 auto packed_vec = fc::raw::pack( vec );
                 out.write( packed_vec.data(), packed_vec.size() );
             });
+            _changed_instances.clear();
+         }
+
+         virtual bool save_changes( std::ostream& out )override
+         {
+            if( _changed_instances.empty() )
+               return false;
+            fc::raw::pack( out, _next_id );
+            fc::raw::pack( out, uint64_t( _changed_instances.size() ) );
+            for( const uint64_t instance : _changed_instances )
+            {
+               const object* obj = find( object_id_type( object_type::space_id, object_type::type_id, instance ) );
+               fc::raw::pack( out, instance );
+               fc::raw::pack( out, obj != nullptr );
+               if( obj != nullptr )
+                  fc::raw::pack( out, fc::raw::pack( static_cast<const object_type&>(*obj) ) );
+            }
+            _changed_instances.clear();
+            return true;
+         }
+
+         virtual std::vector<char> pack_object( const object& obj )const override
+         {
+            return fc::raw::pack( static_cast<const object_type&>( obj ) );
+         }
+
+         virtual void unpack_object( const std::vector<char>& data,
+                                     const std::function<void(const object&)>& use )const override
+         {
+            use( fc::raw::unpack<object_type>( data ) );
          }
 
          virtual const object&  load( const std::vector<char>& data )override
@@ -422,6 +570,23 @@ namespace graphene { namespace db {
             on_modify( obj );
          }
 
+         /**
+          *  Statically dispatched version of @ref modify, used by @ref object_database::modify for objects
+          *  mapped to this index with @ref MAP_OBJECT_TO_PRIMARY_INDEX. The modifier is called directly by
+          *  the derived index instead of through a std::function.
+          */
+         template<typename Lambda>
+         void static_modify( const object_type& obj, const Lambda& m )
+         {
+            save_undo( obj );
+            for( const auto& item : _sindex )
+               item->about_to_modify( obj );
+            DerivedIndex::static_modify( obj, m );
+            for( const auto& item : _sindex )
+               item->object_modified( obj );
+            on_modify( obj );
+         }
+
          virtual void add_observer( const shared_ptr<index_observer>& o ) override
          {
             _observers.emplace_back( o );
@@ -446,8 +611,29 @@ namespace graphene { namespace db {
          }
 
       private:
+         /** number of loaded objects passed to secondary indexes at once */
+         static const size_t load_batch_size = 4096;
+
          object_id_type                                 _next_id;
          const direct_index< object_type, DirectBits >* _direct_by_id = nullptr;
    };
 
+   /**
+    *  The primary index that holds objects of type Object, if it is known at compile time.
+    *  @see MAP_OBJECT_TO_PRIMARY_INDEX
+    */
+   template<typename Object>
+   struct primary_index_of { using type = void; };
+
 } } // graphene::db
+
+/**
+ *  Declares the primary index type of OBJECT, which must match the type passed to
+ *  @ref graphene::db::object_database::add_index. Modifications of mapped objects bypass the virtual
+ *  @ref graphene::db::index::modify and are inlined into the caller. Use at global scope.
+ */
+#define MAP_OBJECT_TO_PRIMARY_INDEX(OBJECT, ...) \
+   namespace graphene { namespace db { \
+   template<> \
+   struct primary_index_of<OBJECT> { using type = __VA_ARGS__; }; \
+   } }
@@ -27,6 +27,9 @@
 #include <fc/io/raw.hpp>
 #include <fc/crypto/city.hpp>
 
+#include <cstddef>
+#include <new>
+
 #define MAX_NESTING (200)
 
 namespace graphene { namespace db {
@@ -70,6 +73,9 @@ namespace graphene { namespace db {
 
          /// these methods are implemented for derived classes by inheriting abstract_object<DerivedClass>
          virtual unique_ptr<object> clone()const = 0;
+         /// copy-constructs this object in @p memory, which must hold @ref dynamic_size bytes aligned for any type
+         virtual object*            clone_into( void* memory )const = 0;
+         virtual size_t             dynamic_size()const = 0;
          virtual void               move_from( object& obj ) = 0;
          virtual variant            to_variant()const  = 0;
          virtual vector<char>       pack()const = 0;
@@ -91,6 +97,14 @@ namespace graphene { namespace db {
             return unique_ptr<object>( std::make_unique<DerivedClass>( *static_cast<const DerivedClass*>(this) ) );
          }
 
+         virtual object* clone_into( void* memory )const
+         {
+            static_assert( alignof(DerivedClass) <= alignof(std::max_align_t), "Over-aligned objects are not supported" );
+            return new (memory) DerivedClass( *static_cast<const DerivedClass*>(this) );
+         }
+
+         virtual size_t dynamic_size()const { return sizeof(DerivedClass); }
+
          virtual void    move_from( object& obj )
          {
             static_cast<DerivedClass&>(*this) = std::move( static_cast<DerivedClass&>(obj) );
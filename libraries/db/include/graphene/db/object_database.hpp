@@ -29,6 +29,7 @@
 #include <fc/log/logger.hpp>
 
 #include <map>
+#include <type_traits>
 
 namespace graphene { namespace db {
 
@@ -48,8 +49,43 @@ namespace graphene { namespace db {
 
          /**
           * Saves the complete state of the object_database to disk, this could take a while
+          *
+          * The undo history is saved along with the objects, and restored by @ref open.
           */
          void flush();
+
+         /**
+          * Saves the objects that changed since the last flush or checkpoint as a delta on top of the last
+          * full snapshot, which is much faster than @ref flush for large databases. Falls back to a full
+          * @ref flush if incremental checkpoints are disabled, if there is no snapshot yet, or if the deltas
+          * have grown large enough to be compacted into a new snapshot.
+          */
+         void checkpoint();
+
+         /**
+          * Enable or disable tracking of changed objects for incremental checkpoints, must be called
+          * before @ref open
+          * @param enable whether @ref checkpoint writes deltas
+          * @param max_deltas number of deltas after which the next checkpoint writes a full snapshot
+          */
+         void enable_incremental_checkpoints( bool enable, uint32_t max_deltas = 16 )
+         {
+            _incremental_checkpoints = enable;
+            _max_checkpoint_deltas = max_deltas;
+         }
+         bool incremental_checkpoints_enabled()const { return _incremental_checkpoints; }
+
+         /**
+          * The changed objects are remembered in memory until the next checkpoint. Once more than
+          * @p max_changed_objects have changed, @ref checkpoint_due tells the caller to save them early.
+          * 0 disables the limit.
+          */
+         void set_max_changed_objects( uint64_t max_changed_objects ) { _max_changed_objects = max_changed_objects; }
+         /** @return true if so many objects changed since the last save that a checkpoint should be written now */
+         bool checkpoint_due()const
+         {
+            return _incremental_checkpoints && _max_changed_objects > 0 && _changed_objects > _max_changed_objects;
+         }
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
@@ -75,8 +111,16 @@ namespace graphene { namespace db {
          const index&  get_index()const { return get_index(T::space_id,T::type_id); }
          const index&  get_index(uint8_t space_id, uint8_t type_id)const;
          const index&  get_index(object_id_type id)const { return get_index(id.space(),id.type()); }
+         /** @return the index for space_id and type_id, or nullptr if there is none */
+         const index*  find_index(uint8_t space_id, uint8_t type_id)const;
          /// @}
 
+         /// Registers @p observer for the changes of the index of space_id and type_id, see @ref index_observer
+         void add_index_observer( uint8_t space_id, uint8_t type_id, const shared_ptr<index_observer>& observer )
+         {
+            get_mutable_index( space_id, type_id ).add_observer( observer );
+         }
+
          const object& get_object( object_id_type id )const;
          const object* find_object( object_id_type id )const;
 
@@ -86,9 +130,13 @@ namespace graphene { namespace db {
 
          const object& insert( object&& obj ) { return get_mutable_index(obj.id).insert( std::move(obj) ); }
          void          remove( const object& obj ) { get_mutable_index(obj.id).remove( obj ); }
+         /**
+          * Objects mapped with @ref MAP_OBJECT_TO_PRIMARY_INDEX are modified through their known index type,
+          * all others through the virtual @ref index::modify.
+          */
          template<typename T, typename Lambda>
          void modify( const T& obj, const Lambda& m ) {
-            get_mutable_index(obj.id).modify(obj,m);
+            dispatch_modify( obj, m, std::is_void<typename primary_index_of<T>::type>() );
          }
 
          ///@}
@@ -135,6 +183,9 @@ namespace graphene { namespace db {
          IndexType* add_index()
          {
             typedef typename IndexType::object_type ObjectType;
+            typedef typename primary_index_of<ObjectType>::type mapped_index_type;
+            static_assert( std::is_void<mapped_index_type>::value || std::is_same<mapped_index_type, IndexType>::value,
+                           "IndexType differs from the index declared with MAP_OBJECT_TO_PRIMARY_INDEX" );
             if( _index[ObjectType::space_id].size() <= ObjectType::type_id  )
                 _index[ObjectType::space_id].resize( 255 );
             assert(!_index[ObjectType::space_id][ObjectType::type_id]);
@@ -167,6 +218,16 @@ namespace graphene { namespace db {
          index& get_mutable_index(uint8_t space_id, uint8_t type_id);
 
      private:
+         template<typename T, typename Lambda>
+         void dispatch_modify( const T& obj, const Lambda& m, std::true_type /* no mapped index */ ) {
+            get_mutable_index(obj.id).modify(obj,m);
+         }
+         template<typename T, typename Lambda>
+         void dispatch_modify( const T& obj, const Lambda& m, std::false_type /* mapped index */ ) {
+            typedef typename primary_index_of<T>::type index_type;
+            assert( obj.id.space() == T::space_id && obj.id.type() == T::type_id );
+            static_cast<index_type&>( get_mutable_index( T::space_id, T::type_id ) ).static_modify( obj, m );
+         }
 
          friend class base_primary_index;
          friend class undo_database;
@@ -174,8 +235,23 @@ namespace graphene { namespace db {
          void save_undo_add( const object& obj );
          void save_undo_remove( const object& obj );
 
+         /// Writes the undo history to @p file, or removes the file if there is nothing to save
+         bool save_undo_history( const fc::path& file )const;
+
+         /// Total size of the index files of the current full snapshot
+         uint64_t snapshot_size()const;
+
          fc::path                                                  _data_dir;
          vector< vector< unique_ptr<index> > >                     _index;
+
+         bool                                                      _incremental_checkpoints = false;
+         uint32_t                                                  _max_checkpoint_deltas = 16;
+         /// Number and total size of the deltas on top of the current snapshot
+         uint32_t                                                  _checkpoint_deltas = 0;
+         uint64_t                                                  _checkpoint_delta_size = 0;
+         /// Number of objects changed since the last save, and the limit for @ref checkpoint_due
+         uint64_t                                                  _changed_objects = 0;
+         uint64_t                                                  _max_changed_objects = 1000000;
    };
 
 } } // graphene::db
@@ -59,6 +59,14 @@ namespace graphene { namespace db {
             modify_callback( *_objects[obj.id.instance()] );
          }
 
+         /** Modifies @p obj by calling @p m directly, @see primary_index::static_modify */
+         template<typename Lambda>
+         void static_modify( const T& obj, const Lambda& m )
+         {
+            assert( obj.id.instance() < _objects.size() );
+            m( static_cast<T&>( *_objects[obj.id.instance()] ) );
+         }
+
          virtual const object& insert( object&& obj )override
          {
             auto instance = obj.id.instance();
@@ -88,6 +96,9 @@ namespace graphene { namespace db {
             return _objects[instance].get();
          }
 
+         /** Preallocates room for @p count objects before a bulk load */
+         void reserve( size_t count ) { _objects.reserve( count ); }
+
          virtual void inspect_all_objects(std::function<void (const object&)> inspector)const override
          {
             try {
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/object.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /**
+    * @brief A free list of memory blocks shared by the arenas of one @ref undo_database
+    *
+    * Not thread safe, the undo database is only used by the thread that applies transactions and blocks.
+    */
+   class undo_memory_pool
+   {
+      public:
+         static const size_t block_size = 64 * 1024;
+
+         explicit undo_memory_pool( size_t max_free_blocks = 256 ) : _max_free_blocks( max_free_blocks ) {}
+         ~undo_memory_pool();
+         undo_memory_pool( const undo_memory_pool& ) = delete;
+         undo_memory_pool& operator=( const undo_memory_pool& ) = delete;
+
+         /// Returns a block of at least @p size bytes, @p size is updated to the actual size
+         char* acquire( size_t& size );
+         /// Takes back a block returned by @ref acquire
+         void  release( char* block, size_t size );
+
+         size_t free_blocks()const { return _free.size(); }
+
+      private:
+         size_t              _max_free_blocks;
+         std::vector<char*>  _free;
+   };
+
+   /**
+    * @brief A bump allocator that owns the memory of one undo state
+    *
+    * Nothing is freed individually. All blocks go back to the pool at once when the arena is destroyed.
+    */
+   class undo_arena
+   {
+      public:
+         explicit undo_arena( undo_memory_pool& pool ) : _pool( pool ) {}
+         ~undo_arena();
+         undo_arena( const undo_arena& ) = delete;
+         undo_arena& operator=( const undo_arena& ) = delete;
+
+         void* allocate( size_t size );
+
+         /// Total size of the blocks owned by this arena
+         size_t capacity()const { return _capacity; }
+
+      private:
+         struct block
+         {
+            char*  data;
+            size_t size;
+         };
+
+         undo_memory_pool&  _pool;
+         std::vector<block> _blocks;
+         char*              _next = nullptr;
+         size_t             _left = 0;
+         size_t             _capacity = 0;
+   };
+
+   /// Destroys an object that was cloned into an @ref undo_arena, without freeing its memory
+   struct undo_object_deleter
+   {
+      void operator()( object* obj )const { obj->~object(); }
+   };
+
+   /// An object saved in an undo state, its memory is owned by the arena of the state
+   typedef std::unique_ptr<object, undo_object_deleter> undo_object_ptr;
+
+} } // graphene::db
@@ -23,7 +23,10 @@
  */
 #pragma once
 #include <graphene/db/object.hpp>
+#include <graphene/db/undo_arena.hpp>
+#include <graphene/db/undo_id_table.hpp>
 #include <deque>
+#include <iosfwd>
 #include <fc/exception/exception.hpp>
 
 namespace graphene { namespace db {
@@ -32,12 +35,38 @@ namespace graphene { namespace db {
    using fc::flat_set;
    class object_database;
 
+   /// Expected number of entries of a new undo state, derived from recent states
+   struct undo_state_size_hint
+   {
+      size_t old_values = 0;
+      size_t old_index_next_ids = 0;
+      size_t new_ids = 0;
+      size_t removed = 0;
+   };
+
+   /**
+    * The changes recorded by one undo session. Saved objects and the slots of the tables are allocated from the
+    * arena of the state, so the whole state is freed at once when it is undone, committed or merged. The tables
+    * are sized from the sizes of recent states.
+    */
    struct undo_state
    {
-      unordered_map<object_id_type, unique_ptr<object> > old_values;
-      unordered_map<object_id_type, object_id_type>      old_index_next_ids;
-      std::unordered_set<object_id_type>                 new_ids;
-      unordered_map<object_id_type, unique_ptr<object> > removed;
+      typedef undo_id_table<undo_object_ptr>  object_map;
+      typedef undo_id_table<object_id_type>   id_map;
+      typedef undo_id_table<void>             id_set;
+
+      undo_state( undo_memory_pool& pool, const undo_state_size_hint& hint );
+      undo_state( const undo_state& ) = delete;
+      undo_state& operator=( const undo_state& ) = delete;
+
+      /// Copies @p obj into the arena of this state
+      undo_object_ptr save( const object& obj );
+
+      undo_arena  arena; // must be destroyed last
+      object_map  old_values;
+      id_map      old_index_next_ids;
+      id_set      new_ids;
+      object_map  removed;
    };
 
 
@@ -123,13 +152,32 @@ namespace graphene { namespace db {
 
          const undo_state& head()const;
 
+         /**
+          * Writes the undo states to @p out, so that @ref load can restore them after the object database has
+          * been reopened in the state it had when they were written. Nothing is written while sessions are
+          * active, as their states would not match the saved objects.
+          * @return false if nothing was written
+          */
+         bool save( std::ostream& out )const;
+         /// Replaces the undo states by the ones written by @ref save, requires that no session is active
+         void load( const std::vector<char>& data );
+         /// Drops all undo states without undoing them, requires that no session is active
+         void clear();
+
       private:
          void undo();
          void merge();
          void commit();
 
+         /// Starts a new undo state on top of the stack
+         void push_state();
+         /// Adjusts the size hint for new states to the sizes of a state that is about to be dropped
+         void update_size_hint( const undo_state& state );
+
          uint32_t                _active_sessions = 0;
          bool                    _disabled = true;
+         undo_memory_pool        _pool; // must outlive the states in _stack
+         undo_state_size_hint    _size_hint;
          std::deque<undo_state>  _stack;
          object_database&        _db;
          size_t                  _max_size = 256;
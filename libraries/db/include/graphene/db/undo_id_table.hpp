@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/undo_arena.hpp>
+#include <fc/exception/exception.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace graphene { namespace db {
+
+   /// An entry of an @ref undo_id_table that maps ids to values
+   template<typename Value>
+   struct undo_id_slot
+   {
+      object_id_type first;
+      Value          second;
+   };
+
+   /**
+    * @brief An open-addressing hash table keyed by object id, with its slots allocated from an @ref undo_arena
+    *
+    * Maps ids to @p Value, or is a set of ids if @p Value is void, in which case iterating it yields the ids.
+    * Lookups probe linearly, erasing shifts the following entries back, so no slot is left behind as a tombstone.
+    * Growing allocates a new slot array of twice the size from the arena; the old one is only freed with the arena,
+    * which bounds the waste by the final table size. Sizing the table from the expected number of entries
+    * avoids growing at all in the common case.
+    *
+    * Inserting or erasing invalidates all iterators.
+    */
+   template<typename Value>
+   class undo_id_table
+   {
+      public:
+         typedef typename std::conditional< std::is_void<Value>::value,
+                                            object_id_type, undo_id_slot<Value> >::type slot_type;
+
+         template<typename Slot>
+         class basic_iterator
+         {
+            public:
+               basic_iterator( Slot* pos, Slot* end ) : _pos( pos ), _end( end ) { skip_empty(); }
+
+               Slot& operator*()const  { return *_pos; }
+               Slot* operator->()const { return _pos; }
+               basic_iterator& operator++() { ++_pos; skip_empty(); return *this; }
+               bool operator==( const basic_iterator& other )const { return _pos == other._pos; }
+               bool operator!=( const basic_iterator& other )const { return _pos != other._pos; }
+
+            private:
+               friend class undo_id_table;
+               void skip_empty() { while( _pos != _end && key_of( *_pos ) == empty_key() ) ++_pos; }
+
+               Slot* _pos;
+               Slot* _end;
+         };
+         typedef basic_iterator<slot_type>       iterator;
+         typedef basic_iterator<const slot_type> const_iterator;
+
+         undo_id_table( undo_arena& arena, size_t expected_size ) : _arena( arena )
+         {
+            allocate( capacity_for( expected_size ) );
+         }
+         ~undo_id_table() { destroy( _slots, _capacity ); }
+         undo_id_table( const undo_id_table& ) = delete;
+         undo_id_table& operator=( const undo_id_table& ) = delete;
+
+         size_t size()const  { return _size; }
+         bool   empty()const { return _size == 0; }
+
+         iterator       begin()       { return iterator( _slots, _slots + _capacity ); }
+         iterator       end()         { return iterator( _slots + _capacity, _slots + _capacity ); }
+         const_iterator begin()const  { return const_iterator( _slots, _slots + _capacity ); }
+         const_iterator end()const    { return const_iterator( _slots + _capacity, _slots + _capacity ); }
+
+         iterator find( object_id_type id )
+         {
+            const size_t pos = position_of( id );
+            return key_of( _slots[pos] ) == empty_key() ? end() : iterator( _slots + pos, _slots + _capacity );
+         }
+         const_iterator find( object_id_type id )const
+         {
+            const size_t pos = position_of( id );
+            return key_of( _slots[pos] ) == empty_key() ? end() : const_iterator( _slots + pos, _slots + _capacity );
+         }
+         size_t count( object_id_type id )const { return find( id ) != end() ? 1 : 0; }
+
+         /**
+          * Adds an entry for @p id with a default value, unless there is one already
+          * @return the entry of @p id and whether it was added
+          */
+         std::pair<iterator, bool> insert( object_id_type id )
+         {
+            FC_ASSERT( id.number != empty_key(), "Invalid object id" );
+            size_t pos = position_of( id );
+            if( key_of( _slots[pos] ) != empty_key() )
+               return std::make_pair( iterator( _slots + pos, _slots + _capacity ), false );
+            if( ( _size + 1 ) * 4 > _capacity * 3 )
+            {
+               grow();
+               pos = position_of( id );
+            }
+            key_of( _slots[pos] ) = id.number;
+            ++_size;
+            return std::make_pair( iterator( _slots + pos, _slots + _capacity ), true );
+         }
+
+         size_t erase( object_id_type id )
+         {
+            auto itr = find( id );
+            if( itr == end() )
+               return 0;
+            erase( itr );
+            return 1;
+         }
+
+         void erase( iterator itr )
+         {
+            size_t hole = itr._pos - _slots;
+            const size_t mask = _capacity - 1;
+            // move back the following entries of the probe sequence that may not be found past the hole
+            for( size_t next = ( hole + 1 ) & mask; key_of( _slots[next] ) != empty_key(); next = ( next + 1 ) & mask )
+            {
+               const size_t home = home_of( key_of( _slots[next] ) );
+               if( ( ( next - home ) & mask ) >= ( ( next - hole ) & mask ) )
+               {
+                  _slots[hole] = std::move( _slots[next] );
+                  hole = next;
+               }
+            }
+            _slots[hole] = slot_type();
+            key_of( _slots[hole] ) = empty_key();
+            --_size;
+         }
+
+      private:
+         static uint64_t  empty_key() { return std::numeric_limits<uint64_t>::max(); }
+         static uint64_t& key_of( object_id_type& slot ) { return slot.number; }
+         static uint64_t  key_of( const object_id_type& slot ) { return slot.number; }
+         template<typename V>
+         static uint64_t& key_of( undo_id_slot<V>& slot ) { return slot.first.number; }
+         template<typename V>
+         static uint64_t  key_of( const undo_id_slot<V>& slot ) { return slot.first.number; }
+
+         /// Ids are mostly sequential, multiplying spreads them over the table
+         size_t home_of( uint64_t key )const { return ( key * 0x9e3779b97f4a7c15ull ) >> _shift; }
+
+         /// Slot of @p id, or the empty slot where it would be inserted
+         size_t position_of( object_id_type id )const
+         {
+            const size_t mask = _capacity - 1;
+            size_t pos = home_of( id.number );
+            while( key_of( _slots[pos] ) != empty_key() && key_of( _slots[pos] ) != id.number )
+               pos = ( pos + 1 ) & mask;
+            return pos;
+         }
+
+         static size_t capacity_for( size_t entries )
+         {
+            size_t capacity = 8;
+            while( entries * 4 > capacity * 3 )
+               capacity *= 2;
+            return capacity;
+         }
+
+         void allocate( size_t capacity )
+         {
+            _slots = static_cast<slot_type*>( _arena.allocate( capacity * sizeof(slot_type) ) );
+            _capacity = capacity;
+            _shift = 64;
+            for( size_t c = capacity; c > 1; c /= 2 )
+               --_shift;
+            for( size_t i = 0; i < capacity; ++i )
+            {
+               new( _slots + i ) slot_type();
+               key_of( _slots[i] ) = empty_key();
+            }
+         }
+
+         static void destroy( slot_type* slots, size_t capacity )
+         {
+            for( size_t i = 0; i < capacity; ++i )
+               slots[i].~slot_type();
+         }
+
+         void grow()
+         {
+            slot_type* old_slots = _slots;
+            const size_t old_capacity = _capacity;
+            allocate( old_capacity * 2 );
+            for( size_t i = 0; i < old_capacity; ++i )
+            {
+               if( key_of( old_slots[i] ) != empty_key() )
+               {
+                  object_id_type id;
+                  id.number = key_of( old_slots[i] );
+                  _slots[ position_of( id ) ] = std::move( old_slots[i] );
+               }
+            }
+            destroy( old_slots, old_capacity );
+         }
+
+         undo_arena& _arena;
+         slot_type*  _slots = nullptr;
+         size_t      _capacity = 0;
+         size_t      _size = 0;
+         unsigned    _shift = 64;
+   };
+
+} } // graphene::db
@@ -27,8 +27,32 @@
 #include <fc/container/flat.hpp>
 #include <fc/thread/parallel.hpp>
 
+#include <fstream>
+#include <map>
+#include <sstream>
+
 namespace graphene { namespace db {
 
+namespace {
+
+/// Deltas are compacted into a new snapshot once they are this large relative to the snapshot
+const uint64_t max_delta_size_percent = 50;
+
+fc::path delta_file( const fc::path& dir, uint32_t number )
+{
+   return dir / ( "delta." + fc::to_string( uint64_t(number) ) );
+}
+
+/// The undo history that was current when the snapshot or delta @p number was written
+fc::path undo_file( const fc::path& dir, uint32_t number )
+{
+   if( number == 0 )
+      return dir / "undo";
+   return dir / ( "undo." + fc::to_string( uint64_t(number) ) );
+}
+
+} // anonymous namespace
+
 object_database::object_database()
 :_undo_db(*this)
 {
@@ -59,6 +83,12 @@ const index& object_database::get_index(uint8_t space_id, uint8_t type_id)const
    FC_ASSERT( tmp );
    return *tmp;
 }
+const index* object_database::find_index(uint8_t space_id, uint8_t type_id)const
+{
+   if( _index.size() <= space_id || _index[space_id].size() <= type_id )
+      return nullptr;
+   return _index[space_id][type_id].get();
+}
 index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
 {
    FC_ASSERT( _index.size() > space_id, "", ("space_id",space_id)("type_id",type_id)("index.size",_index.size()) );
@@ -86,11 +116,114 @@ void object_database::flush()
    }
    for( auto& task : tasks )
       task.wait();
+   _changed_objects = 0;
+   save_undo_history( undo_file( _data_dir / "object_database.tmp", 0 ) );
    fc::remove_all( _data_dir / "object_database.tmp" / "lock" );
    if( fc::exists( _data_dir / "object_database" ) )
       fc::rename( _data_dir / "object_database", _data_dir / "object_database.old" );
    fc::rename( _data_dir / "object_database.tmp", _data_dir / "object_database" );
    fc::remove_all( _data_dir / "object_database.old" );
+   _checkpoint_deltas = 0;
+   _checkpoint_delta_size = 0;
+}
+
+void object_database::checkpoint()
+{
+   const fc::path dir = _data_dir / "object_database";
+   if( !_incremental_checkpoints || !fc::exists( dir ) || fc::exists( dir / "lock" )
+         || _checkpoint_deltas >= _max_checkpoint_deltas )
+   {
+      flush();
+      return;
+   }
+
+   // serialize the changes of all indexes in parallel, each into its own section of the delta
+   struct section
+   {
+      uint8_t            space = 0;
+      uint8_t            type = 0;
+      std::ostringstream data;
+      bool               changed = false;
+   };
+   std::vector< std::unique_ptr<section> > sections;
+   std::vector<fc::future<void>> tasks;
+   tasks.reserve(200);
+   for( uint32_t space = 0; space < _index.size(); ++space )
+      for( uint32_t type = 0; type < _index[space].size(); ++type )
+         if( _index[space][type] )
+         {
+            sections.push_back( std::make_unique<section>() );
+            section* sec = sections.back().get();
+            sec->space = uint8_t(space);
+            sec->type = uint8_t(type);
+            tasks.push_back( fc::do_parallel( [this,space,type,sec] () {
+               sec->changed = _index[space][type]->save_changes( sec->data );
+            } ) );
+         }
+   for( auto& task : tasks )
+      task.wait();
+   _changed_objects = 0;
+
+   const fc::path tmp_file = dir / "delta.tmp";
+   {
+      std::ofstream out( tmp_file.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      FC_ASSERT( out, "Unable to create ${f}", ("f", tmp_file) );
+      for( const auto& sec : sections )
+      {
+         if( !sec->changed )
+            continue;
+         const std::string data = sec->data.str();
+         fc::raw::pack( out, sec->space );
+         fc::raw::pack( out, sec->type );
+         fc::raw::pack( out, fc::unsigned_int( uint32_t( data.size() ) ) );
+         out.write( data.data(), data.size() );
+      }
+      out.flush();
+      FC_ASSERT( out, "Unable to write ${f}", ("f", tmp_file) );
+   }
+   const uint64_t delta_size = fc::file_size( tmp_file );
+   // the undo history of the delta is in place before the delta itself, so that every complete delta has one
+   const fc::path tmp_undo_file = dir / "undo.tmp";
+   if( save_undo_history( tmp_undo_file ) )
+      fc::rename( tmp_undo_file, undo_file( dir, _checkpoint_deltas + 1 ) );
+   fc::rename( tmp_file, delta_file( dir, _checkpoint_deltas + 1 ) );
+   fc::remove( undo_file( dir, _checkpoint_deltas ) );
+   ++_checkpoint_deltas;
+   _checkpoint_delta_size += delta_size;
+
+   // the deltas are complete at this point, so a crash during compaction does not lose anything
+   if( _checkpoint_delta_size * 100 > snapshot_size() * max_delta_size_percent )
+   {
+      ilog( "Compacting ${n} object database deltas into a new snapshot", ("n", _checkpoint_deltas) );
+      flush();
+   }
+}
+
+bool object_database::save_undo_history( const fc::path& file )const
+{
+   std::ofstream out( file.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+   FC_ASSERT( out, "Unable to create ${f}", ("f", file) );
+   const bool saved = _undo_db.save( out );
+   out.flush();
+   FC_ASSERT( out, "Unable to write ${f}", ("f", file) );
+   out.close();
+   if( !saved )
+      fc::remove( file );
+   return saved;
+}
+
+uint64_t object_database::snapshot_size()const
+{
+   uint64_t result = 0;
+   const fc::path dir = _data_dir / "object_database";
+   for( uint32_t space = 0; space < _index.size(); ++space )
+      for( uint32_t type = 0; type < _index[space].size(); ++type )
+      {
+         const fc::path file = dir / fc::to_string(space) / fc::to_string(type);
+         if( _index[space][type] && fc::exists( file ) )
+            result += fc::file_size( file );
+      }
+   return result;
 }
 
 void object_database::wipe(const fc::path& data_dir)
@@ -98,28 +231,96 @@ void object_database::wipe(const fc::path& data_dir)
    close();
    ilog("Wiping object database...");
    fc::remove_all(data_dir / "object_database");
+   // leftovers of an interrupted flush() would otherwise be recovered by open()
+   fc::remove_all(data_dir / "object_database.tmp");
+   fc::remove_all(data_dir / "object_database.old");
+   _checkpoint_deltas = 0;
+   _checkpoint_delta_size = 0;
    ilog("Done wiping object database.");
 }
 
 void object_database::open(const fc::path& data_dir)
 { try {
    _data_dir = data_dir;
+   if( !fc::exists( _data_dir / "object_database" ) )
+   {
+      // flush() was interrupted between moving the old snapshot away and moving the new one in place
+      if( fc::exists( _data_dir / "object_database.tmp" )
+            && !fc::exists( _data_dir / "object_database.tmp" / "lock" ) )
+      {
+         wlog( "Recovering the object database from an interrupted save" );
+         fc::rename( _data_dir / "object_database.tmp", _data_dir / "object_database" );
+      }
+      else if( fc::exists( _data_dir / "object_database.old" ) )
+      {
+         wlog( "Recovering the object database from the previous snapshot" );
+         fc::rename( _data_dir / "object_database.old", _data_dir / "object_database" );
+      }
+   }
    if( fc::exists( _data_dir / "object_database" / "lock" ) )
    {
        wlog("Ignoring locked object_database");
        return;
    }
+   ilog("Opening object database from ${d} ...", ("d", data_dir));
+
+   // deltas of incremental checkpoints, split by index
+   std::map< std::pair<uint8_t,uint8_t>, std::vector< std::vector<char> > > deltas;
+   _checkpoint_deltas = 0;
+   _checkpoint_delta_size = 0;
+   while( fc::exists( delta_file( _data_dir / "object_database", _checkpoint_deltas + 1 ) ) )
+   {
+      const fc::path file = delta_file( _data_dir / "object_database", ++_checkpoint_deltas );
+      std::vector<char> content( fc::file_size( file ) );
+      {
+         std::ifstream in( file.generic_string(), std::ifstream::binary );
+         in.read( content.data(), content.size() );
+         FC_ASSERT( in, "Unable to read ${f}", ("f", file) );
+      }
+      _checkpoint_delta_size += content.size();
+      fc::datastream<const char*> ds( content.data(), content.size() );
+      while( ds.remaining() > 0 )
+      {
+         uint8_t space = 0;
+         uint8_t type = 0;
+         fc::raw::unpack( ds, space );
+         fc::raw::unpack( ds, type );
+         deltas[ std::make_pair( space, type ) ].emplace_back();
+         fc::raw::unpack( ds, deltas[ std::make_pair( space, type ) ].back() );
+      }
+   }
+   if( _checkpoint_deltas > 0 )
+      ilog( "Applying ${n} incremental checkpoints", ("n", _checkpoint_deltas) );
+
    std::vector<fc::future<void>> tasks;
    tasks.reserve(200);
-   ilog("Opening object database from ${d} ...", ("d", data_dir));
+   const std::vector< std::vector<char> > no_deltas;
    for( uint32_t space = 0; space < _index.size(); ++space )
       for( uint32_t type = 0; type  < _index[space].size(); ++type )
          if( _index[space][type] )
-            tasks.push_back( fc::do_parallel( [this,space,type] () {
-               _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
+         {
+            auto itr = deltas.find( std::make_pair( uint8_t(space), uint8_t(type) ) );
+            const auto* index_deltas = ( itr == deltas.end() ? &no_deltas : &itr->second );
+            tasks.push_back( fc::do_parallel( [this,space,type,index_deltas] () {
+               _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type),
+                                          *index_deltas );
             } ) );
+         }
    for( auto& task : tasks )
       task.wait();
+
+   const fc::path undo_history = undo_file( _data_dir / "object_database", _checkpoint_deltas );
+   if( fc::exists( undo_history ) )
+   {
+      std::vector<char> content( fc::file_size( undo_history ) );
+      {
+         std::ifstream in( undo_history.generic_string(), std::ifstream::binary );
+         in.read( content.data(), content.size() );
+         FC_ASSERT( in, "Unable to read ${f}", ("f", undo_history) );
+      }
+      _undo_db.load( content );
+      ilog( "Restored ${n} undo states", ("n", _undo_db.size()) );
+   }
    ilog( "Done opening object database." );
 
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
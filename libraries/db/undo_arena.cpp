@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/db/undo_arena.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace db {
+
+undo_memory_pool::~undo_memory_pool()
+{
+   for( char* block : _free )
+      delete[] block;
+}
+
+char* undo_memory_pool::acquire( size_t& size )
+{
+   if( size <= block_size )
+   {
+      size = block_size;
+      if( !_free.empty() )
+      {
+         char* result = _free.back();
+         _free.pop_back();
+         return result;
+      }
+   }
+   return new char[size];
+}
+
+void undo_memory_pool::release( char* block, size_t size )
+{
+   if( size == block_size && _free.size() < _max_free_blocks )
+      _free.push_back( block );
+   else
+      delete[] block;
+}
+
+undo_arena::~undo_arena()
+{
+   for( const auto& b : _blocks )
+      _pool.release( b.data, b.size );
+}
+
+void* undo_arena::allocate( size_t size )
+{
+   const size_t alignment = alignof(std::max_align_t);
+   size = std::max<size_t>( ( size + alignment - 1 ) & ~( alignment - 1 ), alignment );
+   if( size > _left )
+   {
+      size_t block_size = size;
+      char* data = _pool.acquire( block_size );
+      _blocks.push_back( block{ data, block_size } );
+      _capacity += block_size;
+      _next = data;
+      _left = block_size;
+   }
+   void* result = _next;
+   _next += size;
+   _left -= size;
+   return result;
+}
+
+} } // graphene::db
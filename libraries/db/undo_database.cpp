@@ -24,10 +24,42 @@
  */
 #include <graphene/db/object_database.hpp>
 #include <graphene/db/undo_database.hpp>
+#include <fc/io/raw.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <ostream>
+
 namespace graphene { namespace db {
 
+undo_state::undo_state( undo_memory_pool& pool, const undo_state_size_hint& hint )
+: arena( pool ),
+  old_values( arena, hint.old_values ),
+  old_index_next_ids( arena, hint.old_index_next_ids ),
+  new_ids( arena, hint.new_ids ),
+  removed( arena, hint.removed )
+{
+}
+
+undo_object_ptr undo_state::save( const object& obj )
+{
+   return undo_object_ptr( obj.clone_into( arena.allocate( obj.dynamic_size() ) ) );
+}
+
+void undo_database::push_state()
+{
+   _stack.emplace_back( _pool, _size_hint );
+}
+
+void undo_database::update_size_hint( const undo_state& state )
+{
+   // moving average over the last few states, so that a single large block does not dominate
+   auto blend = []( size_t hint, size_t size ) { return ( hint * 7 + size ) / 8; };
+   _size_hint.old_values = blend( _size_hint.old_values, state.old_values.size() );
+   _size_hint.old_index_next_ids = blend( _size_hint.old_index_next_ids, state.old_index_next_ids.size() );
+   _size_hint.new_ids = blend( _size_hint.new_ids, state.new_ids.size() );
+   _size_hint.removed = blend( _size_hint.removed, state.removed.size() );
+}
+
 void undo_database::enable()  { _disabled = false; }
 void undo_database::disable() { _disabled = true; }
 
@@ -54,7 +86,7 @@ undo_database::session undo_database::start_undo_session( bool force_enable )
    while( size() > max_size() )
       _stack.pop_front();
 
-   _stack.emplace_back();
+   push_state();
    ++_active_sessions;
    return session(*this, disable_on_exit );
 }
@@ -63,12 +95,12 @@ void undo_database::on_create( const object& obj )
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    auto& state = _stack.back();
    auto index_id = object_id_type( obj.id.space(), obj.id.type(), 0 );
-   auto itr = state.old_index_next_ids.find( index_id );
-   if( itr == state.old_index_next_ids.end() )
-      state.old_index_next_ids[index_id] = obj.id;
+   auto result = state.old_index_next_ids.insert( index_id );
+   if( result.second )
+      result.first->second = obj.id;
    state.new_ids.insert(obj.id);
 }
 void undo_database::on_modify( const object& obj )
@@ -76,34 +108,34 @@ void undo_database::on_modify( const object& obj )
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    auto& state = _stack.back();
    if( state.new_ids.find(obj.id) != state.new_ids.end() )
       return;
-   auto itr =  state.old_values.find(obj.id);
-   if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   auto result = state.old_values.insert(obj.id);
+   if( !result.second ) return;
+   result.first->second = state.save( obj );
 }
 void undo_database::on_remove( const object& obj )
 {
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    undo_state& state = _stack.back();
-   if( state.new_ids.count(obj.id) > 0 )
-   {
-      state.new_ids.erase(obj.id);
+   if( state.new_ids.erase(obj.id) > 0 )
       return;
-   }
-   if( state.old_values.count(obj.id) > 0 )
+   auto itr = state.old_values.find(obj.id);
+   if( itr != state.old_values.end() )
    {
-      state.removed[obj.id] = std::move(state.old_values[obj.id]);
-      state.old_values.erase(obj.id);
+      undo_object_ptr old_value = std::move(itr->second);
+      state.old_values.erase(itr);
+      state.removed.insert(obj.id).first->second = std::move(old_value);
       return;
    }
-   if( state.removed.count(obj.id) > 0 ) return;
-   state.removed[obj.id] = obj.clone();
+   auto result = state.removed.insert(obj.id);
+   if( !result.second ) return;
+   result.first->second = state.save( obj );
 }
 
 void undo_database::undo()
@@ -131,6 +163,7 @@ void undo_database::undo()
    for( auto& item : state.removed )
       _db.insert( std::move(*item.second) );
 
+   update_size_hint( state );
    _stack.pop_back();
    enable();
    --_active_sessions;
@@ -141,6 +174,7 @@ void undo_database::merge()
    FC_ASSERT( _active_sessions > 0 );
    if( _active_sessions == 1 && _stack.size() == 1 )
    {
+      update_size_hint( _stack.back() );
       _stack.pop_back();
       --_active_sessions;
       return;
@@ -207,7 +241,7 @@ void undo_database::merge()
       // del+upd -> N/A
       assert( prev_state.removed.find(obj.second->id) == prev_state.removed.end() );
       // nop+upd(was=Y) -> upd(was=Y), type B
-      prev_state.old_values[obj.second->id] = std::move(obj.second);
+      prev_state.old_values.insert(obj.second->id).first->second = prev_state.save( *obj.second );
    }
 
    // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
@@ -217,10 +251,11 @@ void undo_database::merge()
    // old_index_next_ids can only be updated, iterate over *+upd cases
    for( auto& item : state.old_index_next_ids )
    {
-      if( prev_state.old_index_next_ids.find( item.first ) == prev_state.old_index_next_ids.end() )
+      auto result = prev_state.old_index_next_ids.insert( item.first );
+      if( result.second )
       {
          // nop+upd(was=Y) -> upd(was=Y), type B
-         prev_state.old_index_next_ids[item.first] = item.second;
+         result.first->second = item.second;
          continue;
       }
       else
@@ -234,25 +269,28 @@ void undo_database::merge()
    // *+del
    for( auto& obj : state.removed )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.erase(obj.second->id) > 0 )
       {
          // new + del -> nop (type C)
-         prev_state.new_ids.erase(obj.second->id);
          continue;
       }
       auto it = prev_state.old_values.find(obj.second->id);
       if( it != prev_state.old_values.end() )
       {
          // upd(was=X) + del(was=Y) -> del(was=X)
-         prev_state.removed[obj.second->id] = std::move(it->second);
-         prev_state.old_values.erase(obj.second->id);
+         undo_object_ptr old_value = std::move(it->second);
+         prev_state.old_values.erase(it);
+         prev_state.removed.insert(obj.second->id).first->second = std::move(old_value);
          continue;
       }
       // del + del -> N/A
       assert( prev_state.removed.find( obj.second->id ) == prev_state.removed.end() );
       // nop + del(was=Y) -> del(was=Y)
-      prev_state.removed[obj.second->id] = std::move(obj.second);
+      prev_state.removed.insert(obj.second->id).first->second = prev_state.save( *obj.second );
    }
+   update_size_hint( state );
+   // the objects taken over were copied into the arena of prev_state, the memory of state goes back to the pool
+   // rather than growing a long-lived state such as the one of the pending transactions
    _stack.pop_back();
    --_active_sessions;
 }
@@ -305,4 +343,99 @@ const undo_state& undo_database::head()const
    return _stack.back();
 }
 
+bool undo_database::save( std::ostream& out )const
+{ try {
+   if( _active_sessions > 0 )
+      return false;
+   auto pack_objects = [this,&out]( const undo_state::object_map& objects ) {
+      fc::raw::pack( out, uint64_t( objects.size() ) );
+      for( const auto& item : objects )
+      {
+         fc::raw::pack( out, item.first );
+         fc::raw::pack( out, _db.get_index( item.first ).pack_object( *item.second ) );
+      }
+   };
+   fc::raw::pack( out, uint64_t( _max_size ) );
+   fc::raw::pack( out, uint64_t( _stack.size() ) );
+   for( const auto& state : _stack )
+   {
+      fc::raw::pack( out, uint64_t( state.old_index_next_ids.size() ) );
+      for( const auto& item : state.old_index_next_ids )
+      {
+         fc::raw::pack( out, item.first );
+         fc::raw::pack( out, item.second );
+      }
+      fc::raw::pack( out, uint64_t( state.new_ids.size() ) );
+      for( const auto& id : state.new_ids )
+         fc::raw::pack( out, id );
+      pack_objects( state.old_values );
+      pack_objects( state.removed );
+   }
+   return true;
+} FC_CAPTURE_AND_RETHROW() }
+
+void undo_database::load( const std::vector<char>& data )
+{ try {
+   FC_ASSERT( _active_sessions == 0, "Unable to load the undo history while sessions are active" );
+   _stack.clear();
+   try
+   {
+      fc::datastream<const char*> ds( data.data(), data.size() );
+      uint64_t max_size = 0;
+      uint64_t states = 0;
+      fc::raw::unpack( ds, max_size );
+      fc::raw::unpack( ds, states );
+      auto unpack_objects = [this,&ds]( undo_state& state, undo_state::object_map& objects ) {
+         uint64_t count = 0;
+         fc::raw::unpack( ds, count );
+         for( uint64_t i = 0; i < count; ++i )
+         {
+            object_id_type id;
+            std::vector<char> packed;
+            fc::raw::unpack( ds, id );
+            fc::raw::unpack( ds, packed );
+            _db.get_index( id ).unpack_object( packed, [&state,&objects,id]( const object& obj ) {
+               objects.insert( id ).first->second = state.save( obj );
+            });
+         }
+      };
+      for( uint64_t s = 0; s < states; ++s )
+      {
+         push_state();
+         undo_state& state = _stack.back();
+         uint64_t count = 0;
+         fc::raw::unpack( ds, count );
+         for( uint64_t i = 0; i < count; ++i )
+         {
+            object_id_type index_id;
+            object_id_type next_id;
+            fc::raw::unpack( ds, index_id );
+            fc::raw::unpack( ds, next_id );
+            state.old_index_next_ids.insert( index_id ).first->second = next_id;
+         }
+         fc::raw::unpack( ds, count );
+         for( uint64_t i = 0; i < count; ++i )
+         {
+            object_id_type id;
+            fc::raw::unpack( ds, id );
+            state.new_ids.insert( id );
+         }
+         unpack_objects( state, state.old_values );
+         unpack_objects( state, state.removed );
+      }
+      _max_size = std::max<size_t>( max_size, _stack.size() );
+   }
+   catch( ... )
+   {
+      _stack.clear();
+      throw;
+   }
+} FC_CAPTURE_AND_RETHROW() }
+
+void undo_database::clear()
+{
+   FC_ASSERT( _active_sessions == 0, "Unable to drop the undo history while sessions are active" );
+   _stack.clear();
+}
+
 } } // graphene::db
@@ -29,6 +29,9 @@ namespace graphene { namespace net {
 
   const core_message_type_enum trx_message::type                             = core_message_type_enum::trx_message_type;
   const core_message_type_enum block_message::type                           = core_message_type_enum::block_message_type;
+  const core_message_type_enum compact_block_message::type                   = core_message_type_enum::compact_block_message_type;
+  const core_message_type_enum fetch_compact_block_transactions_message::type = core_message_type_enum::fetch_compact_block_transactions_message_type;
+  const core_message_type_enum compact_block_transactions_message::type      = core_message_type_enum::compact_block_transactions_message_type;
   const core_message_type_enum item_ids_inventory_message::type              = core_message_type_enum::item_ids_inventory_message_type;
   const core_message_type_enum blockchain_item_ids_inventory_message::type   = core_message_type_enum::blockchain_item_ids_inventory_message_type;
   const core_message_type_enum fetch_blockchain_item_ids_message::type       = core_message_type_enum::fetch_blockchain_item_ids_message_type;
@@ -51,6 +54,20 @@ namespace graphene { namespace net {
 
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::trx_message, BOOST_PP_SEQ_NIL, (trx) )
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::block_message, BOOST_PP_SEQ_NIL, (block)(block_id) )
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::compact_block_transaction, BOOST_PP_SEQ_NIL,
+                                (trx_message_hash)
+                                (operation_results) )
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::compact_block_message, BOOST_PP_SEQ_NIL,
+                                (block_message_hash)
+                                (header)
+                                (block_id)
+                                (transactions) )
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::fetch_compact_block_transactions_message, BOOST_PP_SEQ_NIL,
+                                (block_message_hash)
+                                (transaction_indexes) )
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::compact_block_transactions_message, BOOST_PP_SEQ_NIL,
+                                (block_message_hash)
+                                (transactions) )
 
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::item_id, BOOST_PP_SEQ_NIL,
                                (item_type)
@@ -131,6 +148,10 @@ FC_REFLECT_DERIVED_NO_TYPENAME(graphene::net::get_current_connections_reply_mess
 
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::trx_message )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::block_message )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::compact_block_transaction )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::compact_block_message )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::fetch_compact_block_transactions_message )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::compact_block_transactions_message )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::item_id )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::item_ids_inventory_message )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::blockchain_item_ids_inventory_message )
@@ -25,7 +25,10 @@
 
 #include <stddef.h>
 
-#define GRAPHENE_NET_PROTOCOL_VERSION                        106
+#define GRAPHENE_NET_PROTOCOL_VERSION                        107
+
+/// The first protocol version which understands compact_block_message and its follow-up messages
+#define GRAPHENE_NET_COMPACT_BLOCK_PROTOCOL_VERSION          107
 
 /**
  * Define this to enable debugging code in the p2p network interface.
@@ -62,6 +65,12 @@
 
 #define GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES        (1024 * 1024)
 
+/**
+ * Number of messages of each send class (control, relay, sync, transaction inventory, address) a peer
+ * connection sends in one round of its scheduler while messages of the other classes are waiting
+ */
+#define GRAPHENE_NET_SEND_CLASS_WEIGHTS                      { 16, 8, 4, 2, 1 }
+
 /**
  * When we receive a message from the network, we advertise it to
  * our peers and save a copy in a cache were we will find it if
@@ -115,3 +124,9 @@
 
 constexpr size_t MAX_BLOCKS_TO_HANDLE_AT_ONCE = 200;
 constexpr size_t MAX_SYNC_BLOCKS_TO_PREFETCH = 10 * MAX_BLOCKS_TO_HANDLE_AT_ONCE;
+constexpr size_t MAX_SYNC_BLOCKS_TO_PREPARE = MAX_BLOCKS_TO_HANDLE_AT_ONCE;
+/// Transactions received from peers which may wait for the delegate at once, more than it batches together
+constexpr size_t MAX_TRANSACTIONS_TO_HANDLE_AT_ONCE = 1000;
+
+/// Number of compact block messages kept for the peers which request the same block
+#define GRAPHENE_NET_RECENT_COMPACT_BLOCKS                   8
@@ -85,6 +85,9 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    compact_block_message_type                   = 5018,
+    fetch_compact_block_transactions_message_type = 5019,
+    compact_block_transactions_message_type      = 5020,
     core_message_type_last                       = 5099
   };
 
@@ -114,6 +117,47 @@ namespace graphene { namespace net {
 
    };
 
+  /// A transaction of a compact block, identified by the id of the trx_message it was relayed in
+  struct compact_block_transaction
+  {
+    item_hash_t                                        trx_message_hash;
+    std::vector<graphene::protocol::operation_result>  operation_results;
+  };
+
+  /**
+   * Sent instead of a block_message to peers which support it, when the block was requested during normal
+   * operation. The receiver takes the transactions from the trx_messages it has relayed itself and asks for the
+   * missing ones with a fetch_compact_block_transactions_message.
+   */
+  struct compact_block_message
+  {
+    static const core_message_type_enum type;
+
+    /// The id of the block_message which was requested
+    item_hash_t                            block_message_hash;
+    graphene::protocol::signed_block_header header;
+    block_id_type                          block_id;
+    std::vector<compact_block_transaction> transactions;
+  };
+
+  /// Asks for the transactions of a compact block which the receiver did not have
+  struct fetch_compact_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    item_hash_t           block_message_hash;
+    std::vector<uint32_t> transaction_indexes;
+  };
+
+  /// The reply to a fetch_compact_block_transactions_message, in the order of the requested indexes
+  struct compact_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    item_hash_t                                          block_message_hash;
+    std::vector<graphene::protocol::signed_transaction> transactions;
+  };
+
   struct item_ids_inventory_message
   {
     static const core_message_type_enum type;
@@ -422,6 +466,9 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (compact_block_message_type)
+                 (fetch_compact_block_transactions_message_type)
+                 (compact_block_transactions_message_type)
                  (core_message_type_last) )
 FC_REFLECT_ENUM(graphene::net::rejection_reason_code, (unspecified)
                                                  (different_chain)
@@ -443,6 +490,10 @@ FC_REFLECT_ENUM(graphene::net::firewall_check_result, (unable_to_check)
 
 FC_REFLECT_TYPENAME( graphene::net::trx_message )
 FC_REFLECT_TYPENAME( graphene::net::block_message )
+FC_REFLECT_TYPENAME( graphene::net::compact_block_transaction )
+FC_REFLECT_TYPENAME( graphene::net::compact_block_message )
+FC_REFLECT_TYPENAME( graphene::net::fetch_compact_block_transactions_message )
+FC_REFLECT_TYPENAME( graphene::net::compact_block_transactions_message )
 FC_REFLECT_TYPENAME( graphene::net::item_id )
 FC_REFLECT_TYPENAME( graphene::net::item_ids_inventory_message )
 FC_REFLECT_TYPENAME( graphene::net::blockchain_item_ids_inventory_message )
@@ -466,6 +517,10 @@ FC_REFLECT_TYPENAME( graphene::net::get_current_connections_reply_message )
 
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::trx_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::block_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::compact_block_transaction )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::compact_block_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::fetch_compact_block_transactions_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::compact_block_transactions_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::item_id )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::item_ids_inventory_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::blockchain_item_ids_inventory_message )
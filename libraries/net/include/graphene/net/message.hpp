@@ -32,6 +32,8 @@
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/reflect/typename.hpp>
 
+#include <memory>
+
 namespace graphene { namespace net {
 
   /**
@@ -116,6 +118,25 @@ namespace graphene { namespace net {
      }
   };
 
+  /**
+   *  A message packed together with its header and zero-padded to a multiple of 16 bytes, which is what
+   *  a connection writes to its encrypted socket.  It is never modified once built, so one instance can be
+   *  queued for any number of peers instead of copying the message for each of them.
+   */
+  struct padded_message
+  {
+     uint32_t          msg_type;
+     std::vector<char> data;
+
+     explicit padded_message( const message& m );
+
+     /// number of bytes of the message without its header and padding
+     uint32_t message_size()const;
+     /// unpadded copy of the message
+     message to_message()const;
+  };
+  using padded_message_ptr = std::shared_ptr<const padded_message>;
+
 } } // graphene::net
 
 FC_REFLECT_TYPENAME( graphene::net::message_header )
@@ -52,6 +52,7 @@ namespace graphene { namespace net {
        void connect_to(const fc::ip::endpoint& remote_endpoint);
 
        void send_message(const message& message_to_send);
+       void send_message(const padded_message& message_to_send);
        void close_connection();
        void destroy_connection();
 
@@ -81,10 +81,22 @@ namespace graphene { namespace net {
          /**
           *  @brief Called when a new transaction comes in from the network
           *
+          *  @param trx_msg the message which contains the transaction
+          *  @param message_id the id of the message as received, so that the delegate can report it back
+          *         through @ref handle_block without serializing the transaction again
+          *
           *  @throws exception if error validating the item, otherwise the item is
           *          safe to broadcast on.
           */
-         virtual void handle_transaction( const graphene::net::trx_message& trx_msg ) = 0;
+         virtual void handle_transaction( const graphene::net::trx_message& trx_msg,
+                                          const message_hash_type& message_id ) = 0;
+
+         /**
+          *  @brief Called for a sync block which was received ahead of the blocks being handled, so that the
+          *         delegate can start the checks which do not depend on the chain state, e.g. of signatures,
+          *         while earlier blocks are applied. The block is still passed to @ref handle_block later on.
+          */
+         virtual void prepare_sync_block( const graphene::net::block_message& blk_msg ) = 0;
 
          /**
           *  @brief Called when a new message comes in from the network other than a
@@ -37,6 +37,8 @@
 #include <boost/multi_index/tag.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
+#include <array>
+#include <functional>
 #include <queue>
 #include <boost/container/deque.hpp>
 #include <fc/thread/future.hpp>
@@ -102,6 +104,44 @@ namespace graphene { namespace net
         closing,
         closed
       };
+      /** the classes of outgoing messages.  Each class has its own send queue, and the queues are served
+       * in weighted round robin so that relayed items don't wait behind a flood of inventory while the lower
+       * classes still get their share of the connection
+       */
+      enum class send_class
+      {
+        control,       // handshake, requests and the replies the peer is waiting for
+        relay,         // blocks and transactions relayed during normal operation and the block inventory.
+                       // They share one queue, so a compact block never overtakes the transactions it refers to
+        sync,          // blocks and block ids for a peer syncing from us
+        trx_inventory, // inventory of transactions
+        address,       // address gossip
+        count
+      };
+      static constexpr size_t send_class_count = (size_t)send_class::count;
+      /// @return the class of messages of type @p msg_type unless the sender knows better
+      static send_class get_send_class(uint32_t msg_type);
+
+      /** picks the send queue to serve next.  Within a round, each class with messages waiting sends up to
+       * its weight of messages, and the next round starts once all of them have used up their share, so no
+       * class with a non-zero weight starves
+       */
+      class send_scheduler
+      {
+        public:
+          /// uses GRAPHENE_NET_SEND_CLASS_WEIGHTS
+          send_scheduler();
+          explicit send_scheduler(const std::array<uint32_t, send_class_count>& weights);
+
+          /// @param has_messages tells whether a class has messages queued
+          /// @return the class whose turn it is to send, or send_class::count if nothing is queued
+          send_class next(const std::function<bool(send_class)>& has_messages);
+
+        private:
+          std::array<uint32_t, send_class_count> _weights;
+          /// how many more messages each class may send in the current round
+          std::array<uint32_t, send_class_count> _credits;
+      };
     private:
       peer_connection_delegate*      _node;
       fc::optional<fc::ip::endpoint> _remote_endpoint;
@@ -120,7 +160,7 @@ namespace graphene { namespace net
           enqueue_time(enqueue_time)
         {}
 
-        virtual message get_message(peer_connection_delegate* node) = 0;
+        virtual padded_message_ptr get_message(peer_connection_delegate* node) = 0;
         /** returns roughly the number of bytes of memory the message is consuming while
          * it is sitting on the queue
          */
@@ -129,7 +169,8 @@ namespace graphene { namespace net
       };
 
       /* when you queue up a 'real_queued_message', a full copy of the message is
-       * stored on the heap until it is sent
+       * stored on the heap until it is sent.  This is only used for messages which
+       * get the current time patched into them when they're sent
        */
       struct real_queued_message : queued_message
       {
@@ -142,7 +183,22 @@ namespace graphene { namespace net
           message_send_time_field_offset(message_send_time_field_offset)
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        padded_message_ptr get_message(peer_connection_delegate* node) override;
+        size_t get_size_in_queue() override;
+      };
+
+      /* when you queue up a 'shared_queued_message', we just hold a reference to the
+       * padded message, which may be queued for other peers at the same time
+       */
+      struct shared_queued_message : queued_message
+      {
+        padded_message_ptr message_to_send;
+
+        explicit shared_queued_message(padded_message_ptr message_to_send) :
+          message_to_send(std::move(message_to_send))
+        {}
+
+        padded_message_ptr get_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
@@ -158,13 +214,14 @@ namespace graphene { namespace net
           item_to_send(std::move(the_item_to_send))
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        padded_message_ptr get_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
 
       size_t _total_queued_messages_size = 0;
-      std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > > _queued_messages;
+      std::array<std::queue<std::unique_ptr<queued_message> >, send_class_count> _queued_messages;
+      send_scheduler _send_scheduler;
       fc::future<void> _send_queued_messages_done;
     public:
       fc::time_point connection_initiation_time;
@@ -251,6 +308,14 @@ namespace graphene { namespace net
       timestamped_items_set_type inventory_advertised_to_peer;
 
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
+
+      /// a compact block received from this peer whose missing transactions were requested
+      struct pending_compact_block
+      {
+        compact_block_message compact;
+        std::vector<fc::optional<graphene::protocol::signed_transaction> > transactions;
+      };
+      std::map<item_hash_t, pending_compact_block> pending_compact_blocks; /// by the id of the block message they stand for
       /// @}
 
       // if they're flooding us with transactions, we set this to avoid fetching for a few seconds to let the
@@ -281,9 +346,12 @@ namespace graphene { namespace net
       void on_message(message_oriented_connection* originating_connection, const message& received_message) override;
       void on_connection_closed(message_oriented_connection* originating_connection) override;
 
-      void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send);
+      void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send, send_class message_class);
       void send_message(const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
-      void send_item(const item_id& item_to_send);
+      void send_message(const message& message_to_send, send_class message_class);
+      void send_message(padded_message_ptr message_to_send);
+      void send_message(padded_message_ptr message_to_send, send_class message_class);
+      void send_item(const item_id& item_to_send, send_class message_class);
       void close_connection();
       void destroy_connection();
 
@@ -309,6 +377,8 @@ namespace graphene { namespace net
       bool performing_firewall_check() const;
       fc::optional<fc::ip::endpoint> get_endpoint_for_connecting() const;
     private:
+      /// @return the class whose turn it is to send, or send_class::count if nothing is queued
+      send_class get_next_send_class();
       void send_queued_messages_task();
       void accept_connection_task();
       void connect_to_task(const fc::ip::endpoint& remote_endpoint);
@@ -25,6 +25,35 @@
 
 #include <graphene/net/message.hpp>
 
+#include <cstring>
+
+namespace graphene { namespace net {
+
+  padded_message::padded_message( const message& m )
+  : msg_type( m.msg_type.value() ),
+    data( 16 * ((sizeof(message_header) + m.size.value() + 15) / 16) ) // value-initialized, so padded with 0
+  {
+     memcpy( data.data(), (const char*)&m, sizeof(message_header) );
+     memcpy( data.data() + sizeof(message_header), m.data.data(), m.size.value() );
+  }
+
+  uint32_t padded_message::message_size()const
+  {
+     message_header header;
+     memcpy( (char*)&header, data.data(), sizeof(message_header) );
+     return header.size.value();
+  }
+
+  message padded_message::to_message()const
+  {
+     message result;
+     memcpy( (char*)static_cast<message_header*>(&result), data.data(), sizeof(message_header) );
+     result.data.assign( data.data() + sizeof(message_header), data.data() + sizeof(message_header) + result.size.value() );
+     return result;
+  }
+
+} } // graphene::net
+
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::message_header, BOOST_PP_SEQ_NIL, (size)(msg_type) )
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::message, (graphene::net::message_header), (data) )
 
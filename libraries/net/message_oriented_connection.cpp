@@ -81,7 +81,7 @@ namespace graphene { namespace net {
                                        message_oriented_connection_delegate* delegate = nullptr);
       ~message_oriented_connection_impl();
 
-      void send_message(const message& message_to_send);
+      void send_message(const padded_message& message_to_send);
       void close_connection();
       void destroy_connection();
 
@@ -248,7 +248,7 @@ namespace graphene { namespace net {
         throw *exception_to_rethrow;
     }
 
-    void message_oriented_connection_impl::send_message(const message& message_to_send)
+    void message_oriented_connection_impl::send_message(const padded_message& message_to_send)
     {
       VERIFY_CORRECT_THREAD();
 #if 0 // this gets too verbose
@@ -268,21 +268,12 @@ namespace graphene { namespace net {
 
       try
       {
-        size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size.value();
-        if( message_to_send.size.value() > MAX_MESSAGE_SIZE )
+        if( message_to_send.message_size() > MAX_MESSAGE_SIZE )
            elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
-        //pad the message we send to a multiple of 16 bytes
-        size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::vector<char> padded_message( size_with_padding );
-
-        memcpy( padded_message.data(), (const char*)&message_to_send, sizeof(message_header) );
-        memcpy( padded_message.data() + sizeof(message_header), message_to_send.data.data(),
-                message_to_send.size.value() );
-        char* padding_space = padded_message.data() + sizeof(message_header) + message_to_send.size.value();
-        memset(padding_space, 0, size_with_padding - size_of_message_and_header);
-        _sock.write( padded_message.data(), size_with_padding );
+        // the message is already padded to a multiple of 16 bytes
+        _sock.write( message_to_send.data.data(), message_to_send.data.size() );
         _sock.flush();
-        _bytes_sent += size_with_padding;
+        _bytes_sent += message_to_send.data.size();
         _last_message_sent_time = fc::time_point::now();
       } FC_RETHROW_EXCEPTIONS( warn, "unable to send message" )
     }
@@ -385,6 +376,11 @@ namespace graphene { namespace net {
   }
 
   void message_oriented_connection::send_message(const message& message_to_send)
+  {
+    my->send_message(padded_message(message_to_send));
+  }
+
+  void message_oriented_connection::send_message(const padded_message& message_to_send)
   {
     my->send_message(message_to_send);
   }
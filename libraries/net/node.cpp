@@ -119,10 +119,20 @@ namespace graphene { namespace net { namespace detail {
       message_cache_container::index<message_hash_index>::type::const_iterator iter =
          _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
       if( iter != _message_cache.get<message_hash_index>().end() )
-         return iter->message_body;
+         return iter->padded_message_body->to_message();
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
    }
 
+   padded_message_ptr blockchain_tied_message_cache::get_padded_message(
+         const message_hash_type& hash_of_message_to_lookup ) const
+   {
+      message_cache_container::index<message_hash_index>::type::const_iterator iter =
+         _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
+      if( iter == _message_cache.get<message_hash_index>().end() )
+         FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+      return iter->padded_message_body;
+   }
+
     message_propagation_data blockchain_tied_message_cache::get_message_propagation_data(
              const message_hash_type& hash_of_msg_contents_to_lookup ) const
     {
@@ -701,7 +711,9 @@ namespace graphene { namespace net { namespace detail {
         } // lock_guard
 
         for (auto iter = inventory_messages_to_send.begin(); iter != inventory_messages_to_send.end(); ++iter)
-          iter->first->send_message(iter->second);
+          iter->first->send_message(iter->second, iter->second.item_type == block_message_type ?
+                                                    peer_connection::send_class::relay :
+                                                    peer_connection::send_class::trx_inventory);
         inventory_messages_to_send.clear();
 
         if (_new_inventory.empty())
@@ -1314,6 +1326,17 @@ namespace graphene { namespace net { namespace detail {
         break;
       case core_message_type_enum::get_current_connections_reply_message_type:
         break;
+      case core_message_type_enum::compact_block_message_type:
+        on_compact_block_message(originating_peer, received_message.as<compact_block_message>());
+        break;
+      case core_message_type_enum::fetch_compact_block_transactions_message_type:
+        on_fetch_compact_block_transactions_message(originating_peer,
+                                                    received_message.as<fetch_compact_block_transactions_message>());
+        break;
+      case core_message_type_enum::compact_block_transactions_message_type:
+        on_compact_block_transactions_message(originating_peer,
+                                              received_message.as<compact_block_transactions_message>());
+        break;
 
       default:
         // ignore any message in between core_message_type_first and _last that we don't handle above
@@ -2283,19 +2306,44 @@ namespace graphene { namespace net { namespace detail {
            ("endpoint", originating_peer->get_remote_endpoint()));
 
       fc::optional<message> last_block_message_sent;
-
-      std::list<message> reply_messages;
+      // blocks in the message cache were requested during normal operation, most of their transactions
+      // have been relayed to the peer already.  A peer still syncing from us hasn't seen them, so it gets
+      // full blocks
+      const bool send_compact_blocks = _send_compact_blocks
+            && fetch_items_message_received.item_type == block_message_type
+            && originating_peer->core_protocol_version >= GRAPHENE_NET_COMPACT_BLOCK_PROTOCOL_VERSION
+            && !originating_peer->peer_needs_sync_items_from_us;
+
+      // replies are queued once we've updated what the peer has seen.  Blocks we have to read from the
+      // blockchain are only queued by id, so that a syncing peer doesn't make us hold all of them in memory
+      struct reply_to_send
+      {
+        padded_message_ptr          message_to_send;
+        fc::optional<item_id>       block_to_read;
+        peer_connection::send_class message_class;
+      };
+      std::list<reply_to_send> reply_messages;
       for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
       {
         try
         {
-          message requested_message = _message_cache.get_message(item_hash);
+          padded_message_ptr requested_message;
+          if (send_compact_blocks)
+          {
+            last_block_message_sent = _message_cache.get_message(item_hash);
+            requested_message = get_compact_block_message(*last_block_message_sent, item_hash);
+          }
+          else
+          {
+            requested_message = _message_cache.get_padded_message(item_hash);
+            if (fetch_items_message_received.item_type == block_message_type)
+              last_block_message_sent = _message_cache.get_message(item_hash);
+          }
           dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ("endpoint", originating_peer->get_remote_endpoint())
-               ("id", requested_message.id()));
-          reply_messages.push_back(requested_message);
-          if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
+               ("id", item_hash));
+          reply_messages.push_back({ requested_message, fc::optional<item_id>(),
+                                     peer_connection::get_send_class(requested_message->msg_type) });
           continue;
         }
         catch (fc::key_not_found_exception&)
@@ -2311,14 +2359,25 @@ namespace graphene { namespace net { namespace detail {
                ("id", requested_message.id())
                ("size", requested_message.size)
                ("endpoint", originating_peer->get_remote_endpoint()));
-          reply_messages.push_back(requested_message);
           if (fetch_items_message_received.item_type == block_message_type)
+          {
             last_block_message_sent = requested_message;
+            // blocks which are no longer in the cache are old ones, so the peer is syncing from us
+            reply_messages.push_back({ padded_message_ptr(),
+                                       item_id(block_message_type,
+                                               requested_message.as<graphene::net::block_message>().block_id),
+                                       peer_connection::send_class::sync });
+          }
+          else
+            reply_messages.push_back({ std::make_shared<padded_message>(requested_message), fc::optional<item_id>(),
+                                       peer_connection::get_send_class(requested_message.msg_type.value()) });
           continue;
         }
         catch (fc::key_not_found_exception&)
         {
-          reply_messages.push_back(item_not_available_message(item_to_fetch));
+          message not_available = item_not_available_message(item_to_fetch);
+          reply_messages.push_back({ std::make_shared<padded_message>(not_available), fc::optional<item_id>(),
+                                     peer_connection::send_class::control });
           dlog("received item request from peer ${endpoint} but we don't have it",
                ("endpoint", originating_peer->get_remote_endpoint()));
         }
@@ -2332,19 +2391,32 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
       }
 
-      for (const message& reply : reply_messages)
+      for (const reply_to_send& reply : reply_messages)
       {
-        if (reply.msg_type.value() == block_message_type)
-          originating_peer->send_item(item_id(block_message_type, reply.as<graphene::net::block_message>().block_id));
+        if (reply.block_to_read)
+          originating_peer->send_item(*reply.block_to_read, reply.message_class);
         else
-          originating_peer->send_message(reply);
+          originating_peer->send_message(reply.message_to_send, reply.message_class);
       }
     }
 
     void node_impl::on_item_not_available_message( peer_connection* originating_peer, const item_not_available_message& item_not_available_message_received )
     {
       VERIFY_CORRECT_THREAD();
-      const item_id& requested_item = item_not_available_message_received.requested_item;
+      item_id requested_item = item_not_available_message_received.requested_item;
+      // a peer which can't send us the missing transactions of a compact block reports the block itself
+      // as not available.  If we asked for the block while syncing, it is known by its block_id there
+      auto pending_compact_iter = originating_peer->pending_compact_blocks.find(requested_item.item_hash);
+      if (requested_item.item_type == block_message_type
+          && pending_compact_iter != originating_peer->pending_compact_blocks.end())
+      {
+        const block_id_type& block_id = pending_compact_iter->second.compact.block_id;
+        if (originating_peer->sync_items_requested_from_peer.find(block_id)
+              != originating_peer->sync_items_requested_from_peer.end())
+          requested_item.item_hash = block_id;
+        originating_peer->pending_compact_blocks.erase(pending_compact_iter);
+      }
+
       auto regular_item_iter = originating_peer->items_requested_from_peer.find(requested_item);
       if (regular_item_iter != originating_peer->items_requested_from_peer.end())
       {
@@ -2380,6 +2452,184 @@ namespace graphene { namespace net { namespace detail {
       dlog("Peer doesn't have an item we're looking for, which is fine because we weren't looking for it");
     }
 
+    padded_message_ptr node_impl::get_compact_block_message(const message& block_message_to_send,
+                                                 const item_hash_t& block_message_hash) const
+    {
+      VERIFY_CORRECT_THREAD();
+      for (const auto& recent : _recent_compact_blocks)
+        if (recent.first == block_message_hash)
+          return recent.second;
+
+      graphene::net::block_message block = block_message_to_send.as<graphene::net::block_message>();
+      compact_block_message compact;
+      compact.block_message_hash = block_message_hash;
+      compact.header = block.block;
+      compact.block_id = block.block_id;
+      compact.transactions.reserve(block.block.transactions.size());
+      for (const graphene::protocol::processed_transaction& transaction : block.block.transactions)
+      {
+        // a trx_message serializes like the signed transaction
+        compact.transactions.push_back({ fc::ripemd160::hash(
+                                              static_cast<const graphene::protocol::signed_transaction&>(transaction)),
+                                         transaction.operation_results });
+      }
+
+      padded_message_ptr compact_message = std::make_shared<padded_message>(message(compact));
+      _recent_compact_blocks.emplace_back(block_message_hash, compact_message);
+      if (_recent_compact_blocks.size() > GRAPHENE_NET_RECENT_COMPACT_BLOCKS)
+        _recent_compact_blocks.pop_front();
+      return compact_message;
+    }
+
+    void node_impl::on_compact_block_message(peer_connection* originating_peer,
+                                             const compact_block_message& compact_block_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      const item_hash_t& block_message_hash = compact_block_message_received.block_message_hash;
+      // we may have asked for the block during normal operation by its message hash or while syncing by its
+      // block_id, process_block_message() tells the two apart once the block is rebuilt
+      if (originating_peer->items_requested_from_peer.find(item_id(block_message_type, block_message_hash))
+            == originating_peer->items_requested_from_peer.end()
+          && originating_peer->sync_items_requested_from_peer.find(compact_block_message_received.block_id)
+            == originating_peer->sync_items_requested_from_peer.end())
+      {
+        wlog("received a compact block ${block_id} I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", compact_block_message_received.block_id));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a block that I didn't ask for, block_id: ${block_id}",
+                                                    ("block_id", compact_block_message_received.block_id)));
+        disconnect_from_peer(originating_peer, "You sent me a block that I didn't ask for", true, detailed_error);
+        return;
+      }
+
+      // take the transactions from the messages we have relayed
+      peer_connection::pending_compact_block pending;
+      pending.compact = compact_block_message_received;
+      pending.transactions.resize(pending.compact.transactions.size());
+      fetch_compact_block_transactions_message request;
+      request.block_message_hash = block_message_hash;
+      for (uint32_t i = 0; i < pending.compact.transactions.size(); ++i)
+      {
+        try
+        {
+          message transaction_message = _message_cache.get_message(pending.compact.transactions[i].trx_message_hash);
+          if (transaction_message.msg_type.value() == trx_message_type)
+          {
+            pending.transactions[i] = transaction_message.as<trx_message>().trx;
+            continue;
+          }
+        }
+        catch (fc::key_not_found_exception&)
+        {
+        }
+        request.transaction_indexes.push_back(i);
+      }
+
+      if (request.transaction_indexes.empty())
+      {
+        process_complete_compact_block(originating_peer, std::move(pending));
+        return;
+      }
+
+      dlog("missing ${n} of ${total} transactions of compact block ${block_id}, requesting them from peer ${endpoint}",
+           ("n", request.transaction_indexes.size())("total", pending.transactions.size())
+           ("block_id", compact_block_message_received.block_id)
+           ("endpoint", originating_peer->get_remote_endpoint()));
+      originating_peer->pending_compact_blocks[block_message_hash] = std::move(pending);
+      originating_peer->send_message(message(request));
+    }
+
+    void node_impl::on_fetch_compact_block_transactions_message(peer_connection* originating_peer,
+                                             const fetch_compact_block_transactions_message& request) const
+    {
+      VERIFY_CORRECT_THREAD();
+      item_id block_item(block_message_type, request.block_message_hash);
+      try
+      {
+        graphene::net::block_message block = _message_cache.get_message(request.block_message_hash)
+                                                .as<graphene::net::block_message>();
+        compact_block_transactions_message reply;
+        reply.block_message_hash = request.block_message_hash;
+        reply.transactions.reserve(request.transaction_indexes.size());
+        for (uint32_t index : request.transaction_indexes)
+        {
+          if (index >= block.block.transactions.size())
+            break;
+          reply.transactions.push_back(block.block.transactions[index]);
+        }
+        if (reply.transactions.size() == request.transaction_indexes.size())
+        {
+          originating_peer->send_message(message(reply));
+          return;
+        }
+      }
+      catch (fc::key_not_found_exception&)
+      {
+      }
+      dlog("received request for transactions of compact block ${id} from peer ${endpoint} but we can't send them",
+           ("id", request.block_message_hash)("endpoint", originating_peer->get_remote_endpoint()));
+      originating_peer->send_message(item_not_available_message(block_item));
+    }
+
+    void node_impl::on_compact_block_transactions_message(peer_connection* originating_peer,
+                                                          const compact_block_transactions_message& reply)
+    {
+      VERIFY_CORRECT_THREAD();
+      auto pending_iter = originating_peer->pending_compact_blocks.find(reply.block_message_hash);
+      if (pending_iter == originating_peer->pending_compact_blocks.end())
+      {
+        dlog("received transactions of a compact block I'm not waiting for from peer ${endpoint}",
+             ("endpoint", originating_peer->get_remote_endpoint()));
+        return;
+      }
+      peer_connection::pending_compact_block pending = std::move(pending_iter->second);
+      originating_peer->pending_compact_blocks.erase(pending_iter);
+
+      auto transaction_iter = reply.transactions.begin();
+      for (auto& transaction : pending.transactions)
+      {
+        if (transaction)
+          continue;
+        if (transaction_iter == reply.transactions.end())
+        {
+          disconnect_from_peer(originating_peer, "You sent me an incomplete list of compact block transactions");
+          return;
+        }
+        transaction = *transaction_iter++;
+      }
+      ++_compact_blocks_with_fetched_transactions;
+      process_complete_compact_block(originating_peer, std::move(pending));
+    }
+
+    void node_impl::process_complete_compact_block(peer_connection* originating_peer,
+                                                   peer_connection::pending_compact_block&& pending)
+    {
+      VERIFY_CORRECT_THREAD();
+      graphene::net::block_message block;
+      static_cast<graphene::protocol::signed_block_header&>(block.block) = pending.compact.header;
+      block.block_id = pending.compact.block_id;
+      block.block.transactions.reserve(pending.transactions.size());
+      for (size_t i = 0; i < pending.transactions.size(); ++i)
+      {
+        block.block.transactions.emplace_back(std::move(*pending.transactions[i]));
+        block.block.transactions.back().operation_results
+              = std::move(pending.compact.transactions[i].operation_results);
+      }
+
+      // the rebuilt message must be the one we asked for, the normal block processing takes it from here
+      message block_message_to_process(block);
+      message_hash_type message_hash = block_message_to_process.id();
+      if (message_hash != pending.compact.block_message_hash)
+      {
+        wlog("compact block ${block_id} from peer ${endpoint} does not match the block it stands for",
+             ("block_id", pending.compact.block_id)("endpoint", originating_peer->get_remote_endpoint()));
+        disconnect_from_peer(originating_peer, "You sent me a compact block that does not match the requested block");
+        return;
+      }
+      ++_compact_blocks_rebuilt;
+      process_block_message(originating_peer, block_message_to_process, message_hash);
+    }
+
     void node_impl::on_item_ids_inventory_message(peer_connection* originating_peer, const item_ids_inventory_message& item_ids_inventory_message_received)
     {
       VERIFY_CORRECT_THREAD();
@@ -2907,10 +3157,67 @@ namespace graphene { namespace net { namespace detail {
 
       dlog("leaving process_backlog_of_sync_blocks, ${count} processed", ("count", blocks_processed));
 
+      prepare_upcoming_sync_blocks();
+
       if (!_suspend_fetching_sync_blocks)
         trigger_fetch_sync_items_loop();
     }
 
+    void node_impl::prepare_upcoming_sync_blocks()
+    {
+      VERIFY_CORRECT_THREAD();
+      // forget the blocks which were passed on to handle_block or dropped
+      std::set<item_hash_t> received_ids;
+      for (const graphene::net::block_message& received : _received_sync_items)
+        received_ids.insert(received.block_id);
+      for (auto iter = _sync_blocks_being_prepared.begin(); iter != _sync_blocks_being_prepared.end();)
+      {
+        if (received_ids.find(*iter) == received_ids.end())
+          iter = _sync_blocks_being_prepared.erase(iter);
+        else
+          ++iter;
+      }
+      if (_sync_blocks_being_prepared.size() >= _max_sync_blocks_to_prepare)
+        return;
+
+      // the blocks which come next in the chain are needed first
+      std::vector<const graphene::net::block_message*> candidates;
+      for (const graphene::net::block_message& received : _received_sync_items)
+        if (_sync_blocks_being_prepared.find(received.block_id) == _sync_blocks_being_prepared.end())
+          candidates.push_back(&received);
+      const size_t count = std::min(candidates.size(), _max_sync_blocks_to_prepare - _sync_blocks_being_prepared.size());
+      std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                        [](const graphene::net::block_message* a, const graphene::net::block_message* b) {
+                          return a->block.block_num() < b->block.block_num();
+                        });
+
+      // copy them first, other tasks may change _received_sync_items while the delegate is called
+      std::vector<graphene::net::block_message> blocks_to_prepare;
+      blocks_to_prepare.reserve(count);
+      for (size_t i = 0; i < count; ++i)
+      {
+        blocks_to_prepare.push_back(*candidates[i]);
+        _sync_blocks_being_prepared.insert(candidates[i]->block_id);
+      }
+      for (const graphene::net::block_message& block_message_to_prepare : blocks_to_prepare)
+      {
+        try
+        {
+          _delegate->prepare_sync_block(block_message_to_prepare);
+        }
+        catch (const fc::canceled_exception&)
+        {
+          throw;
+        }
+        catch (const fc::exception& e)
+        {
+          // the block is checked again when it is handled
+          dlog("Failed to prepare sync block ${num}: ${e}",
+               ("num", block_message_to_prepare.block.block_num())("e", e.to_detail_string()));
+        }
+      }
+    }
+
     void node_impl::trigger_process_backlog_of_sync_blocks()
     {
       if (!_node_is_shutting_down &&
@@ -3404,59 +3711,105 @@ namespace graphene { namespace net { namespace detail {
         if (originating_peer->idle())
           trigger_fetch_items_loop();
 
-        // Next: have the delegate process the message
-        fc::time_point message_validated_time;
-        try
+        if (message_to_process.msg_type.value() == trx_message_type)
         {
-          if (message_to_process.msg_type.value() == trx_message_type)
+          // the delegate may hold a transaction back to validate it together with others, so the transaction
+          // is handled by its own task and the read loop of the peer goes on with the next message
+          for (auto calls_iter = _handle_transaction_calls_in_progress.begin();
+                calls_iter != _handle_transaction_calls_in_progress.end();)
           {
-            trx_message transaction_message_to_process = message_to_process.as<trx_message>();
-            dlog( "passing message containing transaction ${trx} to client",
-                  ("trx", transaction_message_to_process.trx.id()) );
-            _delegate->handle_transaction(transaction_message_to_process);
+            if (calls_iter->ready())
+              calls_iter = _handle_transaction_calls_in_progress.erase(calls_iter);
+            else
+              ++calls_iter;
           }
-          else
-            _delegate->handle_message( message_to_process );
-          message_validated_time = fc::time_point::now();
-        }
-        catch ( const fc::canceled_exception& )
-        {
-          throw;
-        }
-        catch ( const fc::exception& e )
-        {
-          switch( e.code() )
+          if (_handle_transaction_calls_in_progress.size() >= _max_transactions_to_handle_at_once)
           {
-          // log common exceptions in debug level
-          case graphene::chain::duplicate_transaction::code_enum::code_value :
-          case graphene::chain::limit_order_create_kill_unfilled::code_enum::code_value :
-          case graphene::chain::limit_order_create_market_not_whitelisted::code_enum::code_value :
-          case graphene::chain::limit_order_create_market_blacklisted::code_enum::code_value :
-          case graphene::chain::limit_order_create_selling_asset_unauthorized::code_enum::code_value :
-          case graphene::chain::limit_order_create_receiving_asset_unauthorized::code_enum::code_value :
-          case graphene::chain::limit_order_create_insufficient_balance::code_enum::code_value :
-          case graphene::chain::limit_order_cancel_nonexist_order::code_enum::code_value :
-          case graphene::chain::limit_order_cancel_owner_mismatch::code_enum::code_value :
-             dlog( "client rejected message sent by peer ${peer}, ${e}",
-                   ("peer", originating_peer->get_remote_endpoint() )("e", e) );
-             break;
-          // log rarer exceptions in warn level
-          default:
-             wlog( "client rejected message sent by peer ${peer}, ${e}",
-                   ("peer", originating_peer->get_remote_endpoint() )("e", e) );
-             break;
+            // too many transactions in progress, make this peer wait before reading more of them
+            fc::future<void> oldest_call = _handle_transaction_calls_in_progress.front();
+            _handle_transaction_calls_in_progress.pop_front();
+            try
+            {
+              oldest_call.wait();
+            }
+            catch ( const fc::canceled_exception& )
+            {
+              throw;
+            }
+            catch ( const fc::exception& e )
+            {
+              wlog( "handle_transaction task failed: ${e}", ("e", e) );
+            }
           }
-          // record it so we don't try to fetch this item again
-          _recently_failed_items.insert( peer_connection::timestamped_item_id(
-                item_id( message_to_process.msg_type.value(), message_hash ), fc::time_point::now() ) );
+          peer_connection_ptr peer = originating_peer->shared_from_this();
+          _handle_transaction_calls_in_progress.emplace_back(fc::async(
+                [this, peer, message_to_process, message_hash, message_receive_time](){
+            deliver_ordinary_message(peer.get(), message_to_process, message_hash, message_receive_time);
+          }, "handle_transaction"));
           return;
         }
+        deliver_ordinary_message(originating_peer, message_to_process, message_hash, message_receive_time);
+      }
+    }
 
-        // finally, if the delegate validated the message, broadcast it to our other peers
-        message_propagation_data propagation_data { message_receive_time, message_validated_time,
-                                                    originating_peer->node_id };
-        broadcast( message_to_process, propagation_data );
+    void node_impl::deliver_ordinary_message( peer_connection* originating_peer,
+                                              const message& message_to_process,
+                                              const message_hash_type& message_hash,
+                                              const fc::time_point& message_receive_time )
+    {
+      VERIFY_CORRECT_THREAD();
+      // Next: have the delegate process the message
+      fc::time_point message_validated_time;
+      try
+      {
+        if (message_to_process.msg_type.value() == trx_message_type)
+        {
+          trx_message transaction_message_to_process = message_to_process.as<trx_message>();
+          dlog( "passing message containing transaction ${trx} to client",
+                ("trx", transaction_message_to_process.trx.id()) );
+          _delegate->handle_transaction(transaction_message_to_process, message_hash);
+        }
+        else
+          _delegate->handle_message( message_to_process );
+        message_validated_time = fc::time_point::now();
+      }
+      catch ( const fc::canceled_exception& )
+      {
+        throw;
+      }
+      catch ( const fc::exception& e )
+      {
+        switch( e.code() )
+        {
+        // log common exceptions in debug level
+        case graphene::chain::duplicate_transaction::code_enum::code_value :
+        case graphene::chain::limit_order_create_kill_unfilled::code_enum::code_value :
+        case graphene::chain::limit_order_create_market_not_whitelisted::code_enum::code_value :
+        case graphene::chain::limit_order_create_market_blacklisted::code_enum::code_value :
+        case graphene::chain::limit_order_create_selling_asset_unauthorized::code_enum::code_value :
+        case graphene::chain::limit_order_create_receiving_asset_unauthorized::code_enum::code_value :
+        case graphene::chain::limit_order_create_insufficient_balance::code_enum::code_value :
+        case graphene::chain::limit_order_cancel_nonexist_order::code_enum::code_value :
+        case graphene::chain::limit_order_cancel_owner_mismatch::code_enum::code_value :
+           dlog( "client rejected message sent by peer ${peer}, ${e}",
+                 ("peer", originating_peer->get_remote_endpoint() )("e", e) );
+           break;
+        // log rarer exceptions in warn level
+        default:
+           wlog( "client rejected message sent by peer ${peer}, ${e}",
+                 ("peer", originating_peer->get_remote_endpoint() )("e", e) );
+           break;
+        }
+        // record it so we don't try to fetch this item again
+        _recently_failed_items.insert( peer_connection::timestamped_item_id(
+              item_id( message_to_process.msg_type.value(), message_hash ), fc::time_point::now() ) );
+        return;
       }
+
+      // finally, if the delegate validated the message, broadcast it to our other peers
+      message_propagation_data propagation_data { message_receive_time, message_validated_time,
+                                                  originating_peer->node_id };
+      broadcast( message_to_process, propagation_data );
     }
 
     void node_impl::start_synchronizing_with_peer( const peer_connection_ptr& peer )
@@ -3577,6 +3930,28 @@ namespace graphene { namespace net { namespace detail {
         wlog( "Exception thrown while terminating Process backlog of sync items task, ignoring" );
       }
 
+      for( fc::future<void>& call : _handle_transaction_calls_in_progress )
+      {
+        if( call.ready() || call.error() || call.canceled() )
+          continue;
+        try
+        {
+          call.cancel_and_wait("node_impl::close()");
+        }
+        catch ( const fc::canceled_exception& )
+        {
+        }
+        catch ( const fc::exception& e )
+        {
+          wlog("Exception thrown while terminating handle_transaction task, ignoring: ${e}", ("e", e));
+        }
+        catch (...)
+        {
+          wlog("Exception thrown while terminating handle_transaction task, ignoring");
+        }
+      }
+      _handle_transaction_calls_in_progress.clear();
+
       size_t handle_message_call_count = 0;
       while( true )
       {
@@ -4630,6 +5005,10 @@ namespace graphene { namespace net { namespace detail {
         _max_sync_blocks_to_prefetch = params["max_sync_blocks_to_prefetch"].as<uint32_t>(1);
       if (params.contains("max_sync_blocks_per_peer"))
         _max_sync_blocks_per_peer = params["max_sync_blocks_per_peer"].as<uint32_t>(1);
+      if (params.contains("max_sync_blocks_to_prepare"))
+        _max_sync_blocks_to_prepare = params["max_sync_blocks_to_prepare"].as<uint32_t>(1);
+      if (params.contains("send_compact_blocks"))
+        _send_compact_blocks = params["send_compact_blocks"].as<bool>(1);
 
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -4649,6 +5028,15 @@ namespace graphene { namespace net { namespace detail {
       result["max_blocks_to_handle_at_once"] = _max_blocks_to_handle_at_once;
       result["max_sync_blocks_to_prefetch"] = _max_sync_blocks_to_prefetch;
       result["max_sync_blocks_per_peer"] = _max_sync_blocks_per_peer;
+      result["max_sync_blocks_to_prepare"] = _max_sync_blocks_to_prepare;
+      result["send_compact_blocks"] = _send_compact_blocks;
+      // read-only, the depth of each stage of the sync block pipeline
+      result["sync_blocks_received"] = _received_sync_items.size() + _new_received_sync_items.size();
+      result["sync_blocks_being_prepared"] = _sync_blocks_being_prepared.size();
+      result["sync_blocks_being_handled"] = _handle_message_calls_in_progress.size();
+      // read-only, how the compact blocks we received were rebuilt
+      result["compact_blocks_rebuilt"] = _compact_blocks_rebuilt;
+      result["compact_blocks_with_fetched_transactions"] = _compact_blocks_with_fetched_transactions;
       return result;
     }
 
@@ -5056,9 +5444,15 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(handle_block, block_message, sync_mode, contained_transaction_msg_ids);
     }
 
-    void statistics_gathering_node_delegate_wrapper::handle_transaction( const graphene::net::trx_message& transaction_message )
+    void statistics_gathering_node_delegate_wrapper::handle_transaction( const graphene::net::trx_message& transaction_message,
+                                                                         const message_hash_type& message_id )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(handle_transaction, transaction_message, message_id);
+    }
+
+    void statistics_gathering_node_delegate_wrapper::prepare_sync_block( const graphene::net::block_message& block_message )
     {
-      INVOKE_AND_COLLECT_STATISTICS(handle_transaction, transaction_message);
+      INVOKE_AND_COLLECT_STATISTICS(prepare_sync_block, block_message);
     }
 
     std::vector<item_hash_t> statistics_gathering_node_delegate_wrapper::get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
@@ -16,6 +16,7 @@
 #define testnetlog(...) do {} while (0)
 #endif
 
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <fc/thread/thread.hpp>
@@ -159,7 +160,8 @@ private:
    struct message_info
    {
       message_hash_type message_hash;
-      message           message_body;
+      /// the message ready to be sent, shared by all peers which request it, the only copy that is kept
+      padded_message_ptr padded_message_body;
       uint32_t          block_clock_when_received;
 
       /// for network performance stats
@@ -174,7 +176,7 @@ private:
                     const message_propagation_data& propagation_data,
                     message_hash_type        message_contents_hash ) :
             message_hash( message_hash ),
-            message_body( message_body ),
+            padded_message_body( std::make_shared<padded_message>( message_body ) ),
             block_clock_when_received( block_clock_when_received ),
             propagation_data( propagation_data ),
             message_contents_hash( message_contents_hash )
@@ -201,6 +203,7 @@ public:
                        const message_propagation_data& propagation_data,
                        const message_hash_type& message_content_hash );
    message get_message( const message_hash_type& hash_of_message_to_lookup ) const;
+   padded_message_ptr get_padded_message( const message_hash_type& hash_of_message_to_lookup ) const;
    message_propagation_data get_message_propagation_data(
          const message_hash_type& hash_of_msg_contents_to_lookup ) const;
    size_t size() const { return _message_cache.size(); }
@@ -245,6 +248,7 @@ class statistics_gathering_node_delegate_wrapper : public node_delegate
                                (handle_message) \
                                (handle_block) \
                                (handle_transaction) \
+                               (prepare_sync_block) \
                                (get_block_ids) \
                                (get_item) \
                                (get_chain_id) \
@@ -343,7 +347,9 @@ class statistics_gathering_node_delegate_wrapper : public node_delegate
       void handle_message( const message& ) override;
       bool handle_block( const graphene::net::block_message& block_message, bool sync_mode,
                          std::vector<message_hash_type>& contained_transaction_msg_ids ) override;
-      void handle_transaction( const graphene::net::trx_message& transaction_message ) override;
+      void handle_transaction( const graphene::net::trx_message& transaction_message,
+                               const message_hash_type& message_id ) override;
+      void prepare_sync_block( const graphene::net::block_message& block_message ) override;
       std::vector<item_hash_t> get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
                                              uint32_t& remaining_item_count,
                                              uint32_t limit = 2000) override;
@@ -429,6 +435,8 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
       /// List of sync blocks we've received, but can't yet process because we are still missing blocks
       /// that come earlier in the chain
       std::list<graphene::net::block_message> _received_sync_items;
+      /// Ids of the sync blocks in @ref _received_sync_items which were passed to the delegate for preparation
+      std::set<item_hash_t>                   _sync_blocks_being_prepared;
       /// @}
 
       fc::future<void> _process_backlog_of_sync_blocks_done;
@@ -585,10 +593,23 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
       size_t _max_blocks_to_handle_at_once = MAX_BLOCKS_TO_HANDLE_AT_ONCE;
       /// Maximum number of sync blocks to prefetch
       size_t _max_sync_blocks_to_prefetch = MAX_SYNC_BLOCKS_TO_PREFETCH;
+      /// Maximum number of received sync blocks the delegate prepares ahead of the blocks being handled
+      size_t _max_sync_blocks_to_prepare = MAX_SYNC_BLOCKS_TO_PREPARE;
+      /// Whether to send compact blocks to peers which support them
+      bool _send_compact_blocks = true;
+      /// Number of compact blocks rebuilt, and how many of them needed transactions fetched from the peer
+      uint64_t _compact_blocks_rebuilt = 0;
+      uint64_t _compact_blocks_with_fetched_transactions = 0;
+      /// The compact blocks sent most recently with the ids of the block messages they stand for
+      mutable std::deque<std::pair<item_hash_t, padded_message_ptr> > _recent_compact_blocks;
       /// Maximum number of blocks per peer during syncing
       size_t _max_sync_blocks_per_peer = GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING;
 
       std::list<fc::future<void> > _handle_message_calls_in_progress;
+      /// Transactions being handled by the delegate, each in its own task
+      std::list<fc::future<void> > _handle_transaction_calls_in_progress;
+      /// Maximum number of transactions to handle at one time
+      size_t _max_transactions_to_handle_at_once = MAX_TRANSACTIONS_TO_HANDLE_AT_ONCE;
 
       /// Used by the task that checks whether addresses of seed nodes have been updated
       /// @{
@@ -669,6 +690,19 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
       void on_item_not_available_message( peer_connection* originating_peer,
                                           const item_not_available_message& item_not_available_message_received );
 
+      /// @return the compact_block_message for @p block_message_to_send whose id is @p block_message_hash
+      padded_message_ptr get_compact_block_message( const message& block_message_to_send,
+                                         const item_hash_t& block_message_hash ) const;
+      void on_compact_block_message( peer_connection* originating_peer,
+                                     const compact_block_message& compact_block_message_received );
+      void on_fetch_compact_block_transactions_message( peer_connection* originating_peer,
+                                                        const fetch_compact_block_transactions_message& request ) const;
+      void on_compact_block_transactions_message( peer_connection* originating_peer,
+                                                  const compact_block_transactions_message& reply );
+      /// Turns a compact block whose transactions are all known back into a block message and processes it
+      void process_complete_compact_block( peer_connection* originating_peer,
+                                           peer_connection::pending_compact_block&& pending );
+
       void on_item_ids_inventory_message( peer_connection* originating_peer,
                                           const item_ids_inventory_message& item_ids_inventory_message_received );
 
@@ -694,6 +728,7 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
       void send_sync_block_to_node_delegate(const graphene::net::block_message& block_message_to_send);
       void process_backlog_of_sync_blocks();
       void trigger_process_backlog_of_sync_blocks();
+      void prepare_upcoming_sync_blocks();
       void process_block_during_syncing(
                   peer_connection* originating_peer,
                   const graphene::net::block_message& block_message,
@@ -711,6 +746,12 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
                   peer_connection* originating_peer,
                   const message& message_to_process,
                   const message_hash_type& message_hash);
+      /// Passes a message which was requested from the peer to the delegate and relays it if it is valid
+      void deliver_ordinary_message(
+                  peer_connection* originating_peer,
+                  const message& message_to_process,
+                  const message_hash_type& message_hash,
+                  const fc::time_point& message_receive_time);
 
       void start_synchronizing();
       void start_synchronizing_with_peer(const peer_connection_ptr& peer);
@@ -45,7 +45,32 @@
 
 namespace graphene { namespace net
   {
-    message peer_connection::real_queued_message::get_message(peer_connection_delegate*)
+    static const std::array<uint32_t, peer_connection::send_class_count> send_class_weights =
+          GRAPHENE_NET_SEND_CLASS_WEIGHTS;
+
+    peer_connection::send_class peer_connection::get_send_class(uint32_t msg_type)
+    {
+      switch (msg_type)
+      {
+      case block_message_type:
+      case compact_block_message_type:
+      case compact_block_transactions_message_type:
+      case trx_message_type:
+        return send_class::relay;
+      case blockchain_item_ids_inventory_message_type:
+      case fetch_blockchain_item_ids_message_type:
+        return send_class::sync;
+      case item_ids_inventory_message_type:
+        return send_class::trx_inventory;
+      case address_request_message_type:
+      case address_message_type:
+        return send_class::address;
+      default:
+        return send_class::control;
+      }
+    }
+
+    padded_message_ptr peer_connection::real_queued_message::get_message(peer_connection_delegate*)
     {
       if (message_send_time_field_offset != (size_t)-1)
       {
@@ -56,15 +81,23 @@ namespace graphene { namespace net
         memcpy(message_to_send.data.data() + message_send_time_field_offset,
                packed_current_time.data(), packed_current_time.size());
       }
-      return message_to_send;
+      return std::make_shared<padded_message>(message_to_send);
     }
     size_t peer_connection::real_queued_message::get_size_in_queue()
     {
       return message_to_send.data.size();
     }
-    message peer_connection::virtual_queued_message::get_message(peer_connection_delegate* node)
+    padded_message_ptr peer_connection::shared_queued_message::get_message(peer_connection_delegate*)
     {
-      return node->get_message_for_item(item_to_send);
+      return message_to_send;
+    }
+    size_t peer_connection::shared_queued_message::get_size_in_queue()
+    {
+      return message_to_send->data.size();
+    }
+    padded_message_ptr peer_connection::virtual_queued_message::get_message(peer_connection_delegate* node)
+    {
+      return std::make_shared<padded_message>(node->get_message_for_item(item_to_send));
     }
 
     size_t peer_connection::virtual_queued_message::get_size_in_queue()
@@ -299,16 +332,18 @@ namespace graphene { namespace net
         ~counter() { assert(_send_message_queue_tasks_counter == 1); --_send_message_queue_tasks_counter; /* dlog("leaving peer_connection::send_queued_messages_task()"); */ }
       } concurrent_invocation_counter(_send_message_queue_tasks_running);
 #endif
-      while (!_queued_messages.empty())
+      for (send_class message_class = get_next_send_class(); message_class != send_class::count;
+           message_class = get_next_send_class())
       {
-        _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
+        auto& queue = _queued_messages[(size_t)message_class];
+        queue.front()->transmission_start_time = fc::time_point::now();
+        padded_message_ptr message_to_send = queue.front()->get_message(_node);
         try
         {
           //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
           //     "to send message of type ${type} for peer ${endpoint}",
-          //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
-          _message_connection.send_message(message_to_send);
+          //     ("type", message_to_send->msg_type)("endpoint", get_remote_endpoint()));
+          _message_connection.send_message(*message_to_send);
           //dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_message() completed normally for peer ${endpoint}",
           //     ("endpoint", get_remote_endpoint()));
         }
@@ -338,18 +373,56 @@ namespace graphene { namespace net
         {
           wlog("message_oriented_exception::send_message() threw an unhandled exception");
         }
-        _queued_messages.front()->transmission_finish_time = fc::time_point::now();
-        _total_queued_messages_size -= _queued_messages.front()->get_size_in_queue();
-        _queued_messages.pop();
+        queue.front()->transmission_finish_time = fc::time_point::now();
+        _total_queued_messages_size -= queue.front()->get_size_in_queue();
+        queue.pop();
       }
       //dlog("leaving peer_connection::send_queued_messages_task() due to queue exhaustion");
     }
 
-    void peer_connection::send_queueable_message(std::unique_ptr<queued_message>&& message_to_send)
+    peer_connection::send_class peer_connection::get_next_send_class()
+    {
+      return _send_scheduler.next([this](send_class message_class) {
+        return !_queued_messages[(size_t)message_class].empty();
+      });
+    }
+
+    peer_connection::send_scheduler::send_scheduler() :
+      send_scheduler(send_class_weights)
+    {}
+
+    peer_connection::send_scheduler::send_scheduler(const std::array<uint32_t, send_class_count>& weights) :
+      _weights(weights),
+      _credits(weights)
+    {
+      for (uint32_t weight : _weights)
+        FC_ASSERT(weight > 0, "A send class without weight would never send");
+    }
+
+    peer_connection::send_class peer_connection::send_scheduler::next(
+          const std::function<bool(send_class)>& has_messages)
+    {
+      for (int round = 0; round < 2; ++round)
+      {
+        for (size_t i = 0; i < send_class_count; ++i)
+          if (_credits[i] > 0 && has_messages((send_class)i))
+          {
+            --_credits[i];
+            return (send_class)i;
+          }
+        // every class with messages waiting has used up its share of this round, start the next one
+        _credits = _weights;
+      }
+      return send_class::count;
+    }
+
+    void peer_connection::send_queueable_message(std::unique_ptr<queued_message>&& message_to_send,
+                                                 send_class message_class)
     {
       VERIFY_CORRECT_THREAD();
+      FC_ASSERT(message_class != send_class::count);
       _total_queued_messages_size += message_to_send->get_size_in_queue();
-      _queued_messages.emplace(std::move(message_to_send));
+      _queued_messages[(size_t)message_class].emplace(std::move(message_to_send));
       if (_total_queued_messages_size > GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)
       {
         wlog("send queue exceeded maximum size of ${max} bytes (current size ${current} bytes)",
@@ -382,18 +455,43 @@ namespace graphene { namespace net
       VERIFY_CORRECT_THREAD();
       //dlog("peer_connection::send_message() enqueueing message of type ${type} for peer ${endpoint}",
       //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint())); // for debug
+      if (message_send_time_field_offset == (size_t)-1)
+      {
+        send_message(message_to_send, get_send_class(message_to_send.msg_type.value()));
+        return;
+      }
       auto message_to_enqueue = std::make_unique<real_queued_message>(
                                       message_to_send, message_send_time_field_offset );
-      send_queueable_message(std::move(message_to_enqueue));
+      send_queueable_message(std::move(message_to_enqueue), get_send_class(message_to_send.msg_type.value()));
+    }
+
+    void peer_connection::send_message(const message& message_to_send, send_class message_class)
+    {
+      VERIFY_CORRECT_THREAD();
+      send_message(std::make_shared<padded_message>(message_to_send), message_class);
+    }
+
+    void peer_connection::send_message(padded_message_ptr message_to_send)
+    {
+      VERIFY_CORRECT_THREAD();
+      const send_class message_class = get_send_class(message_to_send->msg_type);
+      send_message(std::move(message_to_send), message_class);
+    }
+
+    void peer_connection::send_message(padded_message_ptr message_to_send, send_class message_class)
+    {
+      VERIFY_CORRECT_THREAD();
+      auto message_to_enqueue = std::make_unique<shared_queued_message>(std::move(message_to_send));
+      send_queueable_message(std::move(message_to_enqueue), message_class);
     }
 
-    void peer_connection::send_item(const item_id& item_to_send)
+    void peer_connection::send_item(const item_id& item_to_send, send_class message_class)
     {
       VERIFY_CORRECT_THREAD();
       //dlog("peer_connection::send_item() enqueueing message of type ${type} for peer ${endpoint}",
       //     ("type", item_to_send.item_type)("endpoint", get_remote_endpoint())); // for debug
       auto message_to_enqueue = std::make_unique<virtual_queued_message>(item_to_send);
-      send_queueable_message(std::move(message_to_enqueue));
+      send_queueable_message(std::move(message_to_enqueue), message_class);
     }
 
     void peer_connection::close_connection()
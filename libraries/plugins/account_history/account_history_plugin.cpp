@@ -72,13 +72,84 @@ class account_history_plugin_impl
       uint64_t _max_ops_per_account = -1;
       uint64_t _extended_max_ops_per_account = -1;
 
+      bool _file_storage = false;
+      operation_history_store _store;
+
       /** add one history record, then check and remove the earliest history record */
-      void add_account_history( const account_id_type account_id, const operation_history_id_type op_id );
+      void add_account_history( const account_id_type account_id, const operation_history_object& op );
+
+      /** appends the operations of the block to the operation history store */
+      void store_account_histories( const signed_block& b );
+
+      /** the accounts an operation applies to */
+      static flat_set<account_id_type> get_impacted_accounts( const operation_history_object& op );
 
 };
 
+flat_set<account_id_type> account_history_plugin_impl::get_impacted_accounts( const operation_history_object& op )
+{
+   flat_set<account_id_type> impacted;
+   vector<authority> other;
+   // fee payer is added here
+   operation_get_required_authorities( op.op, impacted, impacted, other, false );
+
+   if( op.op.is_type< account_create_operation >() )
+      impacted.insert( op.result.get<object_id_type>() );
+   else
+      operation_get_impacted_accounts( op.op, impacted, false );
+
+   if( op.result.is_type<extendable_operation_result>() )
+   {
+      const auto& op_result = op.result.get<extendable_operation_result>();
+      if( op_result.value.impacted_accounts.valid() )
+      {
+         for( const auto& a : *op_result.value.impacted_accounts )
+            impacted.insert( a );
+      }
+   }
+
+   for( auto& a : other )
+      for( auto& item : a.account_auths )
+         impacted.insert( item.first );
+
+   return impacted;
+}
+
+void account_history_plugin_impl::store_account_histories( const signed_block& b )
+{
+   graphene::chain::database& db = database();
+   if( !_store.is_open() )
+      _store.open( db.get_data_dir() / "account_history" );
+   // this block and the ones after it are applied again, after a chain reorganization or during a replay
+   if( _store.head_block_num() >= b.block_num() )
+      _store.truncate_from_block( b.block_num() );
+
+   for( const optional< operation_history_object >& o_op : db.get_applied_operations() )
+   {
+      if( !o_op.valid() )
+         continue;
+      flat_set<account_id_type> impacted = get_impacted_accounts( *o_op );
+      if( !_tracked_accounts.empty() )
+      {
+         flat_set<account_id_type> tracked;
+         for( const account_id_type& account_id : impacted )
+            if( _tracked_accounts.find( account_id ) != _tracked_accounts.end() )
+               tracked.insert( account_id );
+         impacted = std::move( tracked );
+      }
+      if( !impacted.empty() )
+         _store.append( *o_op, impacted );
+   }
+}
+
 void account_history_plugin_impl::update_account_histories( const signed_block& b )
 {
+   if( _file_storage )
+   {
+      store_account_histories( b );
+      return;
+   }
+
    graphene::chain::database& db = database();
    const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
    bool is_first = true;
@@ -126,29 +197,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
       const operation_history_object& op = *o_op;
 
       // get the set of accounts this operation applies to
-      flat_set<account_id_type> impacted;
-      vector<authority> other;
-      // fee payer is added here
-      operation_get_required_authorities( op.op, impacted, impacted, other, false );
-
-      if( op.op.is_type< account_create_operation >() )
-         impacted.insert( op.result.get<object_id_type>() );
-      else
-         operation_get_impacted_accounts( op.op, impacted, false );
-
-      if( op.result.is_type<extendable_operation_result>() )
-      {
-         const auto& op_result = op.result.get<extendable_operation_result>();
-         if( op_result.value.impacted_accounts.valid() )
-         {
-            for( const auto& a : *op_result.value.impacted_accounts )
-               impacted.insert( a );
-         }
-      }
-
-      for( auto& a : other )
-         for( auto& item : a.account_auths )
-            impacted.insert( item.first );
+      const flat_set<account_id_type> impacted = get_impacted_accounts( op );
 
       // be here, either _max_ops_per_account > 0, or _partial_operations == false, or both
       // if _partial_operations == false, oho should have been created above
@@ -174,7 +223,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
                // that indexing now happens in observers' post_evaluate()
 
                // add history
-               add_account_history( account_id, oho->id );
+               add_account_history( account_id, *oho );
             }
          }
       }
@@ -194,7 +243,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
                {
                   if (!oho.valid()) { oho = create_oho(); }
                   // add history
-                  add_account_history( account_id, oho->id );
+                  add_account_history( account_id, *oho );
                }
             }
          }
@@ -205,16 +254,17 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
 }
 
 void account_history_plugin_impl::add_account_history( const account_id_type account_id,
-                                                       const operation_history_id_type op_id )
+                                                       const operation_history_object& op )
 {
    graphene::chain::database& db = database();
    const auto& stats_obj = account_id(db).statistics(db);
    // add new entry
    const auto& ath = db.create<account_transaction_history_object>( [&]( account_transaction_history_object& obj ){
-       obj.operation_id = op_id;
+       obj.operation_id = op.id;
        obj.account = account_id;
        obj.sequence = stats_obj.total_ops + 1;
        obj.next = stats_obj.most_recent_op;
+       obj.operation_type = op.op.which();
    });
    db.modify( stats_obj, [&]( account_statistics_object& obj ){
        obj.most_recent_op = ath.id;
@@ -316,6 +366,9 @@ void account_history_plugin::plugin_set_program_options(
          ("extended-history-by-registrar",
           boost::program_options::value<std::vector<std::string>>()->composing()->multitoken(),
           "Track longer history for accounts with this registrar (may specify multiple times)")
+         ("history-storage", boost::program_options::value<std::string>()->default_value("memory"),
+          "Where to keep the history: memory (object database) or file (append-only memory-mapped store "
+          "with full history, ignores partial-operations and the max-ops-per-account limits)")
          ;
    cfg.add(cli);
 }
@@ -341,10 +394,31 @@ void account_history_plugin::plugin_initialize(const boost::program_options::var
                   graphene::chain::account_id_type);
    LOAD_VALUE_SET(options, "extended-history-by-registrar", my->_extended_history_registrars,
                   graphene::chain::account_id_type);
+   if (options.count("history-storage") > 0) {
+       const std::string storage = options["history-storage"].as<std::string>();
+       FC_ASSERT( storage == "memory" || storage == "file", "history-storage must be memory or file" );
+       my->_file_storage = ( storage == "file" );
+   }
+   if( my->_file_storage && ( my->_partial_operations || options.count("max-ops-per-account") > 0 ) )
+      wlog( "account_history: file storage keeps the full history, partial-operations and max-ops-per-account "
+            "are ignored" );
 }
 
 void account_history_plugin::plugin_startup()
 {
+   if( my->_file_storage && !my->_store.is_open() )
+      my->_store.open( database().get_data_dir() / "account_history" );
+}
+
+void account_history_plugin::plugin_shutdown()
+{
+   if( my->_store.is_open() )
+      my->_store.close();
+}
+
+const operation_history_store* account_history_plugin::history_store()const
+{
+   return my->_file_storage ? &my->_store : nullptr;
 }
 
 flat_set<account_id_type> account_history_plugin::tracked_accounts() const
@@ -27,6 +27,7 @@
 #include <graphene/chain/database.hpp>
 
 #include <graphene/chain/operation_history_object.hpp>
+#include <graphene/account_history/operation_history_store.hpp>
 
 #include <fc/thread/future.hpp>
 
@@ -73,9 +74,14 @@ class account_history_plugin : public graphene::app::plugin
          boost::program_options::options_description& cfg) override;
       void plugin_initialize(const boost::program_options::variables_map& options) override;
       void plugin_startup() override;
+      void plugin_shutdown() override;
 
       flat_set<account_id_type> tracked_accounts()const;
 
+      /// The store that holds the history if history-storage is file, nullptr if the history is kept in
+      /// the object database
+      const operation_history_store* history_store()const;
+
    private:
       std::unique_ptr<detail::account_history_plugin_impl> my;
 };
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/interprocess/file_mapping.hpp>
+#include <fc/io/raw.hpp>
+
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace graphene { namespace account_history {
+   using namespace graphene::chain;
+
+   /**
+    * @brief Strictly increasing sequence of integers, stored as 32 bit deltas to a 64 bit base per block of entries
+    *
+    * Takes about 4 bytes per entry instead of 8.
+    */
+   class instance_list
+   {
+      public:
+         size_t   size()const  { return _deltas.size(); }
+         bool     empty()const { return _deltas.empty(); }
+         uint64_t operator[]( size_t i )const;
+         uint64_t back()const  { return (*this)[ size() - 1 ]; }
+         void     push_back( uint64_t value );
+         void     pop_back();
+         /// Number of entries that are not greater than @p value
+         size_t   count_not_greater( uint64_t value )const;
+
+         /// Writes the entries in host byte order, the lists can be large enough to exceed the fc::raw array limit
+         template<typename Stream>
+         void pack( Stream& s )const
+         {
+            fc::raw::pack( s, uint64_t( _blocks.size() ) );
+            fc::raw::pack( s, uint64_t( _deltas.size() ) );
+            s.write( (const char*)_blocks.data(), _blocks.size() * sizeof(block) );
+            s.write( (const char*)_deltas.data(), _deltas.size() * sizeof(uint32_t) );
+         }
+         template<typename Stream>
+         void unpack( Stream& s )
+         {
+            uint64_t blocks = 0;
+            uint64_t deltas = 0;
+            fc::raw::unpack( s, blocks );
+            fc::raw::unpack( s, deltas );
+            FC_ASSERT( blocks <= deltas && deltas <= blocks * block_size, "Invalid instance list" );
+            _blocks.resize( blocks );
+            _deltas.resize( deltas );
+            s.read( (char*)_blocks.data(), _blocks.size() * sizeof(block) );
+            s.read( (char*)_deltas.data(), _deltas.size() * sizeof(uint32_t) );
+         }
+
+         /// First value and position of the first entry of a block
+         struct block
+         {
+            uint64_t base = 0;
+            uint64_t first = 0;
+         };
+
+      private:
+         static const size_t block_size = 64;
+
+         std::vector<block>    _blocks;
+         std::vector<uint32_t> _deltas;
+   };
+
+   /**
+    * @brief Append-only storage of operation history in a memory-mapped file
+    *
+    * Every stored operation is appended to a single segment file, together with the accounts it impacts.
+    * Only the file offset of each operation and the operations of each account, in total and by operation type,
+    * are kept in memory. These are saved next to the segment file along with the end of the data they cover, so
+    * that opening the store only scans the operations appended after they were saved. Operation ids are the
+    * positions in the file.
+    *
+    * Operations must be appended in block order. When blocks are applied again after a chain reorganization
+    * or a replay, the operations of those blocks are removed by truncating the tail of the file.
+    *
+    * Queries share a lock which @ref append and @ref truncate_from_block take exclusively.
+    */
+   class operation_history_store
+   {
+      public:
+         ~operation_history_store();
+
+         void open( const fc::path& dir );
+         bool is_open()const;
+         /// Writes the segment file and then the in-memory indexes to disk
+         void flush();
+         void close();
+         /// Appends @p op for @p accounts and returns the id it was stored with
+         operation_history_id_type append( const operation_history_object& op,
+                                           const flat_set<account_id_type>& accounts );
+         /// Removes all operations of block @p block_num and later blocks
+         void truncate_from_block( uint32_t block_num );
+
+         /// Block of the last stored operation, 0 if the store is empty
+         uint32_t head_block_num()const;
+         /// Number of stored operations
+         uint64_t size()const;
+
+         operation_history_object get( operation_history_id_type id )const;
+         /// The tag of the operation, without unpacking it
+         uint16_t                 get_operation_type( operation_history_id_type id )const;
+
+         /// Number of operations that impacted @p account, their sequence numbers in the account's history
+         /// start at 1
+         uint64_t                  account_total_ops( account_id_type account )const;
+         /// The operation with sequence number @p sequence in the history of @p account
+         operation_history_id_type account_operation( account_id_type account, uint64_t sequence )const;
+         /// Sequence number of the last operation of @p account that is not newer than @p id, 0 if none
+         uint64_t                  account_sequence_at( account_id_type account, operation_history_id_type id )const;
+
+         /**
+          * Operations of @p account with ids in (@p stop, @p start], newest first, read under a single lock so
+          * that a concurrent @ref truncate_from_block cannot shift them in between
+          * @param start newest operation to return, the default id stands for the newest one
+          * @param stop exclusive, except that operation 0 is included when it is the default id
+          * @param operation_type if set, only operations of this type are returned, found by a range scan over the
+          *        operations of the account with that type
+          */
+         vector<operation_history_object> get_account_history( account_id_type account,
+                                                               operation_history_id_type start,
+                                                               operation_history_id_type stop, uint32_t limit,
+                                                               optional<uint16_t> operation_type = {} )const;
+         /// Operations of @p account with sequence numbers in [@p stop, @p start], newest first, read under a
+         /// single lock. A @p start of 0 stands for the newest operation.
+         vector<operation_history_object> get_relative_account_history( account_id_type account, uint64_t start,
+                                                                        uint64_t stop, uint32_t limit )const;
+
+      private:
+         char*    base()const { return (char*)_region->get_address(); }
+         void     map_file();
+         void     unmap_file();
+         void     reserve( uint64_t size );
+         uint32_t block_num_at( uint64_t instance )const;
+         operation_history_object unpack_at( uint64_t instance )const;
+
+         /// Adds the operation at @p offset to the in-memory indexes
+         void index_record( uint64_t offset );
+         /// Loads the saved indexes, returns the end of the data they cover or 0 if there are none
+         uint64_t load_index( uint64_t data_end );
+         void     save_index();
+         /// Marks the saved indexes as valid up to @p data_end only
+         void     invalidate_index_from( uint64_t data_end );
+         static uint64_t type_key( uint64_t account, uint16_t operation_type )
+         {
+            return ( account << 16 ) | operation_type;
+         }
+
+         fc::path                            _filename;
+         fc::path                            _index_filename;
+         std::unique_ptr<fc::file_mapping>   _mapping;
+         std::unique_ptr<fc::mapped_region>  _region;
+         /// file offset of every operation
+         instance_list                       _offsets;
+         /// operations of every account by sequence number - 1
+         std::unordered_map< uint64_t, instance_list > _account_ops;
+         /// operations of every account by type, see @ref type_key
+         std::unordered_map< uint64_t, instance_list > _account_type_ops;
+         /// end of the data covered by the saved indexes
+         uint64_t                            _saved_index_end = 0;
+         mutable std::shared_timed_mutex     _lock;
+   };
+
+} } // graphene::account_history
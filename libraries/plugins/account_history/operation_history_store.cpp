@@ -0,0 +1,607 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/account_history/operation_history_store.hpp>
+
+#include <boost/endian/buffers.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace graphene { namespace account_history {
+
+namespace {
+
+const uint32_t store_file_magic   = 0x5453484fu; // "OHST"
+const uint32_t store_file_version = 1;
+const uint32_t index_file_magic   = 0x5849484fu; // "OHIX"
+const uint32_t index_file_version = 1;
+const uint64_t min_growth         = 64 * 1024 * 1024;
+/// the indexes are saved again once this much data was appended, bounding the scan after an unclean shutdown
+const uint64_t index_save_growth  = 1024 * 1024 * 1024;
+
+struct store_file_header
+{
+   boost::endian::little_uint32_buf_t magic;
+   boost::endian::little_uint32_buf_t version;
+   /// end of the last complete record
+   boost::endian::little_uint64_buf_t data_end;
+   boost::endian::little_uint64_buf_t reserved[2];
+};
+
+/// Followed by account_count account instances and the packed operation_history_object
+struct record_header
+{
+   boost::endian::little_uint32_buf_t size; ///< of the whole record
+   boost::endian::little_uint32_buf_t block_num;
+   boost::endian::little_uint16_buf_t operation_type;
+   boost::endian::little_uint16_buf_t account_count;
+};
+
+typedef boost::endian::little_uint64_buf_t account_entry;
+
+/// Followed by the packed in-memory indexes
+struct index_file_header
+{
+   boost::endian::little_uint32_buf_t magic;
+   boost::endian::little_uint32_buf_t version;
+   /// end of the data in the store file that the indexes are valid for
+   boost::endian::little_uint64_buf_t valid_end;
+};
+
+template<typename Stream>
+void pack_lists( Stream& s, const std::unordered_map< uint64_t, instance_list >& lists )
+{
+   fc::raw::pack( s, uint64_t( lists.size() ) );
+   for( const auto& item : lists )
+   {
+      fc::raw::pack( s, item.first );
+      item.second.pack( s );
+   }
+}
+
+template<typename Stream>
+void unpack_lists( Stream& s, std::unordered_map< uint64_t, instance_list >& lists )
+{
+   uint64_t count = 0;
+   fc::raw::unpack( s, count );
+   lists.clear();
+   lists.reserve( count );
+   for( uint64_t i = 0; i < count; ++i )
+   {
+      uint64_t key = 0;
+      fc::raw::unpack( s, key );
+      lists[key].unpack( s );
+   }
+}
+
+/// Removes the entries of @p lists that are not less than @p instance
+void truncate_lists( std::unordered_map< uint64_t, instance_list >& lists, uint64_t instance )
+{
+   for( auto itr = lists.begin(); itr != lists.end(); )
+   {
+      while( !itr->second.empty() && itr->second.back() >= instance )
+         itr->second.pop_back();
+      if( itr->second.empty() )
+         itr = lists.erase( itr );
+      else
+         ++itr;
+   }
+}
+
+store_file_header& header_of( char* base )
+{
+   return *reinterpret_cast<store_file_header*>( base );
+}
+
+const record_header& record_at( const char* base, uint64_t offset )
+{
+   return *reinterpret_cast<const record_header*>( base + offset );
+}
+
+const account_entry* accounts_of( const char* base, uint64_t offset )
+{
+   return reinterpret_cast<const account_entry*>( base + offset + sizeof(record_header) );
+}
+
+void create_file( const fc::path& filename )
+{
+   store_file_header header;
+   memset( (char*)&header, 0, sizeof(header) );
+   header.magic = store_file_magic;
+   header.version = store_file_version;
+   header.data_end = sizeof(header);
+   {
+      std::ofstream out( filename.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      FC_ASSERT( out, "Unable to create ${f}", ("f", filename) );
+      out.write( (const char*)&header, sizeof(header) );
+   }
+   fc::resize_file( filename, min_growth );
+}
+
+} // anonymous namespace
+
+uint64_t instance_list::operator[]( size_t i )const
+{
+   auto itr = std::upper_bound( _blocks.begin(), _blocks.end(), uint64_t( i ),
+                                []( uint64_t pos, const block& b ) { return pos < b.first; } );
+   return ( itr - 1 )->base + _deltas[i];
+}
+
+void instance_list::push_back( uint64_t value )
+{
+   FC_ASSERT( empty() || value > back(), "Entries must be increasing" );
+   if( _blocks.empty() || size() - _blocks.back().first >= block_size
+         || value - _blocks.back().base > std::numeric_limits<uint32_t>::max() )
+   {
+      block b;
+      b.base = value;
+      b.first = size();
+      _blocks.push_back( b );
+   }
+   _deltas.push_back( static_cast<uint32_t>( value - _blocks.back().base ) );
+}
+
+void instance_list::pop_back()
+{
+   _deltas.pop_back();
+   if( !_blocks.empty() && _blocks.back().first == size() )
+      _blocks.pop_back();
+}
+
+size_t instance_list::count_not_greater( uint64_t value )const
+{
+   auto itr = std::upper_bound( _blocks.begin(), _blocks.end(), value,
+                                []( uint64_t v, const block& b ) { return v < b.base; } );
+   if( itr == _blocks.begin() )
+      return 0;
+   --itr;
+   const uint64_t first = itr->first;
+   const uint64_t last = ( itr + 1 == _blocks.end() ) ? size() : ( itr + 1 )->first;
+   const uint64_t delta = std::min<uint64_t>( value - itr->base, std::numeric_limits<uint32_t>::max() );
+   return std::upper_bound( _deltas.begin() + first, _deltas.begin() + last, uint32_t( delta ) ) - _deltas.begin();
+}
+
+operation_history_store::~operation_history_store()
+{
+   close();
+}
+
+void operation_history_store::open( const fc::path& dir )
+{ try {
+   fc::create_directories( dir );
+   std::unique_lock<std::shared_timed_mutex> guard( _lock );
+   _filename = dir / "operations";
+   _index_filename = dir / "operations.index";
+   if( !fc::exists( _filename ) )
+      create_file( _filename );
+
+   map_file();
+   const auto& header = header_of( base() );
+   if( header.magic.value() != store_file_magic || header.version.value() != store_file_version
+         || header.data_end.value() < sizeof(store_file_header) || header.data_end.value() > _region->get_size() )
+   {
+      wlog( "Operation history store ${f} is incompatible or corrupt, recreating it", ("f", _filename) );
+      unmap_file();
+      create_file( _filename );
+      fc::remove( _index_filename );
+      map_file();
+   }
+
+   // load the saved indexes and add the operations stored after them, only the record headers are read
+   const uint64_t data_end = header_of( base() ).data_end.value();
+   uint64_t pos = load_index( data_end );
+   if( pos == 0 )
+   {
+      _offsets = instance_list();
+      _account_ops.clear();
+      _account_type_ops.clear();
+      pos = sizeof(store_file_header);
+   }
+   const uint64_t indexed = _offsets.size();
+   while( pos < data_end )
+   {
+      const bool complete = ( data_end - pos >= sizeof(record_header) )
+            && record_at( base(), pos ).size.value() > sizeof(record_header)
+               + record_at( base(), pos ).account_count.value() * sizeof(account_entry)
+            && record_at( base(), pos ).size.value() <= data_end - pos;
+      if( !complete )
+      {
+         wlog( "Operation history store ${f} is truncated at offset ${p}", ("f", _filename)("p", pos) );
+         header_of( base() ).data_end = pos;
+         break;
+      }
+      index_record( pos );
+      pos += record_at( base(), pos ).size.value();
+   }
+   ilog( "Opened operation history store with ${n} operations, ${s} of them scanned",
+         ("n", _offsets.size())("s", _offsets.size() - indexed) );
+   if( _offsets.size() > indexed )
+   {
+      _region->flush();
+      save_index();
+   }
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+bool operation_history_store::is_open()const
+{
+   std::shared_lock<std::shared_timed_mutex> guard( _lock );
+   return _region != nullptr;
+}
+
+void operation_history_store::flush()
+{
+   std::unique_lock<std::shared_timed_mutex> guard( _lock );
+   if( _region )
+   {
+      _region->flush();
+      save_index();
+   }
+}
+
+void operation_history_store::close()
+{
+   std::unique_lock<std::shared_timed_mutex> guard( _lock );
+   if( _region )
+   {
+      _region->flush();
+      save_index();
+   }
+   unmap_file();
+   _offsets = instance_list();
+   _account_ops.clear();
+   _account_type_ops.clear();
+}
+
+operation_history_id_type operation_history_store::append( const operation_history_object& op,
+                                                           const flat_set<account_id_type>& accounts )
+{
+   std::unique_lock<std::shared_timed_mutex> guard( _lock );
+   FC_ASSERT( _region, "Operation history store is not open" );
+   FC_ASSERT( _offsets.empty() || block_num_at( _offsets.size() - 1 ) <= op.block_num,
+              "Operations must be stored in block order" );
+   FC_ASSERT( accounts.size() <= std::numeric_limits<uint16_t>::max() );
+
+   const operation_history_id_type id( _offsets.size() );
+   operation_history_object stored( op );
+   stored.id = id;
+   const vector<char> body = fc::raw::pack( stored );
+   const uint64_t size = sizeof(record_header) + accounts.size() * sizeof(account_entry) + body.size();
+   FC_ASSERT( size <= std::numeric_limits<uint32_t>::max() );
+
+   const uint64_t offset = header_of( base() ).data_end.value();
+   reserve( offset + size );
+
+   char* pos = base() + offset;
+   record_header record;
+   record.size = static_cast<uint32_t>( size );
+   record.block_num = op.block_num;
+   record.operation_type = static_cast<uint16_t>( op.op.which() );
+   record.account_count = static_cast<uint16_t>( accounts.size() );
+   memcpy( pos, (const char*)&record, sizeof(record) );
+   pos += sizeof(record);
+   for( const account_id_type& account : accounts )
+   {
+      const account_entry entry( account.instance.value );
+      memcpy( pos, (const char*)&entry, sizeof(entry) );
+      pos += sizeof(entry);
+   }
+   memcpy( pos, body.data(), body.size() );
+
+   index_record( offset );
+   // the record is complete before it becomes visible in the header
+   header_of( base() ).data_end = offset + size;
+   if( offset + size - _saved_index_end >= index_save_growth )
+   {
+      _region->flush();
+      save_index();
+   }
+   return id;
+}
+
+void operation_history_store::truncate_from_block( uint32_t block_num )
+{
+   std::unique_lock<std::shared_timed_mutex> guard( _lock );
+   FC_ASSERT( _region, "Operation history store is not open" );
+
+   // first operation of block_num or later, blocks are stored in ascending order
+   uint64_t first = 0;
+   uint64_t count = _offsets.size();
+   while( count > 0 )
+   {
+      const uint64_t step = count / 2;
+      if( block_num_at( first + step ) < block_num )
+      {
+         first += step + 1;
+         count -= step + 1;
+      }
+      else
+         count = step;
+   }
+   if( first == _offsets.size() )
+      return;
+
+   const uint64_t new_end = _offsets[first];
+   // the saved indexes must not describe the operations stored in place of the removed ones
+   if( new_end < _saved_index_end )
+      invalidate_index_from( new_end );
+
+   auto pop = []( std::unordered_map< uint64_t, instance_list >& lists, uint64_t key, uint64_t instance ) {
+      auto itr = lists.find( key );
+      FC_ASSERT( itr != lists.end() && !itr->second.empty() && itr->second.back() == instance );
+      itr->second.pop_back();
+      if( itr->second.empty() )
+         lists.erase( itr );
+   };
+   for( uint64_t instance = _offsets.size(); instance > first; --instance )
+   {
+      const uint64_t offset = _offsets[instance - 1];
+      const record_header& record = record_at( base(), offset );
+      const account_entry* accounts = accounts_of( base(), offset );
+      for( uint16_t i = 0; i < record.account_count.value(); ++i )
+      {
+         pop( _account_ops, accounts[i].value(), instance - 1 );
+         pop( _account_type_ops, type_key( accounts[i].value(), record.operation_type.value() ), instance - 1 );
+      }
+      _offsets.pop_back();
+   }
+   header_of( base() ).data_end = new_end;
+}
+
+uint32_t operation_history_store::head_block_num()const
+{
+   std::shared_lock<std::shared_timed_mutex> guard( _lock );
+   FC_ASSERT( _region, "Operation history store is not open" );
+   return _offsets.empty() ? 0 : block_num_at( _offsets.size() - 1 );
+}
+
+uint64_t operation_history_store::size()const
+{
+   std::shared_lock<std::shared_timed_mutex> guard( _lock );
+   return _offsets.size();
+}
+
+operation_history_object operation_history_store::get( operation_history_id_type id )const
+{ try {
+   std::shared_lock<std::shared_timed_mutex> guard( _lock );
+   FC_ASSERT( _region, "Operation history store is not open" );
+   FC_ASSERT( id.instance.value < _offsets.size(), "Unknown operation" );
+   return unpack_at( id.instance.value );
+} FC_CAPTURE_AND_RETHROW( (id) ) }
+
+uint16_t operation_history_store::get_operation_type( operation_history_id_type id )const
+{
+   std::shared_lock<std::shared_timed_mutex> guard( _lock );
+   FC_ASSERT( _region, "Operation history store is not open" );
+   FC_ASSERT( id.instance.value < _offsets.size(), "Unknown operation" );
+   return record_at( base(), _offsets[id.instance.value] ).operation_type.value();
+}
+
+uint64_t operation_history_store::account_total_ops( account_id_type account )const
+{
+   std::shared_lock<std::shared_timed_mutex> guard( _lock );
+   auto itr = _account_ops.find( account.instance.value );
+   return itr == _account_ops.end() ? 0 : itr->second.size();
+}
+
+operation_history_id_type operation_history_store::account_operation( account_id_type account,
+                                                                      uint64_t sequence )const
+{
+   std::shared_lock<std::shared_timed_mutex> guard( _lock );
+   auto itr = _account_ops.find( account.instance.value );
+   FC_ASSERT( itr != _account_ops.end() && sequence > 0 && sequence <= itr->second.size(),
+              "Account ${a} has no operation ${s}", ("a", account)("s", sequence) );
+   return operation_history_id_type( itr->second[sequence - 1] );
+}
+
+uint64_t operation_history_store::account_sequence_at( account_id_type account,
+                                                       operation_history_id_type id )const
+{
+   std::shared_lock<std::shared_timed_mutex> guard( _lock );
+   auto itr = _account_ops.find( account.instance.value );
+   if( itr == _account_ops.end() )
+      return 0;
+   return itr->second.count_not_greater( id.instance.value );
+}
+
+vector<operation_history_object> operation_history_store::get_account_history(
+      account_id_type account, operation_history_id_type start, operation_history_id_type stop, uint32_t limit,
+      optional<uint16_t> operation_type )const
+{
+   std::shared_lock<std::shared_timed_mutex> guard( _lock );
+   FC_ASSERT( _region, "Operation history store is not open" );
+   vector<operation_history_object> result;
+   const auto& lists = operation_type.valid() ? _account_type_ops : _account_ops;
+   auto itr = lists.find( operation_type.valid() ? type_key( account.instance.value, *operation_type )
+                                                 : account.instance.value );
+   if( itr == lists.end() )
+      return result;
+   const auto& ops = itr->second;
+   uint64_t sequence = ops.size();
+   if( start != operation_history_id_type() )
+      sequence = ops.count_not_greater( start.instance.value );
+   for( ; sequence > 0 && result.size() < limit; --sequence )
+   {
+      const uint64_t instance = ops[sequence - 1];
+      if( instance <= stop.instance.value && stop.instance.value != 0 )
+         break;
+      result.push_back( unpack_at( instance ) );
+   }
+   return result;
+}
+
+vector<operation_history_object> operation_history_store::get_relative_account_history(
+      account_id_type account, uint64_t start, uint64_t stop, uint32_t limit )const
+{
+   std::shared_lock<std::shared_timed_mutex> guard( _lock );
+   FC_ASSERT( _region, "Operation history store is not open" );
+   vector<operation_history_object> result;
+   auto itr = _account_ops.find( account.instance.value );
+   if( itr == _account_ops.end() )
+      return result;
+   const auto& ops = itr->second;
+   // there are no removed operations in the store, sequence numbers start at 1
+   start = ( start == 0 ) ? ops.size() : std::min<uint64_t>( ops.size(), start );
+   for( uint64_t sequence = start; sequence >= std::max<uint64_t>( stop, 1 ) && result.size() < limit; --sequence )
+      result.push_back( unpack_at( ops[sequence - 1] ) );
+   return result;
+}
+
+uint32_t operation_history_store::block_num_at( uint64_t instance )const
+{
+   return record_at( base(), _offsets[instance] ).block_num.value();
+}
+
+void operation_history_store::index_record( uint64_t offset )
+{
+   const record_header& record = record_at( base(), offset );
+   const account_entry* accounts = accounts_of( base(), offset );
+   const uint64_t instance = _offsets.size();
+   for( uint16_t i = 0; i < record.account_count.value(); ++i )
+   {
+      _account_ops[ accounts[i].value() ].push_back( instance );
+      _account_type_ops[ type_key( accounts[i].value(), record.operation_type.value() ) ].push_back( instance );
+   }
+   _offsets.push_back( offset );
+}
+
+uint64_t operation_history_store::load_index( uint64_t data_end )
+{
+   _saved_index_end = 0;
+   if( !fc::exists( _index_filename ) )
+      return 0;
+   try
+   {
+      std::ifstream in( _index_filename.generic_string(), std::ifstream::binary | std::ifstream::in );
+      in.exceptions( std::ios_base::failbit | std::ios_base::badbit | std::ios_base::eofbit );
+      index_file_header header;
+      in.read( (char*)&header, sizeof(header) );
+      if( header.magic.value() != index_file_magic || header.version.value() != index_file_version )
+      {
+         wlog( "Ignoring incompatible operation history index ${f}", ("f", _index_filename) );
+         return 0;
+      }
+      _offsets.unpack( in );
+      unpack_lists( in, _account_ops );
+      unpack_lists( in, _account_type_ops );
+
+      // operations at or after the valid end were removed after the indexes were saved
+      const uint64_t valid_end = std::min( header.valid_end.value(), data_end );
+      const uint64_t kept = valid_end > 0 ? _offsets.count_not_greater( valid_end - 1 ) : 0;
+      const uint64_t resume = ( kept < _offsets.size() ) ? _offsets[kept] : header.valid_end.value();
+      if( resume > data_end )
+      {
+         wlog( "Operation history index ${f} is ahead of the store, rebuilding it", ("f", _index_filename) );
+         return 0;
+      }
+      while( _offsets.size() > kept )
+         _offsets.pop_back();
+      truncate_lists( _account_ops, kept );
+      truncate_lists( _account_type_ops, kept );
+      _saved_index_end = resume;
+      return resume;
+   }
+   catch( const std::exception& e )
+   {
+      wlog( "Unable to read operation history index ${f}, rebuilding it: ${e}", ("f", _index_filename)("e", e.what()) );
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Unable to read operation history index ${f}, rebuilding it: ${e}",
+            ("f", _index_filename)("e", e.to_detail_string()) );
+   }
+   return 0;
+}
+
+void operation_history_store::save_index()
+{ try {
+   const fc::path tmp_file = _index_filename.generic_string() + ".tmp";
+   const uint64_t data_end = header_of( base() ).data_end.value();
+   {
+      std::ofstream out( tmp_file.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      FC_ASSERT( out, "Unable to create ${f}", ("f", tmp_file) );
+      index_file_header header;
+      header.magic = index_file_magic;
+      header.version = index_file_version;
+      header.valid_end = data_end;
+      out.write( (const char*)&header, sizeof(header) );
+      _offsets.pack( out );
+      pack_lists( out, _account_ops );
+      pack_lists( out, _account_type_ops );
+      out.flush();
+      FC_ASSERT( out, "Unable to write ${f}", ("f", tmp_file) );
+   }
+   fc::rename( tmp_file, _index_filename );
+   _saved_index_end = data_end;
+} FC_CAPTURE_AND_RETHROW() }
+
+void operation_history_store::invalidate_index_from( uint64_t data_end )
+{ try {
+   std::fstream out( _index_filename.generic_string(), std::fstream::binary | std::fstream::in | std::fstream::out );
+   FC_ASSERT( out, "Unable to open ${f}", ("f", _index_filename) );
+   const boost::endian::little_uint64_buf_t valid_end( data_end );
+   out.seekp( offsetof( index_file_header, valid_end ) );
+   out.write( (const char*)&valid_end, sizeof(valid_end) );
+   out.flush();
+   FC_ASSERT( out, "Unable to write ${f}", ("f", _index_filename) );
+   _saved_index_end = data_end;
+} FC_CAPTURE_AND_RETHROW( (data_end) ) }
+
+operation_history_object operation_history_store::unpack_at( uint64_t instance )const
+{
+   const uint64_t offset = _offsets[instance];
+   const record_header& record = record_at( base(), offset );
+   const uint64_t body_offset = sizeof(record_header) + record.account_count.value() * sizeof(account_entry);
+   fc::datastream<const char*> ds( base() + offset + body_offset, record.size.value() - body_offset );
+   operation_history_object result;
+   fc::raw::unpack( ds, result );
+   return result;
+}
+
+void operation_history_store::map_file()
+{
+   _mapping = std::make_unique<fc::file_mapping>( _filename.generic_string().c_str(), fc::read_write );
+   _region = std::make_unique<fc::mapped_region>( *_mapping, fc::read_write );
+}
+
+void operation_history_store::unmap_file()
+{
+   _region.reset();
+   _mapping.reset();
+}
+
+void operation_history_store::reserve( uint64_t size )
+{ try {
+   const uint64_t capacity = _region->get_size();
+   if( size <= capacity )
+      return;
+   const uint64_t new_capacity = std::max( size, capacity + std::max( capacity / 2, min_growth ) );
+   unmap_file();
+   fc::resize_file( _filename, new_capacity );
+   map_file();
+} FC_CAPTURE_AND_RETHROW( (size) ) }
+
+} } // graphene::account_history
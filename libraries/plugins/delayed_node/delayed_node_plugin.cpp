@@ -31,12 +31,21 @@
 #include <fc/rpc/websocket_api.hpp>
 #include <fc/api.hpp>
 
+#include <deque>
+
 namespace graphene { namespace delayed_node {
 namespace bpo = boost::program_options;
 
 namespace detail {
+/// A block requested from the trusted node, precomputation starts as soon as it arrives
+struct prefetched_block {
+   fc::optional<graphene::chain::signed_block> block;
+   fc::future<void> precomputed;
+};
+
 struct delayed_node_plugin_impl {
    std::string remote_endpoint;
+   uint32_t fetch_window = 16;
    fc::http::websocket_client client;
    std::shared_ptr<fc::rpc::websocket_api_connection> client_connection;
    fc::api<graphene::app::database_api> database_api;
@@ -59,6 +68,8 @@ void delayed_node_plugin::plugin_set_program_options(bpo::options_description& c
    cli.add_options()
          ("trusted-node", boost::program_options::value<std::string>(),
           "RPC endpoint of a trusted validating node (required for delayed_node)")
+         ("trusted-node-fetch-window", boost::program_options::value<uint32_t>()->default_value(16),
+          "Number of blocks requested from the trusted node ahead of the block being applied while syncing")
          ;
    cfg.add(cli);
 }
@@ -93,6 +104,11 @@ void delayed_node_plugin::plugin_initialize(const boost::program_options::variab
    FC_ASSERT(options.count("trusted-node") > 0);
    my = std::make_unique<detail::delayed_node_plugin_impl>();
    my->remote_endpoint = "ws://" + options.at("trusted-node").as<std::string>();
+   if( options.count("trusted-node-fetch-window") > 0 )
+   {
+      my->fetch_window = options.at("trusted-node-fetch-window").as<uint32_t>();
+      FC_ASSERT( my->fetch_window > 0, "trusted-node-fetch-window must be positive" );
+   }
 }
 
 void delayed_node_plugin::sync_with_trusted_node()
@@ -116,15 +132,57 @@ void delayed_node_plugin::sync_with_trusted_node()
          break;
       }
       pass_count++;
-      while( remote_dpo.last_irreversible_block_num > db.head_block_num() )
+
+      // Keep up to fetch_window blocks requested while the oldest one is applied, each of them is precomputed
+      // as soon as it arrives
+      const uint32_t last_block_num = remote_dpo.last_irreversible_block_num;
+      uint32_t next_block_num = db.head_block_num() + 1;
+      std::deque< fc::future< std::shared_ptr<detail::prefetched_block> > > fetches;
+      auto fetch_more = [this,&db,&fetches,&next_block_num,last_block_num]() {
+         while( next_block_num <= last_block_num && fetches.size() < my->fetch_window )
+         {
+            const uint32_t block_num = next_block_num++;
+            fetches.push_back( fc::async( [this,&db,block_num]() {
+               auto fetched = std::make_shared<detail::prefetched_block>();
+               fetched->block = my->database_api->get_block( block_num );
+               if( fetched->block )
+                  fetched->precomputed = db.precompute_parallel( *fetched->block,
+                                                                 graphene::chain::database::skip_nothing );
+               return fetched;
+            }, "delayed_node fetch block" ) );
+         }
+      };
+      try
       {
-         fc::optional<graphene::chain::signed_block> block = my->database_api->get_block( db.head_block_num()+1 );
-         // TODO: during sync, decouple requesting blocks from preprocessing + applying them
-         FC_ASSERT(block, "Trusted node claims it has blocks it doesn't actually have.");
-         ilog("Pushing block #${n}", ("n", block->block_num()));
-         db.precompute_parallel( *block, graphene::chain::database::skip_nothing ).wait();
-         db.push_block(*block);
-         synced_blocks++;
+         fetch_more();
+         while( !fetches.empty() )
+         {
+            std::shared_ptr<detail::prefetched_block> fetched = fetches.front().wait();
+            fetches.pop_front();
+            fetch_more();
+            FC_ASSERT(fetched->block, "Trusted node claims it has blocks it doesn't actually have.");
+            ilog("Pushing block #${n}", ("n", fetched->block->block_num()));
+            fetched->precomputed.wait();
+            db.push_block(*fetched->block);
+            synced_blocks++;
+         }
+      }
+      catch( const fc::exception& )
+      {
+         // the outstanding requests refer to the database, let them finish before giving up
+         for( auto& fetch : fetches )
+         {
+            try
+            {
+               auto fetched = fetch.wait();
+               if( fetched->block )
+                  fetched->precomputed.wait();
+            }
+            catch( const fc::exception& )
+            {
+            }
+         }
+         throw;
       }
    }
 }
@@ -359,6 +359,7 @@ const account_transaction_history_object& elasticsearch_plugin_impl::addNewEntry
       obj.account = account_id;
       obj.sequence = stats_obj.total_ops + 1;
       obj.next = stats_obj.most_recent_op;
+      obj.operation_type = oho->op.which();
    });
 
    return ath;
@@ -26,9 +26,32 @@
 #include <graphene/app/plugin.hpp>
 #include <graphene/chain/database.hpp>
 
+#include <fc/thread/future.hpp>
 #include <fc/time.hpp>
 
 namespace graphene { namespace snapshot_plugin {
+namespace detail { class snapshot_capture; }
+
+/** One file of a snapshot, holding all objects of one index */
+struct snapshot_shard
+{
+   uint8_t     space_id = 0;
+   uint8_t     type_id = 0;
+   std::string file;
+   uint64_t    objects = 0;
+   uint64_t    size = 0;
+   fc::sha256  hash;
+};
+
+/** Describes a complete snapshot, written after all shards */
+struct snapshot_manifest
+{
+   uint32_t                         block_num = 0;
+   graphene::chain::block_id_type   block_id;
+   fc::time_point_sec               timestamp;
+   std::string                      format;
+   std::vector<snapshot_shard>      shards;
+};
 
 class snapshot_plugin : public graphene::app::plugin {
    public:
@@ -43,13 +66,24 @@ class snapshot_plugin : public graphene::app::plugin {
       ) override;
 
       void plugin_initialize( const boost::program_options::variables_map& options ) override;
+      void plugin_shutdown() override;
 
    private:
        void check_snapshot( const graphene::chain::signed_block& b);
+       /// Captures the state at block @p b and starts writing it in the background
+       void create_snapshot( const graphene::chain::signed_block& b );
+       void write_snapshot( snapshot_manifest manifest );
 
        uint32_t           snapshot_block = -1, last_block = 0;
        fc::time_point_sec snapshot_time = fc::time_point_sec::maximum(), last_time = fc::time_point_sec(1);
        fc::path           dest;
+       bool               binary_format = false;
+
+       std::shared_ptr<detail::snapshot_capture> capture;
+       fc::future<void>                          pending_snapshot;
 };
 
 } } //graphene::snapshot_plugin
+
+FC_REFLECT( graphene::snapshot_plugin::snapshot_shard, (space_id)(type_id)(file)(objects)(size)(hash) )
+FC_REFLECT( graphene::snapshot_plugin::snapshot_manifest, (block_num)(block_id)(timestamp)(format)(shards) )
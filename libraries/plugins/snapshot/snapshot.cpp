@@ -25,7 +25,15 @@
 
 #include <graphene/chain/database.hpp>
 
-#include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/thread/parallel.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <set>
+#include <unordered_map>
 
 using namespace graphene::snapshot_plugin;
 using std::string;
@@ -36,6 +44,7 @@ namespace bpo = boost::program_options;
 static const char* OPT_BLOCK_NUM  = "snapshot-at-block";
 static const char* OPT_BLOCK_TIME = "snapshot-at-time";
 static const char* OPT_DEST       = "snapshot-to";
+static const char* OPT_FORMAT     = "snapshot-format";
 
 void snapshot_plugin::plugin_set_program_options(
    boost::program_options::options_description& command_line_options,
@@ -44,7 +53,11 @@ void snapshot_plugin::plugin_set_program_options(
    command_line_options.add_options()
          (OPT_BLOCK_NUM, bpo::value<uint32_t>(), "Block number after which to do a snapshot")
          (OPT_BLOCK_TIME, bpo::value<string>(), "Block time (ISO format) after which to do a snapshot")
-         (OPT_DEST, bpo::value<string>(), "Pathname of JSON file where to store the snapshot")
+         (OPT_DEST, bpo::value<string>(),
+              "Directory where to store the snapshot, one file per index plus manifest.json. "
+              "Older versions wrote a single file to this path instead")
+         (OPT_FORMAT, bpo::value<string>()->default_value("json"),
+              "Format of the snapshot files, json (one object per line) or binary")
          ;
    config_file_options.add(command_line_options);
 }
@@ -72,6 +85,12 @@ void snapshot_plugin::plugin_initialize(const boost::program_options::variables_
          snapshot_block = options[OPT_BLOCK_NUM].as<uint32_t>();
       if( options.count(OPT_BLOCK_TIME) > 0 )
          snapshot_time = fc::time_point_sec::from_iso_string( options[OPT_BLOCK_TIME].as<std::string>() );
+      if( options.count(OPT_FORMAT) > 0 )
+      {
+         const std::string format = options[OPT_FORMAT].as<std::string>();
+         FC_ASSERT( format == "json" || format == "binary", "snapshot-format must be json or binary" );
+         binary_format = ( format == "binary" );
+      }
       database().applied_block.connect( [&]( const graphene::chain::signed_block& b ) {
          check_snapshot( b );
       });
@@ -82,37 +101,227 @@ void snapshot_plugin::plugin_initialize(const boost::program_options::variables_
    ilog("snapshot plugin: plugin_initialize() end");
 } FC_LOG_AND_RETHROW() }
 
-static void create_snapshot( const graphene::chain::database& db, const fc::path& dest )
+namespace graphene { namespace snapshot_plugin { namespace detail {
+
+/**
+ * Keeps the objects of the snapshot block consistent while the indexes are copied one after the other. Until its
+ * index is copied, the first change of an object saves the old value, or records that the object did not exist
+ * at the snapshot block. Undoing blocks goes through the same changes, so popped blocks are covered too.
+ */
+class snapshot_capture : public graphene::db::index_observer
 {
-   ilog("snapshot plugin: creating snapshot");
-   fc::ofstream out;
-   try
+   public:
+      struct source
+      {
+         const graphene::db::index* index;
+         uint8_t                    space_id;
+         uint8_t                    type_id;
+      };
+
+      /// Starts tracking all indexes of @p db, must be called on the thread that modifies it
+      void start( graphene::chain::database& db, const std::shared_ptr<snapshot_capture>& self )
+      {
+         _sources.clear();
+         _saved.clear();
+         for( uint32_t space_id = 0; space_id < 256; space_id++ )
+            for( uint32_t type_id = 0; type_id < 256; type_id++ )
+            {
+               const graphene::db::index* index = db.find_index( (uint8_t)space_id, (uint8_t)type_id );
+               if( index == nullptr )
+                  continue;
+               const uint16_t key = index_key( (uint8_t)space_id, (uint8_t)type_id );
+               if( _observed.insert( key ).second )
+                  db.add_index_observer( (uint8_t)space_id, (uint8_t)type_id, self );
+               _sources.push_back( { index, (uint8_t)space_id, (uint8_t)type_id } );
+               _saved[key];
+            }
+      }
+
+      /// Stops tracking the indexes that have not been copied
+      void stop() { _saved.clear(); }
+
+      const vector<source>& sources()const { return _sources; }
+
+      /// Copies the objects of source @p i as of the snapshot block, ordered by id, and stops tracking its index
+      vector< std::unique_ptr<graphene::db::object> > take( size_t i )
+      {
+         const source& src = _sources[i];
+         auto saved_itr = _saved.find( index_key( src.space_id, src.type_id ) );
+         FC_ASSERT( saved_itr != _saved.end(), "Index ${s}.${t} is not tracked", ("s",src.space_id)("t",src.type_id) );
+         auto& saved = saved_itr->second;
+         vector< std::unique_ptr<graphene::db::object> > result;
+         src.index->inspect_all_objects( [&result,&saved]( const graphene::db::object& obj ) {
+            if( saved.find( obj.id.instance() ) == saved.end() )
+               result.push_back( obj.clone() );
+         });
+         for( auto& item : saved )
+            if( item.second )
+               result.push_back( std::move( item.second ) );
+         _saved.erase( saved_itr );
+         std::sort( result.begin(), result.end(), []( const auto& a, const auto& b ) {
+            return a->id.instance() < b->id.instance();
+         });
+         return result;
+      }
+
+      void on_add( const graphene::db::object& obj ) override { save( obj, false ); }
+      void on_remove( const graphene::db::object& obj ) override { save( obj, true ); }
+      void about_to_modify( const graphene::db::object& obj ) override { save( obj, true ); }
+
+   private:
+      static uint16_t index_key( uint8_t space_id, uint8_t type_id ) { return ( uint16_t(space_id) << 8 ) | type_id; }
+
+      void save( const graphene::db::object& obj, bool existed )
+      {
+         if( _saved.empty() )
+            return;
+         auto itr = _saved.find( index_key( obj.id.space(), obj.id.type() ) );
+         if( itr == _saved.end() || itr->second.find( obj.id.instance() ) != itr->second.end() )
+            return;
+         itr->second[ obj.id.instance() ] = existed ? obj.clone() : std::unique_ptr<graphene::db::object>();
+      }
+
+      vector<source>  _sources;
+      /// Old values by instance of the indexes not copied yet, null for objects created after the snapshot block
+      std::unordered_map< uint16_t,
+                          std::unordered_map< uint64_t, std::unique_ptr<graphene::db::object> > > _saved;
+      std::set<uint16_t> _observed;
+};
+
+} } } // graphene::snapshot_plugin::detail
+
+namespace {
+
+/// Copied indexes waiting to be written, bounds the memory used for copies
+const size_t max_shards_in_flight = 4;
+
+/** Writes all @p objects of one index into one shard and returns its manifest entry */
+snapshot_shard write_shard( const vector< std::unique_ptr<graphene::db::object> >& objects,
+                            uint8_t space_id, uint8_t type_id, const fc::path& dir, bool binary_format )
+{
+   snapshot_shard shard;
+   shard.space_id = space_id;
+   shard.type_id = type_id;
+   shard.file = fc::to_string( uint32_t( space_id ) ) + "." + fc::to_string( uint32_t( type_id ) )
+                + ( binary_format ? ".bin" : ".json" );
+   shard.objects = objects.size();
+
+   std::ofstream out( ( dir / shard.file ).generic_string(),
+                      std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+   FC_ASSERT( out, "Failed to open snapshot file ${f}", ("f",shard.file) );
+   fc::sha256::encoder enc;
+   auto write = [&out,&enc,&shard]( const char* data, size_t size ) {
+      out.write( data, size );
+      enc.write( data, size );
+      shard.size += size;
+   };
+   for( const auto& obj : objects )
    {
-      out.open( dest );
+      if( binary_format )
+      {
+         // same record layout as the object database files: size prefixed packed objects
+         const vector<char> record = fc::raw::pack( obj->pack() );
+         write( record.data(), record.size() );
+      }
+      else
+      {
+         const std::string line = fc::json::to_string( obj->to_variant() ) + '\n';
+         write( line.data(), line.size() );
+      }
    }
-   catch ( fc::exception& e )
+   out.close();
+   FC_ASSERT( !out.fail(), "Failed to write snapshot file ${f}", ("f",shard.file) );
+   shard.hash = enc.result();
+   return shard;
+}
+
+} // anonymous namespace
+
+void snapshot_plugin::plugin_shutdown()
+{
+   if( pending_snapshot.valid() && !pending_snapshot.ready() )
+   {
+      ilog( "snapshot plugin: waiting for the snapshot to be written" );
+      pending_snapshot.wait();
+   }
+}
+
+void snapshot_plugin::create_snapshot( const graphene::chain::signed_block& b )
+{
+   if( pending_snapshot.valid() && !pending_snapshot.ready() )
    {
-      wlog( "Failed to open snapshot destination: ${ex}", ("ex",e) );
+      wlog( "snapshot plugin: still writing the previous snapshot, skipping block ${n}", ("n",b.block_num()) );
       return;
    }
-   for( uint32_t space_id = 0; space_id < 256; space_id++ )
-      for( uint32_t type_id = 0; type_id < 256; type_id++ )
+   ilog("snapshot plugin: creating snapshot at block ${n}", ("n",b.block_num()));
+   if( !capture )
+      capture = std::make_shared<detail::snapshot_capture>();
+   capture->start( database(), capture );
+
+   snapshot_manifest manifest;
+   manifest.block_num = b.block_num();
+   manifest.block_id = b.id();
+   manifest.timestamp = b.timestamp;
+   manifest.format = binary_format ? "binary" : "json";
+   // the indexes are copied and written by a separate task, so that blocks are applied meanwhile
+   pending_snapshot = fc::async( [this,manifest]() { write_snapshot( manifest ); }, "snapshot" );
+}
+
+void snapshot_plugin::write_snapshot( snapshot_manifest manifest )
+{
+   const auto& sources = capture->sources();
+   auto shards = std::make_shared< vector<snapshot_shard> >( sources.size() );
+   std::deque< fc::future<void> > writing;
+   try
+   {
+      fc::create_directories( dest );
+      fc::remove( dest / "manifest.json" );
+      const fc::path dir = dest;
+      const bool binary = binary_format;
+      for( size_t i = 0; i < sources.size(); ++i )
       {
-         try
+         while( writing.size() >= max_shards_in_flight )
          {
-            db.get_index( (uint8_t)space_id, (uint8_t)type_id );
+            writing.front().wait();
+            writing.pop_front();
          }
-         catch (fc::assert_exception& e)
-         {
-            continue;
-         }
-         auto& index = db.get_index( (uint8_t)space_id, (uint8_t)type_id );
-         index.inspect_all_objects( [&out]( const graphene::db::object& o ) {
-            out << fc::json::to_string( o.to_variant() ) << '\n';
-         });
+         // copying an index is much cheaper than serializing it, the blocks in between are tracked by the capture
+         auto objects = std::make_shared< vector< std::unique_ptr<graphene::db::object> > >( capture->take( i ) );
+         const uint8_t space_id = sources[i].space_id;
+         const uint8_t type_id = sources[i].type_id;
+         writing.push_back( fc::do_parallel( [objects,shards,i,space_id,type_id,dir,binary]() {
+            (*shards)[i] = write_shard( *objects, space_id, type_id, dir, binary );
+         }));
+         fc::yield();
       }
-   out.close();
-   ilog("snapshot plugin: created snapshot");
+      for( ; !writing.empty(); writing.pop_front() )
+         writing.front().wait();
+
+      manifest.shards = std::move( *shards );
+      fc::json::save_to_file( manifest, dest / "manifest.json" );
+      ilog( "snapshot plugin: created snapshot of block ${n} in ${s} files",
+            ("n",manifest.block_num)("s",manifest.shards.size()) );
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "snapshot plugin: failed to write snapshot: ${e}", ("e",e.to_detail_string()) );
+   }
+   catch( const std::exception& e )
+   {
+      elog( "snapshot plugin: failed to write snapshot: ${e}", ("e",e.what()) );
+   }
+   capture->stop();
+   // the workers own their data, but must not outlive the plugin
+   for( auto& task : writing )
+   {
+      try
+      {
+         task.wait();
+      }
+      catch( ... )
+      {
+      }
+   }
 }
 
 void snapshot_plugin::check_snapshot( const graphene::chain::signed_block& b )
@@ -120,7 +329,7 @@ void snapshot_plugin::check_snapshot( const graphene::chain::signed_block& b )
     uint32_t current_block = b.block_num();
     if( (last_block < snapshot_block && snapshot_block <= current_block)
            || (last_time < snapshot_time && snapshot_time <= b.timestamp) )
-       create_snapshot( database(), dest );
+       create_snapshot( b );
     last_block = current_block;
     last_time = b.timestamp;
 } FC_LOG_AND_RETHROW() }
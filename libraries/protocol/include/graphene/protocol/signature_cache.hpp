@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/types.hpp>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace protocol {
+
+   /**
+    * A bounded, thread-safe cache of public keys recovered from transaction signatures.
+    *
+    * Entries are keyed by the signature digest of a transaction (which includes the chain ID) together with
+    * one of its signatures, so a hit is exactly the result ECDSA recovery would have produced. This allows the
+    * same transaction to be checked in the pending pool, inside a block and again after a fork switch while
+    * paying for the recovery only once, even though each of these paths works on its own copy of the
+    * transaction.
+    *
+    * The cache keeps two generations of entries. New entries go into the current generation; once it holds
+    * half of the configured capacity it replaces the previous one, which is dropped. Entries found in the
+    * previous generation are moved back into the current one, so recently used keys stay cached.
+    */
+   class signature_cache
+   {
+   public:
+      static constexpr size_t default_max_entries = 100000;
+
+      explicit signature_cache( size_t max_entries = default_max_entries ) : _max_entries( max_entries ) {}
+
+      /// Returns the public key that signed @p digest with @p sig, recovering and caching it if needed
+      public_key_type recover( const digest_type& digest, const signature_type& sig );
+
+      /// Sets the maximum number of cached keys, 0 disables the cache. Existing entries are dropped.
+      void set_max_entries( size_t max_entries );
+      size_t max_entries()const;
+
+      /// Number of keys currently cached
+      size_t size()const;
+      /// Number of lookups answered from the cache so far
+      uint64_t hits()const;
+      /// Number of keys recovered so far because they were not cached
+      uint64_t misses()const;
+
+      void clear();
+
+   private:
+      struct entry_key
+      {
+         digest_type    digest;
+         signature_type sig;
+
+         bool operator==( const entry_key& other )const
+         {
+            return digest == other.digest && sig == other.sig;
+         }
+      };
+      struct entry_key_hash
+      {
+         size_t operator()( const entry_key& k )const;
+      };
+      using map_type = std::unordered_map< entry_key, public_key_type, entry_key_hash >;
+
+      mutable std::mutex _mutex;
+      size_t             _max_entries;
+      map_type           _current;
+      map_type           _previous;
+      uint64_t           _hits = 0;
+      uint64_t           _misses = 0;
+   };
+
+} } // graphene::protocol
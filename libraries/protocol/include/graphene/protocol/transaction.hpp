@@ -24,6 +24,7 @@
  */
 #pragma once
 #include <graphene/protocol/operations.hpp>
+#include <graphene/protocol/signature_cache.hpp>
 
 namespace graphene { namespace protocol {
    struct predicate_result;
@@ -214,6 +215,17 @@ namespace graphene { namespace protocol {
        */
       virtual const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id )const;
 
+      /**
+       * @brief Extract public keys from signatures with given chain ID, reusing keys found in @p cache.
+       * @param chain_id A chain ID
+       * @param cache Keys recovered for this transaction by earlier calls, possibly on other copies of it
+       * @return Public keys
+       * @note Behaves like @ref get_signature_keys(const chain_id_type&)const, except that signatures whose
+       *       keys are in @p cache are not recovered again, and newly recovered keys are added to it.
+       */
+      virtual const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id,
+                                                                   signature_cache& cache )const;
+
       /** Signatures */
       vector<signature_type> signatures;
 
@@ -241,6 +253,8 @@ namespace graphene { namespace protocol {
       virtual const transaction_id_type&       id()const override;
       virtual void                             validate()const override;
       virtual const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id )const override;
+      virtual const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id,
+                                                                   signature_cache& cache )const override;
       virtual uint64_t                         get_packed_size()const override;
    protected:
       mutable bool _validated = false;
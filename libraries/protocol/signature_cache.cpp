@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/protocol/signature_cache.hpp>
+
+#include <array>
+#include <cstring>
+#include <random>
+
+namespace graphene { namespace protocol {
+
+namespace {
+
+   /// Random key of @ref siphash, chosen once per process so that peers cannot precompute colliding entries
+   const std::array<uint64_t,2>& hash_key()
+   {
+      static const std::array<uint64_t,2> key = [] () {
+         std::random_device rd;
+         std::array<uint64_t,2> result;
+         for( uint64_t& part : result )
+            part = ( uint64_t( rd() ) << 32 ) ^ rd();
+         return result;
+      }();
+      return key;
+   }
+
+   inline uint64_t rotl( uint64_t x, int b ) { return ( x << b ) | ( x >> ( 64 - b ) ); }
+
+   /// SipHash-2-4 of @p len bytes at @p data
+   uint64_t siphash( const unsigned char* data, size_t len )
+   {
+      const std::array<uint64_t,2>& key = hash_key();
+      uint64_t v0 = key[0] ^ 0x736f6d6570736575ULL;
+      uint64_t v1 = key[1] ^ 0x646f72616e646f6dULL;
+      uint64_t v2 = key[0] ^ 0x6c7967656e657261ULL;
+      uint64_t v3 = key[1] ^ 0x7465646279746573ULL;
+      auto round = [&v0,&v1,&v2,&v3] () {
+         v0 += v1; v1 = rotl( v1, 13 ); v1 ^= v0; v0 = rotl( v0, 32 );
+         v2 += v3; v3 = rotl( v3, 16 ); v3 ^= v2;
+         v0 += v3; v3 = rotl( v3, 21 ); v3 ^= v0;
+         v2 += v1; v1 = rotl( v1, 17 ); v1 ^= v2; v2 = rotl( v2, 32 );
+      };
+      auto compress = [&v0,&v3,&round] ( uint64_t m ) {
+         v3 ^= m;
+         round();
+         round();
+         v0 ^= m;
+      };
+
+      const size_t full = len - len % 8;
+      for( size_t i = 0; i < full; i += 8 )
+      {
+         uint64_t m = 0;
+         for( size_t j = 0; j < 8; ++j )
+            m |= uint64_t( data[i + j] ) << ( 8 * j );
+         compress( m );
+      }
+      uint64_t last = uint64_t( len ) << 56;
+      for( size_t j = 0; j < len % 8; ++j )
+         last |= uint64_t( data[full + j] ) << ( 8 * j );
+      compress( last );
+
+      v2 ^= 0xff;
+      for( int i = 0; i < 4; ++i )
+         round();
+      return v0 ^ v1 ^ v2 ^ v3;
+   }
+
+} // anonymous namespace
+
+constexpr size_t signature_cache::default_max_entries;
+
+size_t signature_cache::entry_key_hash::operator()( const entry_key& k )const
+{
+   // peers choose both parts freely, e. g. any s of a signature still recovers a key, so the whole key is
+   // hashed with a secret seed to keep them from filling a single bucket
+   unsigned char buf[ sizeof(k.digest._hash) + sizeof(k.sig.data) ];
+   std::memcpy( buf, k.digest._hash, sizeof(k.digest._hash) );
+   std::memcpy( buf + sizeof(k.digest._hash), k.sig.data, sizeof(k.sig.data) );
+   return static_cast<size_t>( siphash( buf, sizeof(buf) ) );
+}
+
+public_key_type signature_cache::recover( const digest_type& digest, const signature_type& sig )
+{
+   entry_key key{ digest, sig };
+   {
+      std::lock_guard<std::mutex> guard( _mutex );
+      auto itr = _current.find( key );
+      if( itr != _current.end() )
+      {
+         ++_hits;
+         return itr->second;
+      }
+      itr = _previous.find( key );
+      if( itr != _previous.end() )
+      {
+         ++_hits;
+         public_key_type result = itr->second;
+         if( _current.size() < _max_entries / 2 )
+         {
+            _previous.erase( itr );
+            _current.emplace( std::move(key), result );
+         }
+         return result;
+      }
+      ++_misses;
+   }
+
+   // recover outside of the lock, this is the expensive part
+   public_key_type result( fc::ecc::public_key( sig, digest ) );
+
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( _max_entries == 0 )
+      return result;
+   if( _current.size() >= _max_entries / 2 )
+   {
+      _previous = std::move( _current );
+      _current.clear();
+   }
+   _current.emplace( std::move(key), result );
+   return result;
+}
+
+void signature_cache::set_max_entries( size_t max_entries )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _max_entries = max_entries;
+   _current.clear();
+   _previous.clear();
+}
+
+size_t signature_cache::max_entries()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   return _max_entries;
+}
+
+size_t signature_cache::size()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   return _current.size() + _previous.size();
+}
+
+uint64_t signature_cache::hits()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   return _hits;
+}
+
+uint64_t signature_cache::misses()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   return _misses;
+}
+
+void signature_cache::clear()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _current.clear();
+   _previous.clear();
+}
+
+} } // graphene::protocol
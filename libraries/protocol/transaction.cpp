@@ -363,6 +363,22 @@ const flat_set<public_key_type>& signed_transaction::get_signature_keys( const c
    return _signees;
 } FC_CAPTURE_AND_RETHROW() }
 
+const flat_set<public_key_type>& signed_transaction::get_signature_keys( const chain_id_type& chain_id,
+                                                                         signature_cache& cache )const
+{ try {
+   auto d = sig_digest( chain_id );
+   flat_set<public_key_type> result;
+   for( const auto&  sig : signatures )
+   {
+      GRAPHENE_ASSERT(
+         result.insert( cache.recover( d, sig ) ).second,
+            tx_duplicate_sig,
+            "Duplicate Signature detected" );
+   }
+   _signees = std::move( result );
+   return _signees;
+} FC_CAPTURE_AND_RETHROW() }
+
 
 set<public_key_type> signed_transaction::get_required_signatures( const chain_id_type& chain_id,
                                                                   const flat_set<public_key_type>& available_keys,
@@ -462,6 +478,15 @@ const flat_set<public_key_type>& precomputable_transaction::get_signature_keys(
    return _signees;
 }
 
+const flat_set<public_key_type>& precomputable_transaction::get_signature_keys( const chain_id_type& chain_id,
+                                                                                signature_cache& cache )const
+{
+   // See above regarding the chain ID
+   if( _signees.empty() )
+      signed_transaction::get_signature_keys( chain_id, cache );
+   return _signees;
+}
+
 void signed_transaction::verify_authority( const chain_id_type& chain_id,
                                            const std::function<const authority*(account_id_type)>& get_active,
                                            const std::function<const authority*(account_id_type)>& get_owner,
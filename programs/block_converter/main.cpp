@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/chain/block_database.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <iostream>
+#include <string>
+
+using namespace graphene::chain;
+namespace bpo = boost::program_options;
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description cli_options(
+            "R-Squared block log converter\n\n"
+            "The node itself never compresses blocks, it appends every new block uncompressed, also to a "
+            "chunked block log. Run this tool on a stopped node to compress the blocks stored since the last "
+            "conversion");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("input-dir,i", bpo::value<boost::filesystem::path>(),
+             "Directory of the block database to read, e.g. <data-dir>/blockchain/database/block_num_to_block")
+            ("output-dir,o", bpo::value<boost::filesystem::path>(),
+             "Directory to write the converted block database to, must not contain a block database")
+            ("format,f", bpo::value<std::string>()->default_value("chunked"), "Output format, raw or chunked")
+            ("blocks-per-chunk", bpo::value<uint32_t>()->default_value(64),
+             "Number of blocks compressed together in the chunked format")
+            ("compression-level", bpo::value<int>()->default_value(1),
+             "zlib compression level for the chunked format, 1 (fastest) to 9 (smallest)")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         bpo::store( bpo::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const bpo::error& e)
+      {
+         std::cerr << "block_converter:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 1;
+      }
+
+      if( !options.count( "input-dir" ) || !options.count( "output-dir" ) )
+      {
+         std::cerr << "--input-dir and --output-dir options are required\n";
+         return 1;
+      }
+
+      const std::string format_name = options["format"].as<std::string>();
+      block_log_format format;
+      if( format_name == "raw" )
+         format = block_log_format::raw;
+      else if( format_name == "chunked" )
+         format = block_log_format::chunked;
+      else
+      {
+         std::cerr << "Unknown format " << format_name << ", use raw or chunked\n";
+         return 1;
+      }
+
+      const int level = options["compression-level"].as<int>();
+      if( level < 1 || level > 9 )
+      {
+         std::cerr << "--compression-level must be between 1 and 9\n";
+         return 1;
+      }
+
+      block_database::convert( options["input-dir"].as<boost::filesystem::path>(),
+                               options["output-dir"].as<boost::filesystem::path>(),
+                               format,
+                               options["blocks-per-chunk"].as<uint32_t>(),
+                               level );
+      std::cerr << "Done. Stop the node and replace the contents of the input directory with the output directory.\n";
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
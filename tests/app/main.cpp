@@ -387,6 +387,146 @@ BOOST_AUTO_TEST_CASE( two_node_network )
    }
 }
 
+BOOST_AUTO_TEST_CASE( compact_block_relay )
+{
+   using namespace graphene::chain;
+   using namespace graphene::app;
+   try {
+      BOOST_TEST_MESSAGE( "Creating and initializing app1" );
+
+      auto port = fc::network::get_available_port();
+      auto app1_p2p_endpoint_str = string("127.0.0.1:") + std::to_string(port);
+      auto app2_seed_nodes_str = string("[\"") + app1_p2p_endpoint_str + "\"]";
+
+      fc::temp_directory app_dir( graphene::utilities::temp_directory_path() );
+      auto genesis_file = create_genesis_file(app_dir);
+
+      graphene::app::application app1;
+      app1.register_plugin< graphene::witness_plugin::witness_plugin >();
+      auto sharable_cfg = std::make_shared<boost::program_options::variables_map>();
+      auto& cfg = *sharable_cfg;
+      fc::set_option( cfg, "p2p-endpoint", app1_p2p_endpoint_str );
+      fc::set_option( cfg, "genesis-json", genesis_file );
+      fc::set_option( cfg, "seed-nodes", string("[]") );
+      app1.initialize(app_dir.path(), sharable_cfg);
+      app1.startup();
+
+      auto node_startup_wait_time = fc::seconds(15);
+
+      fc::wait_for( node_startup_wait_time, [&app1,port] () {
+         const auto status = app1.p2p_node()->network_get_info();
+         return status["listening_on"].as<fc::ip::endpoint>( 5 ).port() == port;
+      });
+
+      BOOST_TEST_MESSAGE( "Creating and initializing app2" );
+
+      fc::temp_directory app2_dir( graphene::utilities::temp_directory_path() );
+      graphene::app::application app2;
+      app2.register_plugin< graphene::witness_plugin::witness_plugin >();
+      auto sharable_cfg2 = std::make_shared<boost::program_options::variables_map>();
+      auto& cfg2 = *sharable_cfg2;
+      fc::set_option( cfg2, "genesis-json", genesis_file );
+      fc::set_option( cfg2, "seed-nodes", app2_seed_nodes_str );
+      app2.initialize(app2_dir.path(), sharable_cfg2);
+      app2.startup();
+
+      // compact blocks are only sent to peers which are in sync with us
+      auto in_sync = [] ( graphene::app::application& app ) {
+         if( app.p2p_node()->get_connection_count() == 0 )
+            return false;
+         const auto& peer_info = app.p2p_node()->get_connected_peers().front().info;
+         auto itr = peer_info.find( "peer_needs_sync_items_from_us" );
+         return itr != peer_info.end() && !itr->value().as<bool>(1);
+      };
+      fc::wait_for( node_startup_wait_time, [&] () { return in_sync( app1 ) && in_sync( app2 ); } );
+      BOOST_REQUIRE_EQUAL( app1.p2p_node()->get_connection_count(), 1u );
+      BOOST_REQUIRE( app1.p2p_node()->get_advanced_node_parameters()["send_compact_blocks"].as<bool>(1) );
+
+      std::shared_ptr<chain::database> db1 = app1.chain_database();
+      std::shared_ptr<chain::database> db2 = app2.chain_database();
+
+      account_id_type rsquaredchp1_id = db2->get_index_type<account_index>().indices().get<by_name>()
+                                            .find( "rsquaredchp1" )->id;
+      fc::ecc::private_key rsquaredchp1_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("rsquaredchp1")));
+
+      auto make_transfer = [&] ( int64_t amount, bool claim_balance ) {
+         precomputable_transaction trx;
+         if( claim_balance )
+         {
+            balance_claim_operation claim_op;
+            balance_id_type bid = balance_id_type();
+            claim_op.deposit_to_account = rsquaredchp1_id;
+            claim_op.balance_to_claim = bid;
+            claim_op.balance_owner_key = rsquaredchp1_key.get_public_key();
+            claim_op.total_claimed = bid(*db1).balance;
+            trx.operations.push_back( claim_op );
+            db1->current_fee_schedule().set_fee( trx.operations.back() );
+         }
+         transfer_operation xfer_op;
+         xfer_op.from = rsquaredchp1_id;
+         xfer_op.to = GRAPHENE_NULL_ACCOUNT;
+         xfer_op.amount = asset( amount );
+         trx.operations.push_back( xfer_op );
+         db1->current_fee_schedule().set_fee( trx.operations.back() );
+         trx.set_expiration( db1->get_slot_time( 10 ) );
+         trx.sign( rsquaredchp1_key, db1->get_chain_id() );
+         trx.validate();
+         return trx;
+      };
+
+      BOOST_TEST_MESSAGE( "Relaying a transaction from app1 to app2" );
+      precomputable_transaction relayed_trx = make_transfer( 1000000, true );
+      db1->push_transaction( relayed_trx );
+      app1.p2p_node()->broadcast( graphene::net::trx_message( relayed_trx ) );
+
+      auto broadcast_wait_time = fc::seconds(15);
+      fc::wait_for( broadcast_wait_time, [db2] () {
+         return db2->get_balance( GRAPHENE_NULL_ACCOUNT, asset_id_type() ).amount.value == 1000000;
+      });
+      BOOST_REQUIRE_EQUAL( db2->get_balance( GRAPHENE_NULL_ACCOUNT, asset_id_type() ).amount.value, 1000000 );
+
+      BOOST_TEST_MESSAGE( "Pushing a transaction app1 never sees on app2" );
+      precomputable_transaction unrelayed_trx = make_transfer( 500000, false );
+      db2->push_transaction( unrelayed_trx );
+      BOOST_CHECK_EQUAL( db1->get_balance( GRAPHENE_NULL_ACCOUNT, asset_id_type() ).amount.value, 1000000 );
+      BOOST_CHECK_EQUAL( db2->get_balance( GRAPHENE_NULL_ACCOUNT, asset_id_type() ).amount.value, 1500000 );
+
+      fc::wait_for( broadcast_wait_time, [db2] () {
+         return db2->get_slot_time(1) <= fc::time_point::now();
+      });
+
+      fc::ecc::private_key committee_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("rsquaredchp1")));
+      auto block_1 = db2->generate_block(
+         db2->get_slot_time(1),
+         db2->get_scheduled_witness(1),
+         committee_key,
+         database::skip_nothing);
+      BOOST_REQUIRE_EQUAL( block_1.transactions.size(), 2u );
+
+      // app1 fetches the block, gets it as a compact block, takes the relayed transaction from its message
+      // cache and fetches the other one from app2
+      BOOST_TEST_MESSAGE( "Broadcasting block" );
+      app2.p2p_node()->broadcast( graphene::net::block_message( block_1 ) );
+
+      fc::wait_for( broadcast_wait_time, [db1] () {
+         return db1->head_block_num() == 1;
+      });
+
+      BOOST_CHECK_EQUAL( app1.p2p_node()->get_connection_count(), 1u );
+      BOOST_REQUIRE_EQUAL( db1->head_block_num(), 1u );
+      BOOST_CHECK( db1->head_block_id() == block_1.id() );
+      BOOST_CHECK_EQUAL( db1->get_balance( GRAPHENE_NULL_ACCOUNT, asset_id_type() ).amount.value, 1500000 );
+
+      const auto node1_params = app1.p2p_node()->get_advanced_node_parameters();
+      BOOST_CHECK_EQUAL( node1_params["compact_blocks_rebuilt"].as<uint64_t>(1), 1u );
+      BOOST_CHECK_EQUAL( node1_params["compact_blocks_with_fetched_transactions"].as<uint64_t>(1), 1u );
+
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 // a contrived example to test the breaking out of application_impl to a header file
 BOOST_AUTO_TEST_CASE(application_impl_breakout) {
 
@@ -32,6 +32,7 @@
 #include <graphene/es_objects/es_objects.hpp>
 #include <graphene/custom_operations/custom_operations_plugin.hpp>
 #include <graphene/content_cards/content_cards.hpp>
+#include <graphene/snapshot/snapshot.hpp>
 
 #include <graphene/chain/balance_object.hpp>
 #include <graphene/chain/committee_member_object.hpp>
@@ -195,6 +196,10 @@ std::shared_ptr<boost::program_options::variables_map> database_fixture_base::in
    {
       fc::set_option( options, "max-ops-per-account", (uint64_t)75 );
    }
+   if (fixture.current_test_name == "get_account_history_from_file_storage")
+   {
+      fc::set_option( options, "history-storage", std::string("file") );
+   }
    if (fixture.current_test_name == "api_limit_get_account_history_operations")
    {
       fc::set_option( options, "max-ops-per-account", (uint64_t)125 );
@@ -263,6 +268,10 @@ std::shared_ptr<boost::program_options::variables_map> database_fixture_base::in
    {
       fc::set_option( options, "api-limit-lookup-committee-member-accounts", (uint64_t)200 );
    }
+   if(fixture.current_test_name =="get_transaction_by_id")
+   {
+      fc::set_option( options, "enable-transaction-id-index", true );
+   }
    if(fixture.current_test_name =="api_limit_lookup_vote_ids")
    {
       fc::set_option( options, "api-limit-lookup-vote-ids", (uint64_t)2 );
@@ -319,6 +328,9 @@ std::shared_ptr<boost::program_options::variables_map> database_fixture_base::in
           || fixture.current_test_name == "track_votes_committee_disabled") {
       fixture.app.chain_database()->enable_standby_votes_tracking( false );
    }
+   // check the incremental vote tally on every maintenance, except where it would distort the timings
+   if( fixture.current_suite_name != "performance_tests" )
+      fixture.app.chain_database()->enable_vote_tally_verification( true );
    // load ES or AH, but not both
    if(fixture.current_test_name == "elasticsearch_account_history" ||
          fixture.current_test_name == "elasticsearch_suite" ||
@@ -346,6 +358,13 @@ std::shared_ptr<boost::program_options::variables_map> database_fixture_base::in
       fixture.app.register_plugin<graphene::account_history::account_history_plugin>(true);
    }
 
+   if( fixture.current_test_name == "snapshot_shards" ) {
+      fixture.app.register_plugin<graphene::snapshot_plugin::snapshot_plugin>(true);
+      fc::set_option( options, "snapshot-at-block", uint32_t(3) );
+      fc::set_option( options, "snapshot-to", ( fixture.data_dir.path() / "snapshot" ).generic_string() );
+      fc::set_option( options, "snapshot-format", string("json") );
+   }
+
    if(fixture.current_test_name == "elasticsearch_objects" || fixture.current_test_name == "elasticsearch_suite") {
       fixture.app.register_plugin<graphene::es_objects::es_objects_plugin>(true);
 
@@ -503,6 +522,76 @@ string database_fixture_base::generate_anon_acct_name()
    return "anon-acct-x" + std::to_string( anon_acct_count++ );
 }
 
+fc::sha256 database_fixture_base::hash_object_database( const database& db )
+{
+   fc::sha256::encoder enc;
+   for( uint8_t space = 0; space < 3; ++space )
+      for( uint16_t type = 0; type < 256; ++type )
+      {
+         const graphene::db::index* idx = db.find_index( space, uint8_t(type) );
+         if( idx == nullptr )
+            continue;
+         idx->inspect_all_objects( [&enc,idx]( const object& o ) {
+            const std::vector<char> data = idx->pack_object( o );
+            enc.write( data.data(), data.size() );
+         });
+      }
+   return enc.result();
+}
+
+void database_fixture_base::verify_replay_equivalence( const std::function<void(database&)>& configure )
+{
+   const uint32_t head_num = db.head_block_num();
+   if( head_num == 0 )
+      return;
+
+   genesis_state_type replica_genesis = genesis_state;
+   replica_genesis.initial_chain_id = db.get_chain_id();
+   fc::temp_directory default_dir( graphene::utilities::temp_directory_path() ),
+                      configured_dir( graphene::utilities::temp_directory_path() );
+   database default_db,
+            configured_db;
+   configure( configured_db );
+   default_db.open( default_dir.path(), [&replica_genesis]() { return replica_genesis; }, "TEST" );
+   configured_db.open( configured_dir.path(), [&replica_genesis]() { return replica_genesis; }, "TEST" );
+
+   // many tests push transactions without signatures, blocks which fail in both replicas are applied
+   // without checking signatures so that the rest of the chain is still compared
+   const uint32_t skip = database::skip_witness_signature | database::skip_witness_schedule_check;
+   auto push = []( database& replica, const signed_block& block, uint32_t skip_flags ) {
+      try
+      {
+         replica.push_block( block, skip_flags );
+         return true;
+      }
+      catch( const fc::exception& )
+      {
+         return false;
+      }
+   };
+   for( uint32_t num = 1; num <= head_num; ++num )
+   {
+      optional<signed_block> block = db.fetch_block_by_number( num );
+      if( !block )
+         break;
+      const bool default_accepted = push( default_db, *block, skip );
+      const bool configured_accepted = push( configured_db, *block, skip );
+      BOOST_CHECK_MESSAGE( default_accepted == configured_accepted,
+                           "block " << num << " was " << ( default_accepted ? "accepted" : "rejected" )
+                           << " by the default and " << ( configured_accepted ? "accepted" : "rejected" )
+                           << " by the configured database" );
+      if( default_accepted != configured_accepted )
+         return;
+      if( !default_accepted
+          && !( push( default_db, *block, skip | database::skip_transaction_signatures )
+                && push( configured_db, *block, skip | database::skip_transaction_signatures ) ) )
+         break;
+   }
+
+   BOOST_CHECK( default_db.head_block_id() == configured_db.head_block_id() );
+   BOOST_CHECK( hash_object_database( default_db ) == hash_object_database( configured_db ) );
+}
+
 void database_fixture_base::verify_asset_supplies( const database& db )
 {
    //wlog("*** Begin asset supply verification ***");
@@ -231,6 +231,11 @@ struct database_fixture_base {
    static fc::ecc::private_key generate_private_key(string seed);
    string generate_anon_acct_name();
    static void verify_asset_supplies( const database& db );
+   /// @return a hash of every object in @p db
+   static fc::sha256 hash_object_database( const database& db );
+   /// Replays the blocks of @p db into two new databases, the second one set up by @p configure, and checks that
+   /// both accept the same blocks and end up in the same state
+   void verify_replay_equivalence( const std::function<void(database&)>& configure );
    void vote_for_committee_and_witnesses(uint16_t num_committee, uint16_t num_witness);
    void enable_workers_payments(bool enable = true);
    signed_block generate_block(uint32_t skip = ~0,
@@ -31,6 +31,7 @@
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
+#include <graphene/chain/witness_object.hpp>
 
 #include <graphene/db/simple_index.hpp>
 
@@ -210,4 +211,146 @@ BOOST_AUTO_TEST_CASE( one_hundred_k_benchmark )
    db._undo_db.enable();
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( undo_session_benchmark )
+{ try {
+   ACTORS( (alice)(bob) );
+
+   const uint32_t objects_per_session = 100;
+   std::vector<account_id_type> accounts;
+   for( uint32_t i = 0; i < objects_per_session; ++i )
+      accounts.push_back( create_account( "undo" + fc::to_string(i) ).id );
+
+   const uint64_t cycles = 20000;
+   {
+      // every session saves the old state of a set of objects, then half of them are undone
+      // and the other half is merged into an outer session, like pending transactions in a block
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < cycles; i += 2 )
+      {
+         auto outer = db._undo_db.start_undo_session();
+         for( uint32_t j = 0; j < 2; ++j )
+         {
+            auto session = db._undo_db.start_undo_session();
+            for( const auto& id : accounts )
+               db.modify( id(db), [i]( account_object& a ) { a.referrer_rewards_percentage = i % 100; } );
+            if( j == 0 )
+               session.undo();
+            else
+               session.merge();
+         }
+         outer.undo();
+      }
+      auto elapsed = fc::time_point::now() - start;
+      wlog( "Benchmark: ${sps} undo sessions/s with ${n} modified objects each",
+            ("sps",(cycles*1000000)/elapsed.count())("n",objects_per_session) );
+   }
+
+   {
+      // latency of pushing a transaction, which opens, merges and undoes sessions for the pending state
+      transfer_operation op;
+      op.from = alice_id;
+      op.to = bob_id;
+      op.amount = asset( 1 );
+      op.fee = db.current_fee_schedule().calculate_fee( op );
+      fund( alice, asset( ( op.fee.amount + op.amount.amount ) * cycles ) );
+      trx.clear();
+      test::set_expiration( db, trx );
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < cycles; ++i )
+      {
+         trx.operations.clear();
+         trx.operations.push_back( op );
+         trx.ref_block_prefix = i; // distinct transaction ids
+         db.push_transaction( trx, ~0 );
+      }
+      auto elapsed = fc::time_point::now() - start;
+      wlog( "Benchmark: ${tps} pushed transfers/s, ${us}us average latency",
+            ("tps",(cycles*1000000)/elapsed.count())("us",elapsed.count()/cycles) );
+      trx.clear();
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( modify_dispatch_benchmark )
+{ try {
+   ACTORS( (alice) );
+   fund( alice, asset(1000000) );
+   const account_balance_object& balance = *db.get_index_type< primary_index< account_balance_index > >()
+         .get_secondary_index<balances_by_account_index>().get_account_balance( alice_id, asset_id_type() );
+   db._undo_db.disable(); // only measure the dispatch
+
+   const uint64_t cycles = 5000000;
+   {
+      // the modifier is wrapped in a std::function and passed through the virtual index::modify
+      graphene::db::index& idx = const_cast<graphene::db::index&>(
+            db.get_index( account_balance_object::space_id, account_balance_object::type_id ) );
+      auto start = fc::time_point::now();
+      for( uint64_t i = 0; i < cycles; ++i )
+         idx.modify( balance, [i]( account_balance_object& b ) { b.balance = share_type( i ); } );
+      auto elapsed = fc::time_point::now() - start;
+      wlog( "Benchmark: ${mps} modifications/s through the virtual index",
+            ("mps",(cycles*1000000)/elapsed.count()) );
+   }
+
+   {
+      // account_balance_object is mapped to its primary index, the modifier is inlined
+      auto start = fc::time_point::now();
+      for( uint64_t i = 0; i < cycles; ++i )
+         db.modify( balance, [i]( account_balance_object& b ) { b.balance = share_type( i ); } );
+      auto elapsed = fc::time_point::now() - start;
+      wlog( "Benchmark: ${mps} modifications/s through the statically dispatched index",
+            ("mps",(cycles*1000000)/elapsed.count()) );
+   }
+
+   db.modify( balance, []( account_balance_object& b ) { b.balance = 1000000; } );
+   db._undo_db.enable();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( vote_tally_benchmark )
+{ try {
+   generate_block();
+   const witness_object& witness = (*db.get_global_properties().active_witnesses.begin())(db);
+   const vote_id_type witness_vote = witness.vote_id;
+
+   const uint64_t voter_count = 1000000;
+   {
+      // synthetic voters are created directly, every fourth one delegates its vote to the first one
+      db._undo_db.disable();
+      auto start = fc::time_point::now();
+      const time_point_sec now = db.head_block_time();
+      account_id_type proxy;
+      for( uint64_t i = 0; i < voter_count; ++i )
+      {
+         const account_object& voter = db.create<account_object>( [&]( account_object& a ) {
+            a.name = "voter" + fc::to_string(i);
+            a.registrar = a.referrer = a.lifetime_referrer = GRAPHENE_COMMITTEE_ACCOUNT;
+            a.options.voting_account = ( i % 4 == 3 ) ? proxy : GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+            a.options.votes.insert( witness_vote );
+            a.options.num_witness = 1;
+            a.statistics = db.create<account_statistics_object>( [&a,i,now]( account_statistics_object& s ) {
+               s.owner = a.id;
+               s.name = a.name;
+               s.is_voting = true;
+               s.core_in_balance = 1000 + i % 1000;
+               s.last_vote_time = now;
+            }).id;
+         });
+         if( i == 0 )
+            proxy = voter.id;
+      }
+      db._undo_db.enable();
+      auto elapsed = fc::time_point::now() - start;
+      wlog( "Created ${n} voters in ${ms}ms", ("n",voter_count)("ms",elapsed.count()/1000) );
+   }
+
+   {
+      // the first block after the maintenance time tallies all votes
+      auto start = fc::time_point::now();
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      auto elapsed = fc::time_point::now() - start;
+      wlog( "Benchmark: maintenance with ${n} voters took ${ms}ms, ${vps} voters/s",
+            ("n",voter_count)("ms",elapsed.count()/1000)("vps",(voter_count*1000000)/elapsed.count()) );
+      BOOST_CHECK_GE( witness.total_votes, voter_count * 3 / 4 * 1000 );
+   }
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
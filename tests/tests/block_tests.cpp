@@ -25,6 +25,7 @@
  */
 
 #include <boost/test/unit_test.hpp>
+#include <boost/endian/conversion.hpp>
 
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/exceptions.hpp>
@@ -37,6 +38,7 @@
 #include <graphene/chain/hardfork.hpp>
 #include <graphene/chain/witness_schedule_object.hpp>
 #include <graphene/chain/witness_object.hpp>
+#include <graphene/chain/transaction_location_database.hpp>
 
 #include <graphene/utilities/tempdir.hpp>
 
@@ -135,6 +137,354 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_database_mapped_reads_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.enable_mapped_reads( true );
+      bdb.open( data_dir.path() );
+      FC_ASSERT( bdb.is_open() );
+
+      clearable_block b;
+      vector<block_id_type> ids;
+      for( uint32_t i = 0; i < 5; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+
+         // stored blocks are mapped right away
+         auto fetch = bdb.fetch_by_number( b.block_num() );
+         FC_ASSERT( fetch.valid() );
+         FC_ASSERT( fetch->witness == b.witness );
+         FC_ASSERT( bdb.contains( b.id() ) );
+      }
+
+      bdb.flush();
+      for( uint32_t i = 0; i < 5; ++i )
+      {
+         auto blk = bdb.fetch_by_number( i+1 );
+         FC_ASSERT( blk.valid() );
+         FC_ASSERT( blk->witness == witness_id_type(blk->block_num()) );
+         FC_ASSERT( bdb.fetch_block_id( i+1 ) == ids[i] );
+         blk = bdb.fetch_optional( ids[i] );
+         FC_ASSERT( blk.valid() );
+         FC_ASSERT( blk->id() == ids[i] );
+      }
+
+      // replace the head block as on a fork switch, the mapped index entry must not be stale
+      clearable_block fork_block;
+      fork_block.previous = b.previous;
+      fork_block.witness = witness_id_type(10);
+      bdb.store( fork_block.id(), fork_block );
+      FC_ASSERT( !bdb.contains( ids.back() ) );
+      FC_ASSERT( !bdb.fetch_optional( ids.back() ).valid() );
+      auto fetch = bdb.fetch_by_number( fork_block.block_num() );
+      FC_ASSERT( fetch.valid() );
+      FC_ASSERT( fetch->id() == fork_block.id() );
+
+      bdb.close();
+      FC_ASSERT( !bdb.is_open() );
+      bdb.open( data_dir.path() );
+      auto last = bdb.last();
+      FC_ASSERT( last );
+      FC_ASSERT( last->id() == fork_block.id() );
+
+      // removing the head block leaves the mapped index in place, the entry is only dropped on open
+      bdb.flush();
+      bdb.remove( fork_block.id() );
+      last = bdb.last();
+      FC_ASSERT( last );
+      FC_ASSERT( last->id() == ids[3] );
+      FC_ASSERT( bdb.fetch_by_number( 4 ).valid() );
+      bdb.close();
+      bdb.open( data_dir.path() );
+      last = bdb.last();
+      FC_ASSERT( last );
+      FC_ASSERT( last->id() == ids[3] );
+      FC_ASSERT( !bdb.fetch_by_number( fork_block.block_num() ).valid() );
+
+      // every store maps what it appended as a new segment, reads must also work across segment boundaries
+      b = clearable_block();
+      b.previous = ids[3];
+      ids.resize( 4 );
+      for( uint32_t i = 0; i < 100; ++i )
+      {
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+         b.previous = b.id();
+      }
+      for( uint32_t i = 0; i < ids.size(); ++i )
+      {
+         auto blk = bdb.fetch_by_number( i+1 );
+         FC_ASSERT( blk.valid() );
+         FC_ASSERT( blk->id() == ids[i] );
+      }
+      auto packed = bdb.fetch_packed_range( 1, 200 );
+      BOOST_REQUIRE_EQUAL( packed.size(), ids.size() );
+      for( uint32_t i = 0; i < packed.size(); ++i )
+         BOOST_CHECK( fc::raw::unpack<signed_block>( packed[i].data ).id() == ids[i] );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_header_index_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      clearable_block b;
+      for( uint32_t i = 0; i < 5; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.transactions.resize( i );
+         b.clear();
+         bdb.store( b.id(), b );
+
+         auto header = bdb.fetch_header_by_number( b.block_num() );
+         BOOST_REQUIRE( header.valid() );
+         BOOST_CHECK( header->header.id() == b.id() );
+         BOOST_CHECK( header->header.witness == b.witness );
+         BOOST_CHECK_EQUAL( header->transaction_count, i );
+      }
+      BOOST_CHECK( !bdb.fetch_header_by_number( 6 ).valid() );
+      bdb.close();
+
+      // the header index is rebuilt from the blocks if it is missing
+      fc::remove( data_dir.path() / "header_index" );
+      fc::remove( data_dir.path() / "headers" );
+      bdb.open( data_dir.path() );
+      for( uint32_t i = 0; i < 5; ++i )
+      {
+         auto header = bdb.fetch_header_by_number( i+1 );
+         BOOST_REQUIRE( header.valid() );
+         BOOST_CHECK( header->header.witness == witness_id_type(i+1) );
+         BOOST_CHECK_EQUAL( header->transaction_count, i );
+      }
+      BOOST_CHECK( fc::exists( data_dir.path() / "header_index" ) );
+      bdb.close();
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_chunked_format_test )
+{
+   try {
+      fc::temp_directory raw_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory chunked_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory back_dir( graphene::utilities::temp_directory_path() );
+
+      vector<block_id_type> ids;
+      clearable_block b;
+      {
+         block_database bdb;
+         bdb.open( raw_dir.path() );
+         BOOST_CHECK( bdb.format() == block_log_format::raw );
+         for( uint32_t i = 0; i < 10; ++i )
+         {
+            if( i > 0 ) b.previous = b.id();
+            b.witness = witness_id_type(i+1);
+            b.clear();
+            bdb.store( b.id(), b );
+            ids.push_back( b.id() );
+         }
+         bdb.close();
+      }
+
+      block_database::convert( raw_dir.path(), chunked_dir.path(), block_log_format::chunked, 4 );
+
+      for( bool mapped : { false, true } )
+      {
+         block_database bdb;
+         bdb.enable_mapped_reads( mapped );
+         bdb.open( chunked_dir.path() );
+         BOOST_CHECK( bdb.format() == block_log_format::chunked );
+         for( uint32_t i = 0; i < 10; ++i )
+         {
+            auto blk = bdb.fetch_by_number( i+1 );
+            BOOST_REQUIRE( blk.valid() );
+            BOOST_CHECK( blk->id() == ids[i] );
+            BOOST_CHECK( blk->witness == witness_id_type(i+1) );
+            BOOST_CHECK( bdb.contains( ids[i] ) );
+            BOOST_CHECK( bdb.fetch_optional( ids[i] ).valid() );
+         }
+         auto last = bdb.last();
+         BOOST_REQUIRE( last.valid() );
+         BOOST_CHECK( last->id() == ids.back() );
+         bdb.close();
+      }
+
+      // blocks stored after conversion are appended uncompressed
+      {
+         block_database bdb;
+         bdb.open( chunked_dir.path() );
+         b.previous = b.id();
+         b.witness = witness_id_type(11);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+         auto blk = bdb.fetch_by_number( 11 );
+         BOOST_REQUIRE( blk.valid() );
+         BOOST_CHECK( blk->id() == b.id() );
+         bdb.close();
+      }
+
+      block_database::convert( chunked_dir.path(), back_dir.path(), block_log_format::raw );
+      {
+         block_database bdb;
+         bdb.open( back_dir.path() );
+         BOOST_CHECK( bdb.format() == block_log_format::raw );
+         for( uint32_t i = 0; i < 11; ++i )
+         {
+            auto blk = bdb.fetch_by_number( i+1 );
+            BOOST_REQUIRE( blk.valid() );
+            BOOST_CHECK( blk->id() == ids[i] );
+         }
+         bdb.close();
+      }
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_packed_range_test )
+{
+   try {
+      fc::temp_directory raw_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory chunked_dir( graphene::utilities::temp_directory_path() );
+
+      vector<block_id_type> ids;
+      clearable_block b;
+      {
+         block_database bdb;
+         bdb.open( raw_dir.path() );
+         for( uint32_t i = 0; i < 10; ++i )
+         {
+            if( i > 0 ) b.previous = b.id();
+            b.witness = witness_id_type(i+1);
+            b.clear();
+            bdb.store( b.id(), b );
+            ids.push_back( b.id() );
+         }
+         bdb.close();
+      }
+      block_database::convert( raw_dir.path(), chunked_dir.path(), block_log_format::chunked, 4 );
+
+      for( const auto& dir : { raw_dir.path(), chunked_dir.path() } )
+      {
+         for( bool mapped : { false, true } )
+         {
+            block_database bdb;
+            bdb.enable_mapped_reads( mapped );
+            bdb.open( dir );
+
+            auto range = bdb.fetch_packed_range( 1, 10 );
+            BOOST_REQUIRE_EQUAL( range.size(), 10u );
+            for( uint32_t i = 0; i < 10; ++i )
+            {
+               BOOST_CHECK_EQUAL( range[i].block_num, i+1 );
+               BOOST_CHECK( range[i].block_id == ids[i] );
+               auto blk = fc::raw::unpack<signed_block>( range[i].data );
+               BOOST_CHECK( blk.id() == ids[i] );
+            }
+
+            // stops at the end of the log
+            range = bdb.fetch_packed_range( 6, 100 );
+            BOOST_REQUIRE_EQUAL( range.size(), 5u );
+            BOOST_CHECK( range.front().block_id == ids[5] );
+            BOOST_CHECK( range.back().block_id == ids[9] );
+            BOOST_CHECK( bdb.fetch_packed_range( 11, 10 ).empty() );
+            bdb.close();
+         }
+      }
+
+      // stops at a missing block
+      {
+         block_database bdb;
+         bdb.open( raw_dir.path() );
+         b.previous = ids.back();
+         b.clear();
+         b.previous._hash[0] = boost::endian::endian_reverse( uint32_t(12) ); // block 13, 11 and 12 are missing
+         bdb.store( b.id(), b );
+         BOOST_CHECK_EQUAL( bdb.fetch_packed_range( 9, 10 ).size(), 2u );
+         bdb.close();
+      }
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( transaction_location_database_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto make_id = []( uint32_t n ) { return transaction_id_type::hash( (const char*)&n, sizeof(n) ); };
+
+      // enough transactions to make the table grow at least once
+      const uint32_t count = 800000;
+      {
+         transaction_location_database tldb;
+         tldb.open( data_dir.path() );
+         BOOST_CHECK_EQUAL( tldb.size(), 0u );
+         BOOST_CHECK_EQUAL( tldb.head_block_num(), 0u );
+         BOOST_CHECK( !tldb.find( make_id(0) ).valid() );
+
+         for( uint32_t n = 0; n < count; ++n )
+            tldb.store( make_id(n), { n / 100 + 1, n % 100 } );
+         tldb.set_head_block_num( count / 100 );
+         BOOST_CHECK_EQUAL( tldb.size(), count );
+
+         // a transaction that is included again overwrites its location
+         tldb.store( make_id(5), { 12345, 6 } );
+         BOOST_CHECK_EQUAL( tldb.size(), count );
+         tldb.close();
+      }
+
+      transaction_location_database tldb;
+      tldb.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( tldb.size(), count );
+      BOOST_CHECK_EQUAL( tldb.head_block_num(), count / 100 );
+      for( uint32_t n = 0; n < count; n += 997 )
+      {
+         if( n == 5 ) continue;
+         auto location = tldb.find( make_id(n) );
+         BOOST_REQUIRE( location.valid() );
+         BOOST_CHECK_EQUAL( location->block_num, n / 100 + 1 );
+         BOOST_CHECK_EQUAL( location->trx_in_block, n % 100 );
+      }
+      auto location = tldb.find( make_id(5) );
+      BOOST_REQUIRE( location.valid() );
+      BOOST_CHECK_EQUAL( location->block_num, 12345u );
+      BOOST_CHECK_EQUAL( location->trx_in_block, 6u );
+      BOOST_CHECK( !tldb.find( make_id(count) ).valid() );
+      tldb.close();
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -242,6 +592,102 @@ BOOST_AUTO_TEST_CASE( undo_block )
    }
 }
 
+BOOST_AUTO_TEST_CASE( restart_after_crash_from_checkpoint )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      vector< block_id_type > block_ids;
+      {
+         database db;
+         db.set_object_db_checkpoint_interval( 5 );
+         db.open(data_dir.path(), make_genesis, "TEST");
+         for( uint32_t i = 0; i < 10; ++i )
+         {
+            auto b = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                        database::skip_nothing );
+            block_ids.push_back( b.id() );
+         }
+         BOOST_CHECK( fc::exists( data_dir.path() / "object_database" / "undo" ) );
+         // the database is not closed, as if the node crashed right after the last checkpoint
+      }
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis, "TEST");
+         BOOST_REQUIRE_EQUAL( db.head_block_num(), 10u );
+         BOOST_CHECK( db.head_block_id() == block_ids.back() );
+
+         // the undo history and the fork database of the reversible blocks have been restored
+         const uint32_t cutoff = std::max( 1u, db.get_dynamic_global_properties().last_irreversible_block_num );
+         BOOST_REQUIRE_LT( cutoff, 10u );
+         while( db.head_block_num() > cutoff )
+         {
+            db.pop_block();
+            BOOST_CHECK( db.head_block_id() == block_ids[ db.head_block_num() - 1 ] );
+         }
+         auto b = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                     database::skip_nothing );
+         BOOST_CHECK_EQUAL( db.head_block_num(), cutoff + 1 );
+         BOOST_CHECK( db.head_block_id() == b.id() );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( restart_after_fork_switch_past_checkpoint )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      vector< block_id_type > block_ids;
+      {
+         database db;
+         db.set_object_db_checkpoint_interval( 5 );
+         db.open(data_dir.path(), make_genesis, "TEST");
+         for( uint32_t i = 0; i < 10; ++i )
+         {
+            auto b = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                        database::skip_nothing );
+            block_ids.push_back( b.id() );
+         }
+         BOOST_REQUIRE_LT( db.get_dynamic_global_properties().last_irreversible_block_num, 8u );
+
+         // switch to a longer fork which replaces the saved head block and its parent in the block log
+         db.set_object_db_checkpoint_interval( 0 );
+         db.pop_block();
+         db.pop_block();
+         block_ids.resize( 8 );
+         for( uint32_t i = 0; i < 3; ++i )
+         {
+            const uint32_t slot = ( i == 0 ? 2 : 1 );
+            auto b = db.generate_block( db.get_slot_time(slot), db.get_scheduled_witness(slot), init_account_priv_key,
+                                        database::skip_nothing );
+            block_ids.push_back( b.id() );
+         }
+         BOOST_REQUIRE_EQUAL( db.head_block_num(), 11u );
+         // the database is not closed, as if the node crashed before the next checkpoint
+      }
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis, "TEST");
+         BOOST_REQUIRE_EQUAL( db.head_block_num(), 11u );
+         BOOST_CHECK( db.head_block_id() == block_ids.back() );
+         for( uint32_t num = 1; num <= 11; ++num )
+            BOOST_CHECK( db.get_block_id_for_num( num ) == block_ids[ num - 1 ] );
+
+         auto b = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                     database::skip_nothing );
+         BOOST_CHECK_EQUAL( db.head_block_num(), 12u );
+         BOOST_CHECK( db.head_block_id() == b.id() );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( change_signing_key_test )
 {
    try {
@@ -690,6 +1136,69 @@ BOOST_AUTO_TEST_CASE( switch_forks_undo_create )
    }
 }
 
+BOOST_AUTO_TEST_CASE( pending_authority_recheck )
+{
+   try {
+      fc::temp_directory dir1( graphene::utilities::temp_directory_path() ),
+                         dir2( graphene::utilities::temp_directory_path() );
+      database db1,
+               db2;
+      db1.open(dir1.path(), make_genesis, "TEST");
+      db2.open(dir2.path(), make_genesis, "TEST");
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      auto new_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("new_key")) );
+      const auto& accounts_by_name = db1.get_index_type<account_index>().indices().get<by_name>();
+      const account_id_type init1_id = accounts_by_name.find( "init1" )->id;
+      const account_id_type init2_id = accounts_by_name.find( "init2" )->id;
+      const public_key_type old_memo_key = init1_id(db1).options.memo_key;
+
+      auto b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      PUSH_BLOCK( db2, b );
+
+      // pending transactions of init1 and init2 on db1, signed with their current keys
+      auto change_memo_key = [&]( account_id_type account ) {
+         signed_transaction trx;
+         set_expiration( db1, trx );
+         account_update_operation uop;
+         uop.account = account;
+         uop.new_options = account(db1).options;
+         uop.new_options->memo_key = new_key.get_public_key();
+         trx.operations.push_back( uop );
+         trx.sign( init_account_priv_key, db1.get_chain_id() );
+         PUSH_TX( db1, trx );
+      };
+      change_memo_key( init1_id );
+      change_memo_key( init2_id );
+      BOOST_CHECK( init1_id(db1).options.memo_key == new_key.get_public_key() );
+      BOOST_CHECK( init2_id(db1).options.memo_key == new_key.get_public_key() );
+
+      // db2 produces a block which replaces the keys of init1
+      {
+         signed_transaction trx;
+         set_expiration( db2, trx );
+         account_update_operation uop;
+         uop.account = init1_id;
+         uop.owner = authority( 1, public_key_type( new_key.get_public_key() ), 1 );
+         uop.active = uop.owner;
+         trx.operations.push_back( uop );
+         trx.sign( init_account_priv_key, db2.get_chain_id() );
+         PUSH_TX( db2, trx );
+      }
+      b = db2.generate_block(db2.get_slot_time(1), db2.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      PUSH_BLOCK( db1, b );
+
+      // the authority of the pending transaction of init1 is checked again and fails,
+      // the one of init2 does not depend on init1 and is kept
+      BOOST_CHECK( init1_id(db1).active == authority( 1, public_key_type( new_key.get_public_key() ), 1 ) );
+      BOOST_CHECK( init1_id(db1).options.memo_key == old_memo_key );
+      BOOST_CHECK( init2_id(db1).options.memo_key == new_key.get_public_key() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( duplicate_transactions )
 {
    try {
@@ -1874,4 +2383,136 @@ BOOST_FIXTURE_TEST_CASE( block_size_test, database_fixture )
    }
 }
 
+/// Keys recovered while a transaction is pending are reused when the same transaction arrives again in a block
+BOOST_FIXTURE_TEST_CASE( signature_cache_test, database_fixture )
+{
+   try
+   {
+      ACTORS((alice)(bob));
+      transfer(committee_account, alice_id, asset(10000));
+      generate_block();
+
+      signed_transaction xfer_tx;
+      transfer_operation xfer_op;
+      xfer_op.from = alice_id;
+      xfer_op.to = bob_id;
+      xfer_op.amount = asset(1000);
+      xfer_tx.operations.push_back( xfer_op );
+      set_expiration( db, xfer_tx );
+      sign( xfer_tx, alice_private_key );
+
+      const signature_cache& cache = db.get_signature_cache();
+      const uint64_t hits = cache.hits();
+      const uint64_t misses = cache.misses();
+
+      BOOST_TEST_MESSAGE( "Receive the transaction, its key is recovered once" );
+      precomputable_transaction pending_tx( xfer_tx );
+      db.precompute_parallel( pending_tx ).wait();
+      BOOST_CHECK_EQUAL( cache.hits(), hits );
+      BOOST_CHECK_EQUAL( cache.misses(), misses + 1 );
+      const auto& keys = pending_tx.get_signature_keys( db.get_chain_id() );
+      BOOST_REQUIRE_EQUAL( keys.size(), 1u );
+      BOOST_CHECK( *keys.begin() == public_key_type( alice_private_key.get_public_key() ) );
+      db.push_transaction( pending_tx, database::skip_nothing );
+
+      BOOST_TEST_MESSAGE( "Receive the transaction again inside a block" );
+      signed_block b = generate_block();
+      BOOST_REQUIRE_EQUAL( b.transactions.size(), 1u );
+      db.pop_block();
+      auto received = fc::raw::unpack<signed_block>( fc::raw::pack( b ) );
+      db.precompute_parallel( received ).wait();
+      BOOST_CHECK_EQUAL( cache.hits(), hits + 1 );
+      BOOST_CHECK_EQUAL( cache.misses(), misses + 1 );
+      BOOST_CHECK( received.transactions[0].get_signature_keys( db.get_chain_id() ) == keys );
+      PUSH_BLOCK( db, received );
+      BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 1000 );
+
+      BOOST_TEST_MESSAGE( "Duplicate signatures are still rejected" );
+      precomputable_transaction dup_tx( xfer_tx );
+      dup_tx.signatures.push_back( dup_tx.signatures.front() );
+      GRAPHENE_CHECK_THROW( db.precompute_parallel( dup_tx ).wait(), tx_duplicate_sig );
+
+      BOOST_TEST_MESSAGE( "The cache stays within its bounds" );
+      signature_cache small_cache( 4 );
+      for( int i = 0; i < 10; ++i )
+      {
+         signed_transaction tx = xfer_tx;
+         tx.operations.front().get<transfer_operation>().amount = asset( i + 1 );
+         tx.clear_signatures();
+         sign( tx, alice_private_key );
+         tx.get_signature_keys( db.get_chain_id(), small_cache );
+         BOOST_CHECK_LE( small_cache.size(), 4u );
+      }
+      BOOST_CHECK_EQUAL( small_cache.misses(), 10u );
+      small_cache.set_max_entries( 0 );
+      xfer_tx.get_signature_keys( db.get_chain_id(), small_cache );
+      BOOST_CHECK_EQUAL( small_cache.size(), 0u );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+/// Batches of transactions are precomputed together, and an invalid one does not hide the others
+BOOST_FIXTURE_TEST_CASE( precompute_batch_test, database_fixture )
+{
+   try
+   {
+      ACTORS((alice)(bob));
+      transfer(committee_account, alice_id, asset(100000));
+      generate_block();
+
+      std::vector<signed_transaction> txs;
+      std::vector<precomputable_transaction> batch;
+      for( int i = 0; i < 20; ++i )
+      {
+         signed_transaction tx;
+         transfer_operation xfer_op;
+         xfer_op.from = alice_id;
+         xfer_op.to = bob_id;
+         xfer_op.amount = asset( i + 1 );
+         tx.operations.push_back( xfer_op );
+         set_expiration( db, tx );
+         sign( tx, alice_private_key );
+         txs.push_back( tx );
+         batch.emplace_back( tx );
+      }
+
+      BOOST_TEST_MESSAGE( "Precompute a valid batch" );
+      db.precompute_batch( batch.data(), batch.size() );
+      const public_key_type alice_key( alice_private_key.get_public_key() );
+      for( const auto& tx : batch )
+      {
+         const auto& keys = tx.get_signature_keys( db.get_chain_id() );
+         BOOST_REQUIRE_EQUAL( keys.size(), 1u );
+         BOOST_CHECK( *keys.begin() == alice_key );
+      }
+
+      BOOST_TEST_MESSAGE( "Precompute a batch with an invalid transaction" );
+      std::vector<precomputable_transaction> bad_batch;
+      for( const auto& tx : txs )
+         bad_batch.emplace_back( tx );
+      bad_batch[10].signatures.push_back( bad_batch[10].signatures.front() );
+      GRAPHENE_CHECK_THROW( db.precompute_batch( bad_batch.data(), bad_batch.size() ), tx_duplicate_sig );
+
+      BOOST_TEST_MESSAGE( "Push the valid transactions in order" );
+      for( size_t i = 0; i < bad_batch.size(); ++i )
+      {
+         if( i == 10 )
+            GRAPHENE_CHECK_THROW( db.push_transaction( bad_batch[i] ), tx_duplicate_sig );
+         else
+            db.push_transaction( bad_batch[i] );
+      }
+      generate_block();
+      BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 210 - 11 );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
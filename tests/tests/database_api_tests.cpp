@@ -1327,4 +1327,35 @@ BOOST_AUTO_TEST_CASE( verify_authority_multiple_accounts )
    }
 }
 
+BOOST_AUTO_TEST_CASE( get_transaction_by_id )
+{ try {
+   ACTORS( (alice) );
+   generate_block();
+
+   graphene::app::database_api db_api( db, &( app.get_options() ) );
+
+   const auto block = db.fetch_block_by_number( db.head_block_num() );
+   BOOST_REQUIRE( block.valid() );
+   BOOST_REQUIRE( !block->transactions.empty() );
+   const auto trx_id = block->transactions.back().id();
+   const uint32_t trx_in_block = block->transactions.size() - 1;
+
+   auto result = db_api.get_transaction_by_id( trx_id );
+   BOOST_REQUIRE( result.valid() );
+   BOOST_CHECK_EQUAL( result->block_num, db.head_block_num() );
+   BOOST_CHECK_EQUAL( result->trx_in_block, trx_in_block );
+   BOOST_CHECK( result->trx.id() == trx_id );
+
+   // still found after the transaction expired from the recent transaction index
+   generate_blocks( block->transactions.back().expiration + fc::seconds(60) );
+   generate_block();
+   BOOST_CHECK( !db_api.get_recent_transaction_by_id( trx_id ).valid() );
+   result = db_api.get_transaction_by_id( trx_id );
+   BOOST_REQUIRE( result.valid() );
+   BOOST_CHECK_EQUAL( result->block_num, block->block_num() );
+   BOOST_CHECK_EQUAL( result->trx_in_block, trx_in_block );
+
+   BOOST_CHECK( !db_api.get_transaction_by_id( transaction_id_type() ).valid() );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -30,7 +30,14 @@
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 
+#include <graphene/snapshot/snapshot.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
 #include <fc/crypto/digest.hpp>
+#include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+
+#include <sstream>
 
 #include "../common/database_fixture.hpp"
 
@@ -109,6 +116,75 @@ BOOST_AUTO_TEST_CASE( merge_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( undo_id_table_test )
+{ try {
+   graphene::db::undo_memory_pool pool;
+   graphene::db::undo_arena arena( pool );
+   // sized for fewer entries than added, so that the table grows
+   graphene::db::undo_id_table<object_id_type> table( arena, 4 );
+   graphene::db::undo_id_table<void> ids( arena, 4 );
+   for( uint64_t i = 0; i < 1000; ++i )
+   {
+      BOOST_CHECK( table.insert( object_id_type( 1, 2, i ) ).second );
+      table.find( object_id_type( 1, 2, i ) )->second = object_id_type( 1, 3, i );
+      ids.insert( object_id_type( 1, 2, i ) );
+   }
+   BOOST_CHECK( !table.insert( object_id_type( 1, 2, 7 ) ).second );
+   BOOST_CHECK_EQUAL( table.size(), 1000u );
+
+   // erasing moves the entries of the same probe sequence back, they must still be found
+   for( uint64_t i = 0; i < 1000; i += 3 )
+   {
+      BOOST_CHECK_EQUAL( table.erase( object_id_type( 1, 2, i ) ), 1u );
+      BOOST_CHECK_EQUAL( ids.erase( object_id_type( 1, 2, i ) ), 1u );
+   }
+   BOOST_CHECK_EQUAL( table.erase( object_id_type( 1, 2, 0 ) ), 0u );
+   for( uint64_t i = 0; i < 1000; ++i )
+   {
+      auto itr = table.find( object_id_type( 1, 2, i ) );
+      BOOST_CHECK_EQUAL( itr != table.end(), i % 3 != 0 );
+      if( itr != table.end() )
+         BOOST_CHECK( itr->second == object_id_type( 1, 3, i ) );
+      BOOST_CHECK_EQUAL( ids.count( object_id_type( 1, 2, i ) ), i % 3 != 0 ? 1u : 0u );
+   }
+   size_t count = 0;
+   for( const object_id_type& id : ids )
+   {
+      BOOST_CHECK( id.instance() % 3 != 0 );
+      ++count;
+   }
+   BOOST_CHECK_EQUAL( count, 666u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( nested_merge_undo_test )
+{ try {
+   database db;
+   const auto& kept = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 1; });
+   const auto& changed = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 2; });
+   const auto& removed = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 3; });
+   const account_balance_id_type kept_id = kept.id;
+   const account_balance_id_type changed_id = changed.id;
+   const account_balance_id_type removed_id = removed.id;
+
+   auto outer = db._undo_db.start_undo_session( true );
+   db.modify( kept, []( account_balance_object& obj ){ obj.balance = 10; });
+   {
+      auto inner = db._undo_db.start_undo_session();
+      db.modify( kept, []( account_balance_object& obj ){ obj.balance = 11; });
+      db.modify( changed, []( account_balance_object& obj ){ obj.balance = 20; });
+      db.remove( removed );
+      db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 4; });
+      inner.merge();
+   }
+   // the saved objects taken over from the merged state outlive its memory
+   outer.undo();
+   BOOST_CHECK_EQUAL( kept_id(db).balance.value, 1 );
+   BOOST_CHECK_EQUAL( changed_id(db).balance.value, 2 );
+   BOOST_REQUIRE( db.find( removed_id ) );
+   BOOST_CHECK_EQUAL( removed_id(db).balance.value, 3 );
+   BOOST_CHECK( !db.find( account_balance_id_type( removed_id.instance.value + 1 ) ) );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( direct_index_test )
 { try {
    try {
@@ -281,4 +357,191 @@ BOOST_AUTO_TEST_CASE( required_approval_index_test ) // see https://github.com/b
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( incremental_checkpoint_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const fc::path dir = data_dir.path() / "object_database";
+      auto create_balance = []( database& db, int64_t amount ) {
+         return db.create<account_balance_object>( [amount]( account_balance_object& obj ){
+            obj.balance = amount;
+         }).id;
+      };
+
+      account_balance_id_type kept_id, modified_id, removed_id, created_id;
+      {
+         database db;
+         db.enable_incremental_checkpoints( true, 3 );
+         db.object_database::open( data_dir.path() );
+         kept_id = create_balance( db, 1 );
+         modified_id = create_balance( db, 2 );
+         removed_id = create_balance( db, 3 );
+
+         // there is no snapshot yet, so a full one is written
+         db.checkpoint();
+         BOOST_CHECK( fc::exists( dir ) );
+         BOOST_CHECK( !fc::exists( dir / "delta.1" ) );
+
+         db.modify( modified_id(db), []( account_balance_object& obj ){ obj.balance = 20; } );
+         db.remove( removed_id(db) );
+         created_id = create_balance( db, 4 );
+         {
+            // undone changes must not show up in the delta
+            auto session = db._undo_db.start_undo_session();
+            db.modify( kept_id(db), []( account_balance_object& obj ){ obj.balance = 100; } );
+         }
+         db.checkpoint();
+         BOOST_CHECK( fc::exists( dir / "delta.1" ) );
+      }
+      {
+         database db;
+         db.enable_incremental_checkpoints( true, 3 );
+         db.object_database::open( data_dir.path() );
+         BOOST_CHECK_EQUAL( kept_id(db).balance.value, 1 );
+         BOOST_CHECK_EQUAL( modified_id(db).balance.value, 20 );
+         BOOST_CHECK( db.find( removed_id ) == nullptr );
+         BOOST_CHECK_EQUAL( created_id(db).balance.value, 4 );
+         BOOST_CHECK( db.get_index_type<account_balance_index>().get_next_id() == object_id_type( created_id ) + 1 );
+
+         // the fourth checkpoint compacts the deltas into a new snapshot
+         for( int64_t i = 2; i <= 4; ++i )
+         {
+            db.modify( kept_id(db), [i]( account_balance_object& obj ){ obj.balance = i; } );
+            db.checkpoint();
+            BOOST_CHECK_EQUAL( fc::exists( dir / ( "delta." + fc::to_string(i) ) ), i <= 3 );
+         }
+         BOOST_CHECK( !fc::exists( dir / "delta.1" ) );
+      }
+      {
+         database db;
+         db.object_database::open( data_dir.path() );
+         BOOST_CHECK_EQUAL( kept_id(db).balance.value, 4 );
+         BOOST_CHECK_EQUAL( modified_id(db).balance.value, 20 );
+         BOOST_CHECK( db.find( removed_id ) == nullptr );
+      }
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( changed_objects_limit_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto create_balance = []( database& db ) {
+         return db.create<account_balance_object>( []( account_balance_object& obj ){
+            obj.balance = 1;
+         }).id;
+      };
+
+      database db;
+      db.enable_incremental_checkpoints( true, 3 );
+      db.set_max_changed_objects( 2 );
+      db.object_database::open( data_dir.path() );
+
+      const account_balance_id_type first_id = create_balance( db );
+      create_balance( db );
+      // an object is counted once no matter how often it changes
+      db.modify( first_id(db), []( account_balance_object& obj ){ obj.balance = 2; } );
+      BOOST_CHECK( !db.checkpoint_due() );
+      create_balance( db );
+      BOOST_CHECK( db.checkpoint_due() );
+
+      // both a full save and a delta reset the count
+      db.checkpoint();
+      BOOST_CHECK( !db.checkpoint_due() );
+      for( int i = 0; i < 3; ++i )
+         db.modify( create_balance( db )(db), []( account_balance_object& obj ){ obj.balance = 3; } );
+      BOOST_CHECK( db.checkpoint_due() );
+      db.checkpoint();
+      BOOST_CHECK( fc::exists( data_dir.path() / "object_database" / "delta.1" ) );
+      BOOST_CHECK( !db.checkpoint_due() );
+
+      db.set_max_changed_objects( 0 );
+      for( int i = 0; i < 3; ++i )
+         create_balance( db );
+      BOOST_CHECK( !db.checkpoint_due() );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( snapshot_shards )
+{ try {
+   using graphene::snapshot_plugin::snapshot_manifest;
+
+   // the fixture writes a JSON snapshot at block 3
+   ACTORS( (alice) );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   generate_block();
+   const block_id_type snapshot_block_id = db.head_block_id();
+   BOOST_REQUIRE_EQUAL( db.head_block_num(), 3u );
+   object_id_type alice_balance_id;
+   for( const auto& balance : db.get_index_type<account_balance_index>().indices() )
+      if( balance.owner == alice_id && balance.asset_type == asset_id_type() )
+         alice_balance_id = balance.id;
+   const share_type alice_balance = db.get_balance( alice_id, asset_id_type() ).amount;
+
+   // the snapshot is written in the background while more blocks change the state
+   const fc::path dir = data_dir.path() / "snapshot";
+   BOOST_CHECK( !fc::exists( dir / "manifest.json" ) );
+   transfer( committee_account, alice_id, asset( 500 ) );
+   ACTORS( (bob) );
+   generate_block();
+   BOOST_CHECK( !fc::exists( dir / "manifest.json" ) );
+   for( int i = 0; i < 1000 && !fc::exists( dir / "manifest.json" ); ++i )
+   {
+      fc::usleep( fc::milliseconds( 10 ) );
+      generate_block();
+   }
+   BOOST_TEST_MESSAGE( "Snapshot written while applying blocks up to " + fc::to_string( db.head_block_num() ) );
+   BOOST_REQUIRE( fc::exists( dir / "manifest.json" ) );
+   const auto manifest = fc::json::from_file( dir / "manifest.json" ).as<snapshot_manifest>( 10 );
+   BOOST_CHECK_EQUAL( manifest.block_num, 3u );
+   BOOST_CHECK( manifest.block_id == snapshot_block_id );
+   BOOST_CHECK_EQUAL( manifest.format, "json" );
+   BOOST_REQUIRE( !manifest.shards.empty() );
+
+   bool found_alice = false;
+   bool found_alice_balance = false;
+   for( const auto& shard : manifest.shards )
+   {
+      BOOST_TEST_MESSAGE( "Checking shard " + shard.file );
+      BOOST_REQUIRE( fc::exists( dir / shard.file ) );
+      std::string contents;
+      fc::read_file_contents( dir / shard.file, contents );
+      BOOST_CHECK_EQUAL( contents.size(), shard.size );
+      BOOST_CHECK( fc::sha256::hash( contents ) == shard.hash );
+
+      std::istringstream lines( contents );
+      std::string line;
+      uint64_t objects = 0;
+      while( std::getline( lines, line ) )
+      {
+         const fc::variant_object obj = fc::json::from_string( line ).get_object();
+         const object_id_type id = obj["id"].as<object_id_type>( 1 );
+         BOOST_CHECK_EQUAL( id.space(), shard.space_id );
+         BOOST_CHECK_EQUAL( id.type(), shard.type_id );
+         found_alice = found_alice || id == object_id_type( alice_id );
+         // objects have their state of the snapshot block
+         BOOST_CHECK( id != object_id_type( bob_id ) );
+         if( id == alice_balance_id )
+         {
+            BOOST_CHECK_EQUAL( obj["balance"].as<share_type>( 1 ).value, alice_balance.value );
+            found_alice_balance = true;
+         }
+         ++objects;
+      }
+      BOOST_CHECK_EQUAL( objects, shard.objects );
+      BOOST_CHECK( db.find_index( shard.space_id, shard.type_id ) != nullptr );
+   }
+   BOOST_CHECK( found_alice );
+   BOOST_CHECK( found_alice_balance );
+   BOOST_CHECK( db.get_balance( alice_id, asset_id_type() ).amount > alice_balance );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -27,6 +27,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <graphene/app/api.hpp>
+#include <graphene/account_history/operation_history_store.hpp>
 
 #include <graphene/utilities/tempdir.hpp>
 
@@ -84,4 +85,287 @@ BOOST_AUTO_TEST_CASE(get_account_history) {
    }
 }
 
+BOOST_AUTO_TEST_CASE(get_account_history_operations) {
+   try {
+      graphene::app::history_api hist_api(app);
+
+      const account_object& dan = create_account("dan");
+      const account_object& bob = create_account("bob");
+      fund( dan, asset(1000000) );
+      for( int i = 0; i < 5; ++i )
+         transfer( dan, bob, asset(100 + i) );
+
+      generate_block();
+      fc::usleep(fc::milliseconds(2000));
+
+      int asset_create_op_id = operation::tag<asset_create_operation>::value;
+      int account_create_op_id = operation::tag<account_create_operation>::value;
+      int transfer_op_id = operation::tag<transfer_operation>::value;
+
+      // dan received 1 transfer and sent 5, newest first
+      vector<operation_history_object> transfers = hist_api.get_account_history_operations(
+            "dan", transfer_op_id, operation_history_id_type(), operation_history_id_type(), 100);
+      BOOST_REQUIRE_EQUAL(transfers.size(), 6u);
+      for( size_t i = 0; i < transfers.size(); ++i )
+      {
+         BOOST_CHECK_EQUAL(transfers[i].op.which(), transfer_op_id);
+         if( i > 0 )
+            BOOST_CHECK(transfers[i].id.instance() < transfers[i-1].id.instance());
+      }
+
+      vector<operation_history_object> histories = hist_api.get_account_history_operations(
+            "dan", account_create_op_id, operation_history_id_type(), operation_history_id_type(), 100);
+      BOOST_CHECK_EQUAL(histories.size(), 1u);
+
+      histories = hist_api.get_account_history_operations(
+            "dan", asset_create_op_id, operation_history_id_type(), operation_history_id_type(), 100);
+      BOOST_CHECK_EQUAL(histories.size(), 0u);
+
+      // limit 2 returns the 2 newest
+      histories = hist_api.get_account_history_operations(
+            "dan", transfer_op_id, operation_history_id_type(), operation_history_id_type(), 2);
+      BOOST_REQUIRE_EQUAL(histories.size(), 2u);
+      BOOST_CHECK(histories[0].id == transfers[0].id);
+      BOOST_CHECK(histories[1].id == transfers[1].id);
+
+      // start is inclusive
+      histories = hist_api.get_account_history_operations(
+            "dan", transfer_op_id, transfers[2].id, operation_history_id_type(), 100);
+      BOOST_REQUIRE_EQUAL(histories.size(), 4u);
+      BOOST_CHECK(histories[0].id == transfers[2].id);
+
+      // stop is exclusive
+      histories = hist_api.get_account_history_operations(
+            "dan", transfer_op_id, operation_history_id_type(), transfers[3].id, 100);
+      BOOST_REQUIRE_EQUAL(histories.size(), 3u);
+      BOOST_CHECK(histories[2].id == transfers[2].id);
+
+      // bob only received transfers
+      histories = hist_api.get_account_history_operations(
+            "bob", transfer_op_id, operation_history_id_type(), operation_history_id_type(), 100);
+      BOOST_CHECK_EQUAL(histories.size(), 5u);
+
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(operation_history_store_test) {
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      graphene::account_history::operation_history_store store;
+      store.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( store.size(), 0u );
+      BOOST_CHECK_EQUAL( store.head_block_num(), 0u );
+
+      const account_id_type alice( 10 );
+      const account_id_type bob( 11 );
+      auto make_op = []( uint32_t block_num, int64_t amount ) {
+         transfer_operation transfer;
+         transfer.amount = asset( amount );
+         operation_history_object oho( transfer );
+         oho.block_num = block_num;
+         return oho;
+      };
+      // blocks 1 to 3, alice is impacted by all operations, bob by every second
+      for( uint32_t i = 0; i < 6; ++i )
+      {
+         flat_set<account_id_type> accounts{ alice };
+         if( i % 2 == 0 )
+            accounts.insert( bob );
+         BOOST_CHECK( store.append( make_op( 1 + i / 2, i ), accounts ) == operation_history_id_type( i ) );
+      }
+      account_create_operation create;
+      flat_set<account_id_type> only_bob{ bob };
+      operation_history_object create_oho( create );
+      create_oho.block_num = 4;
+      store.append( create_oho, only_bob );
+
+      BOOST_CHECK_EQUAL( store.size(), 7u );
+      BOOST_CHECK_EQUAL( store.head_block_num(), 4u );
+      BOOST_CHECK_EQUAL( store.account_total_ops( alice ), 6u );
+      BOOST_CHECK_EQUAL( store.account_total_ops( bob ), 4u );
+      BOOST_CHECK_EQUAL( store.account_total_ops( account_id_type( 12 ) ), 0u );
+      BOOST_CHECK( store.account_operation( bob, 2 ) == operation_history_id_type( 2 ) );
+      BOOST_CHECK_EQUAL( store.account_sequence_at( bob, operation_history_id_type( 3 ) ), 2u );
+      BOOST_CHECK_EQUAL( store.get_operation_type( operation_history_id_type( 6 ) ),
+                         operation::tag<account_create_operation>::value );
+
+      operation_history_object loaded = store.get( operation_history_id_type( 5 ) );
+      BOOST_CHECK( loaded.id == operation_history_id_type( 5 ) );
+      BOOST_CHECK_EQUAL( loaded.block_num, 3u );
+      BOOST_CHECK_EQUAL( loaded.op.get<transfer_operation>().amount.amount.value, 5 );
+
+      // range queries, newest first
+      auto ids_of = []( const vector<operation_history_object>& ops ) {
+         vector<uint64_t> ids;
+         for( const auto& op : ops )
+            ids.push_back( op.id.instance.value );
+         return ids;
+      };
+      BOOST_CHECK( ids_of( store.get_account_history( bob, operation_history_id_type(),
+                                                      operation_history_id_type(), 10 ) )
+                   == vector<uint64_t>( { 6, 4, 2, 0 } ) );
+      BOOST_CHECK( ids_of( store.get_account_history( bob, operation_history_id_type( 5 ),
+                                                      operation_history_id_type( 2 ), 10 ) )
+                   == vector<uint64_t>( { 4 } ) );
+      BOOST_CHECK( ids_of( store.get_account_history( alice, operation_history_id_type(),
+                                                      operation_history_id_type(), 2 ) )
+                   == vector<uint64_t>( { 5, 4 } ) );
+      BOOST_CHECK( ids_of( store.get_account_history( bob, operation_history_id_type(), operation_history_id_type(),
+                                                      10, operation::tag<account_create_operation>::value ) )
+                   == vector<uint64_t>( { 6 } ) );
+      BOOST_CHECK( ids_of( store.get_account_history( alice, operation_history_id_type( 4 ),
+                                                      operation_history_id_type( 1 ), 10,
+                                                      operation::tag<transfer_operation>::value ) )
+                   == vector<uint64_t>( { 4, 3, 2 } ) );
+      BOOST_CHECK( ids_of( store.get_account_history( bob, operation_history_id_type( 5 ), operation_history_id_type(),
+                                                      1, operation::tag<transfer_operation>::value ) )
+                   == vector<uint64_t>( { 4 } ) );
+      BOOST_CHECK( store.get_account_history( alice, operation_history_id_type(), operation_history_id_type(), 10,
+                                              operation::tag<account_create_operation>::value ).empty() );
+      BOOST_CHECK( store.get_account_history( account_id_type( 12 ), operation_history_id_type(),
+                                              operation_history_id_type(), 10 ).empty() );
+      BOOST_CHECK( ids_of( store.get_relative_account_history( bob, 0, 2, 10 ) ) == vector<uint64_t>( { 6, 4, 2 } ) );
+      BOOST_CHECK( ids_of( store.get_relative_account_history( bob, 2, 0, 10 ) ) == vector<uint64_t>( { 2, 0 } ) );
+      BOOST_CHECK( ids_of( store.get_relative_account_history( alice, 9, 1, 1 ) ) == vector<uint64_t>( { 5 } ) );
+
+      // block 3 and later are applied again
+      store.truncate_from_block( 3 );
+      BOOST_CHECK_EQUAL( store.size(), 4u );
+      BOOST_CHECK_EQUAL( store.head_block_num(), 2u );
+      BOOST_CHECK_EQUAL( store.account_total_ops( alice ), 4u );
+      BOOST_CHECK_EQUAL( store.account_total_ops( bob ), 2u );
+      BOOST_CHECK( store.append( make_op( 3, 42 ), only_bob ) == operation_history_id_type( 4 ) );
+
+      // the in-memory indexes are rebuilt from the file
+      store.close();
+      store.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( store.size(), 5u );
+      BOOST_CHECK_EQUAL( store.head_block_num(), 3u );
+      BOOST_CHECK_EQUAL( store.account_total_ops( alice ), 4u );
+      BOOST_CHECK_EQUAL( store.account_total_ops( bob ), 3u );
+      BOOST_CHECK( store.account_operation( bob, 3 ) == operation_history_id_type( 4 ) );
+      BOOST_CHECK_EQUAL( store.get( operation_history_id_type( 4 ) ).op.get<transfer_operation>().amount.amount.value,
+                         42 );
+
+      // the saved indexes stop covering removed operations, the operations appended after that are scanned
+      store.truncate_from_block( 3 );
+      const fc::path index_file = data_dir.path() / "operations.index";
+      const fc::path stale_index = data_dir.path() / "stale.index";
+      BOOST_REQUIRE( fc::exists( index_file ) );
+      fc::copy( index_file, stale_index );
+      store.append( make_op( 3, 43 ), flat_set<account_id_type>{ alice } );
+      store.append( create_oho, only_bob );
+      store.close();
+      fc::remove( index_file );
+      fc::rename( stale_index, index_file );
+      store.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( store.size(), 6u );
+      BOOST_CHECK_EQUAL( store.account_total_ops( alice ), 5u );
+      BOOST_CHECK_EQUAL( store.account_total_ops( bob ), 3u );
+      BOOST_CHECK( ids_of( store.get_account_history( bob, operation_history_id_type(), operation_history_id_type(),
+                                                      10, operation::tag<account_create_operation>::value ) )
+                   == vector<uint64_t>( { 5 } ) );
+      BOOST_CHECK( ids_of( store.get_relative_account_history( alice, 0, 4, 10 ) ) == vector<uint64_t>( { 4, 3 } ) );
+      store.close();
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(instance_list_test) {
+   try {
+      graphene::account_history::instance_list list;
+      vector<uint64_t> values;
+      for( uint64_t i = 0; i < 200; ++i )
+         values.push_back( i * 3 );
+      // gaps that do not fit the 32 bit deltas
+      values.push_back( uint64_t(1) << 40 );
+      values.push_back( ( uint64_t(1) << 40 ) + 1 );
+      for( uint64_t value : values )
+         list.push_back( value );
+
+      BOOST_CHECK_EQUAL( list.size(), values.size() );
+      for( size_t i = 0; i < values.size(); ++i )
+         BOOST_CHECK_EQUAL( list[i], values[i] );
+      BOOST_CHECK_EQUAL( list.count_not_greater( 0 ), 1u );
+      BOOST_CHECK_EQUAL( list.count_not_greater( 191 ), 64u );
+      BOOST_CHECK_EQUAL( list.count_not_greater( 192 ), 65u );
+      BOOST_CHECK_EQUAL( list.count_not_greater( uint64_t(1) << 39 ), 200u );
+      BOOST_CHECK_EQUAL( list.count_not_greater( uint64_t(1) << 41 ), 202u );
+      GRAPHENE_CHECK_THROW( list.push_back( 5 ), fc::exception );
+
+      while( list.size() > 64 )
+         list.pop_back();
+      BOOST_CHECK_EQUAL( list.back(), 189u );
+      BOOST_CHECK_EQUAL( list.count_not_greater( uint64_t(1) << 41 ), 64u );
+      list.push_back( 1000 );
+      BOOST_CHECK_EQUAL( list[64], 1000u );
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(get_account_history_from_file_storage) {
+   try {
+      graphene::app::history_api hist_api(app);
+
+      const account_object& dan = create_account("dan");
+      const account_object& bob = create_account("bob");
+      fund( dan, asset(1000000) );
+      for( int i = 0; i < 5; ++i )
+         transfer( dan, bob, asset(100 + i) );
+
+      generate_block();
+      fc::usleep(fc::milliseconds(2000));
+
+      int account_create_op_id = operation::tag<account_create_operation>::value;
+      int transfer_op_id = operation::tag<transfer_operation>::value;
+
+      // nothing is kept in the object database
+      BOOST_CHECK( dan.statistics(db).most_recent_op == account_transaction_history_id_type() );
+
+      // dan: account_create, 1 received and 5 sent transfers, newest first
+      vector<operation_history_object> histories = hist_api.get_account_history(
+            "dan", operation_history_id_type(), 100, operation_history_id_type());
+      BOOST_REQUIRE_EQUAL(histories.size(), 7u);
+      BOOST_CHECK_EQUAL(histories[6].op.which(), account_create_op_id);
+      for( size_t i = 1; i < histories.size(); ++i )
+         BOOST_CHECK(histories[i].id.instance() < histories[i-1].id.instance());
+
+      // stop is exclusive, start is inclusive
+      vector<operation_history_object> range = hist_api.get_account_history(
+            "dan", histories[4].id, 100, histories[1].id);
+      BOOST_REQUIRE_EQUAL(range.size(), 3u);
+      BOOST_CHECK(range[0].id == histories[1].id);
+      BOOST_CHECK(range[2].id == histories[3].id);
+
+      range = hist_api.get_account_history_operations(
+            "dan", transfer_op_id, operation_history_id_type(), operation_history_id_type(), 100);
+      BOOST_CHECK_EQUAL(range.size(), 6u);
+      range = hist_api.get_account_history_operations(
+            "dan", account_create_op_id, operation_history_id_type(), operation_history_id_type(), 100);
+      BOOST_REQUIRE_EQUAL(range.size(), 1u);
+      BOOST_CHECK(range[0].id == histories[6].id);
+
+      // sequence numbers 2 to 4
+      range = hist_api.get_relative_account_history("dan", 2, 100, 4);
+      BOOST_REQUIRE_EQUAL(range.size(), 3u);
+      BOOST_CHECK(range[0].id == histories[3].id);
+      BOOST_CHECK(range[2].id == histories[5].id);
+
+      range = hist_api.get_account_history("bob", operation_history_id_type(), 100, operation_history_id_type());
+      BOOST_CHECK_EQUAL(range.size(), 6u);
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2023 R-Squared Labs LLC, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/message.hpp>
+#include <graphene/net/peer_connection.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+using namespace graphene::net;
+
+namespace {
+
+   message make_message( uint32_t msg_type, size_t size )
+   {
+      message m;
+      m.msg_type = msg_type;
+      m.data.resize( size );
+      for( size_t i = 0; i < size; ++i )
+         m.data[i] = char( 'a' + i % 26 );
+      m.size = uint32_t( size );
+      return m;
+   }
+
+   using send_class = peer_connection::send_class;
+
+}
+
+BOOST_AUTO_TEST_SUITE( peer_connection_tests )
+
+BOOST_AUTO_TEST_CASE( padded_message_layout )
+{
+   for( size_t size : { size_t(0), size_t(7), size_t(8), size_t(13), size_t(24), size_t(1000) } )
+   {
+      const message m = make_message( trx_message_type, size );
+      const padded_message padded( m );
+
+      BOOST_CHECK_EQUAL( padded.msg_type, uint32_t(trx_message_type) );
+      BOOST_CHECK_EQUAL( padded.message_size(), size );
+      // the header and the message, rounded up to the next multiple of 16 bytes
+      const size_t unpadded_size = sizeof(message_header) + size;
+      BOOST_CHECK_EQUAL( padded.data.size() % 16, 0u );
+      BOOST_CHECK_GE( padded.data.size(), unpadded_size );
+      BOOST_CHECK_LT( padded.data.size(), unpadded_size + 16 );
+
+      BOOST_CHECK( std::memcmp( padded.data.data(), (const char*)&m, sizeof(message_header) ) == 0 );
+      BOOST_CHECK( std::equal( m.data.begin(), m.data.end(), padded.data.begin() + sizeof(message_header) ) );
+      for( size_t i = unpadded_size; i < padded.data.size(); ++i )
+         BOOST_CHECK_EQUAL( int(padded.data[i]), 0 );
+
+      const message unpadded = padded.to_message();
+      BOOST_CHECK_EQUAL( unpadded.msg_type.value(), m.msg_type.value() );
+      BOOST_CHECK_EQUAL( unpadded.size.value(), m.size.value() );
+      BOOST_CHECK( unpadded.data == m.data );
+      BOOST_CHECK( unpadded.id() == m.id() );
+   }
+}
+
+BOOST_AUTO_TEST_CASE( send_classes )
+{
+   // a compact block must not overtake the transactions queued before it
+   BOOST_CHECK( peer_connection::get_send_class( trx_message_type ) == send_class::relay );
+   BOOST_CHECK( peer_connection::get_send_class( compact_block_message_type ) == send_class::relay );
+   BOOST_CHECK( peer_connection::get_send_class( block_message_type ) == send_class::relay );
+   BOOST_CHECK( peer_connection::get_send_class( item_ids_inventory_message_type ) == send_class::trx_inventory );
+   BOOST_CHECK( peer_connection::get_send_class( fetch_blockchain_item_ids_message_type ) == send_class::sync );
+   BOOST_CHECK( peer_connection::get_send_class( address_message_type ) == send_class::address );
+   BOOST_CHECK( peer_connection::get_send_class( hello_message_type ) == send_class::control );
+}
+
+BOOST_AUTO_TEST_CASE( send_scheduler_weighted_round_robin )
+{
+   const std::array<uint32_t, peer_connection::send_class_count> weights = { 4, 3, 2, 1, 1 };
+   std::array<uint32_t, peer_connection::send_class_count> queued;
+   auto has_messages = [&queued]( send_class c ) { return queued[(size_t)c] > 0; };
+   auto run = [&queued,&has_messages]( peer_connection::send_scheduler& scheduler, size_t count ) {
+      std::vector<send_class> sent;
+      for( size_t i = 0; i < count; ++i )
+      {
+         const send_class c = scheduler.next( has_messages );
+         if( c == send_class::count )
+            break;
+         --queued[(size_t)c];
+         sent.push_back( c );
+      }
+      return sent;
+   };
+
+   BOOST_TEST_MESSAGE( "Nothing is sent without messages" );
+   {
+      peer_connection::send_scheduler scheduler( weights );
+      queued.fill( 0 );
+      BOOST_CHECK( scheduler.next( has_messages ) == send_class::count );
+   }
+
+   BOOST_TEST_MESSAGE( "Every class sends its weight per round while all of them are busy" );
+   {
+      peer_connection::send_scheduler scheduler( weights );
+      queued.fill( 100 );
+      const auto sent = run( scheduler, 2 * 11 );
+      BOOST_REQUIRE_EQUAL( sent.size(), 22u );
+      for( size_t round = 0; round < 2; ++round )
+      {
+         std::map<send_class, uint32_t> counts;
+         for( size_t i = round * 11; i < ( round + 1 ) * 11; ++i )
+            ++counts[ sent[i] ];
+         for( size_t c = 0; c < peer_connection::send_class_count; ++c )
+            BOOST_CHECK_EQUAL( counts[ (send_class)c ], weights[c] );
+      }
+      // higher classes go first within a round
+      BOOST_CHECK( sent.front() == send_class::control );
+      BOOST_CHECK( sent[10] == send_class::address );
+   }
+
+   BOOST_TEST_MESSAGE( "The credits are reset once the waiting classes have used them up" );
+   {
+      peer_connection::send_scheduler scheduler( weights );
+      queued.fill( 0 );
+      queued[(size_t)send_class::sync] = 10;
+      const auto sent = run( scheduler, 10 );
+      BOOST_CHECK_EQUAL( sent.size(), 10u );
+      for( send_class c : sent )
+         BOOST_CHECK( c == send_class::sync );
+      BOOST_CHECK( scheduler.next( has_messages ) == send_class::count );
+   }
+
+   BOOST_TEST_MESSAGE( "A low class is not starved by a busy high class" );
+   {
+      peer_connection::send_scheduler scheduler( weights );
+      queued.fill( 0 );
+      queued[(size_t)send_class::control] = 1000;
+      queued[(size_t)send_class::address] = 3;
+      const auto sent = run( scheduler, 15 );
+      BOOST_REQUIRE_EQUAL( sent.size(), 15u );
+      // one address message after every 4 control messages
+      for( size_t i = 0; i < sent.size(); ++i )
+         BOOST_CHECK( sent[i] == ( i % 5 == 4 ? send_class::address : send_class::control ) );
+   }
+
+   const std::array<uint32_t, peer_connection::send_class_count> without_sync = { 1, 1, 0, 1, 1 };
+   BOOST_CHECK_THROW( peer_connection::send_scheduler{ without_sync }, fc::exception );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
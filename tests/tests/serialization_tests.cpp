@@ -25,7 +25,8 @@
 #include <boost/test/unit_test.hpp>
 
 #include <graphene/chain/database.hpp>
-
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/message.hpp>
 
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/elliptic.hpp>
@@ -112,4 +113,54 @@ BOOST_AUTO_TEST_CASE( extension_serialization_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( compact_block_message_ids )
+{
+   try {
+      ACTORS( (alice)(bob) );
+      transfer( account_id_type(), alice_id, asset(1000) );
+      signed_block block;
+      for( int i = 0; i < 2; ++i )
+      {
+         signed_transaction tx;
+         transfer_operation op;
+         op.from = alice_id;
+         op.to = bob_id;
+         op.amount = asset(10 + i);
+         tx.operations.push_back( op );
+         set_expiration( db, tx );
+         sign( tx, alice_private_key );
+         block.transactions.push_back( PUSH_TX( db, tx ) );
+      }
+      block.timestamp = db.head_block_time();
+      block.transaction_merkle_root = block.calculate_merkle_root();
+
+      // a compact block refers to its transactions by the ids of the trx_messages they were relayed in
+      graphene::net::block_message full( block );
+      graphene::net::compact_block_message compact;
+      compact.header = full.block;
+      compact.block_id = full.block_id;
+      for( const auto& ptx : full.block.transactions )
+      {
+         const graphene::net::message trx_msg( graphene::net::trx_message( ptx ) );
+         BOOST_CHECK( fc::ripemd160::hash( static_cast<const signed_transaction&>( ptx ) ) == trx_msg.id() );
+         compact.transactions.push_back( { trx_msg.id(), ptx.operation_results } );
+      }
+
+      // the block message rebuilt from the relayed transactions is the original one
+      graphene::net::block_message rebuilt;
+      static_cast<signed_block_header&>( rebuilt.block ) = compact.header;
+      rebuilt.block_id = compact.block_id;
+      for( size_t i = 0; i < compact.transactions.size(); ++i )
+      {
+         const graphene::net::trx_message relayed( full.block.transactions[i] );
+         rebuilt.block.transactions.emplace_back( relayed.trx );
+         rebuilt.block.transactions.back().operation_results = compact.transactions[i].operation_results;
+      }
+      BOOST_CHECK( graphene::net::message( rebuilt ).id() == graphene::net::message( full ).id() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -241,6 +241,59 @@ BOOST_AUTO_TEST_CASE(track_votes_witnesses_disabled)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(witness_vote_ranking)
+{
+   try
+   {
+      INVOKE(put_my_witnesses);
+
+      const auto& wit_idx = db.get_index_type<witness_index>();
+      const auto& ranking = dynamic_cast<const base_primary_index&>( wit_idx )
+                               .get_secondary_index< vote_ranking_index<witness_object> >().ranking();
+
+      // every witness is ranked by the votes of the last maintenance, which are tracked for standby ones too
+      BOOST_REQUIRE_EQUAL( ranking.size(), wit_idx.indices().size() );
+      const vote_ranking_index<witness_object>::entry* previous = nullptr;
+      for( const auto& e : ranking )
+      {
+         BOOST_CHECK_EQUAL( e.votes, e.object->total_votes );
+         if( previous != nullptr )
+            BOOST_CHECK( previous->votes > e.votes
+                         || ( previous->votes == e.votes && previous->vote_id < e.vote_id ) );
+         previous = &e;
+      }
+
+      graphene::app::application_options opt = app.get_options();
+      graphene::app::database_api db_api( db, &opt );
+      const vector<witness_object> top = db_api.get_top_witnesses( 3 );
+      BOOST_REQUIRE_EQUAL( top.size(), 3u );
+      auto ranked = ranking.begin();
+      for( const witness_object& wit : top )
+         BOOST_CHECK( wit.id == (ranked++)->object->id );
+      BOOST_CHECK_THROW( db_api.get_top_witnesses( opt.api_limit_lookup_witness_accounts + 1 ), fc::exception );
+
+      // popping a maintenance block restores the ranking of the previous one
+      const auto& witnesses_by_account = db.get_index_type<witness_index>().indices().get<by_account>();
+      const witness_id_type witness0_witness_id = witnesses_by_account.find( get_account( "witness0" ).id )->id;
+      std::map<object_id_type, uint64_t> votes_before;
+      for( const auto& e : ranking )
+         votes_before[e.object->id] = e.votes;
+      transfer( committee_account, get_account( "witness0" ).id, asset( 1000 ) );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      BOOST_REQUIRE( ranking.size() == votes_before.size() );
+      BOOST_CHECK( witness0_witness_id(db).total_votes != votes_before[witness0_witness_id] );
+
+      db.pop_block();
+      for( const auto& e : ranking )
+      {
+         BOOST_CHECK_EQUAL( e.votes, votes_before[e.object->id] );
+         BOOST_CHECK_EQUAL( e.votes, e.object->total_votes );
+      }
+      BOOST_CHECK( ranking.begin()->object->id == top.front().id );
+
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE(put_my_committee_members)
 {
    try
@@ -951,4 +1004,146 @@ BOOST_AUTO_TEST_CASE( committee_votes_calculation )
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( incremental_vote_tally )
+{
+   try
+   {
+      ACTORS( (alice)(bob)(carol) );
+
+      transfer( committee_account, alice_id, asset(1000) );
+      transfer( committee_account, bob_id, asset(2000) );
+      transfer( committee_account, carol_id, asset(4000) );
+
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      set_expiration( db, trx );
+
+      const witness_id_type wit1 = witness_id_type(1);
+      const witness_id_type wit2 = witness_id_type(2);
+      const uint64_t base1 = wit1(db).total_votes;
+      const uint64_t base2 = wit2(db).total_votes;
+
+      auto update_options = [this]( account_id_type account, std::function<void(account_options&)> update ) {
+         account_update_operation op;
+         op.account = account;
+         op.new_options = account(db).options;
+         update( *op.new_options );
+         trx.operations.clear();
+         trx.operations.push_back( op );
+         PUSH_TX( db, trx, ~0 );
+         trx.clear();
+      };
+      auto core_balance = [this]( account_id_type account ) {
+         return static_cast<uint64_t>( get_balance( account, asset_id_type() ) );
+      };
+
+      // the fixture verifies the incremental tally against the stored contributions on every maintenance
+      BOOST_TEST_MESSAGE( "Voting directly and by proxy" );
+      update_options( alice_id, [&wit1,this]( account_options& o ) {
+         o.votes.insert( wit1(db).vote_id );
+         o.num_witness = 1;
+      });
+      update_options( bob_id, [this]( account_options& o ) { o.voting_account = alice_id; } );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      set_expiration( db, trx );
+      BOOST_CHECK_EQUAL( wit1(db).total_votes, base1 + core_balance( alice_id ) + core_balance( bob_id ) );
+      BOOST_CHECK_EQUAL( wit2(db).total_votes, base2 );
+
+      BOOST_TEST_MESSAGE( "Changing the stake of a delegator" );
+      transfer( carol_id, bob_id, asset(500) );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      set_expiration( db, trx );
+      BOOST_CHECK_EQUAL( wit1(db).total_votes, base1 + core_balance( alice_id ) + core_balance( bob_id ) );
+
+      BOOST_TEST_MESSAGE( "Changing the votes of the proxy" );
+      update_options( alice_id, [&wit1,&wit2,this]( account_options& o ) {
+         o.votes.erase( wit1(db).vote_id );
+         o.votes.insert( wit2(db).vote_id );
+      });
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      set_expiration( db, trx );
+      BOOST_CHECK_EQUAL( wit1(db).total_votes, base1 );
+      BOOST_CHECK_EQUAL( wit2(db).total_votes, base2 + core_balance( alice_id ) + core_balance( bob_id ) );
+
+      BOOST_TEST_MESSAGE( "Popping the maintenance block forces a full tally" );
+      update_options( bob_id, []( account_options& o ) { o.voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT; } );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      db.pop_block();
+      generate_block();
+      set_expiration( db, trx );
+      BOOST_CHECK_EQUAL( wit2(db).total_votes, base2 + core_balance( alice_id ) );
+
+      BOOST_TEST_MESSAGE( "The full tally gives the same results" );
+      transfer( carol_id, alice_id, asset(700) );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      set_expiration( db, trx );
+      const uint64_t incremental_votes = wit2(db).total_votes;
+      BOOST_CHECK_EQUAL( incremental_votes, base2 + core_balance( alice_id ) );
+      db.enable_incremental_vote_tally( false );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      set_expiration( db, trx );
+      BOOST_CHECK_EQUAL( wit2(db).total_votes, incremental_votes );
+      db.enable_incremental_vote_tally( true );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      BOOST_CHECK_EQUAL( wit2(db).total_votes, incremental_votes );
+
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( partitioned_vote_tally )
+{
+   try
+   {
+      auto update_options = [this]( account_id_type account, std::function<void(account_options&)> update ) {
+         account_update_operation op;
+         op.account = account;
+         op.new_options = account(db).options;
+         update( *op.new_options );
+         trx.operations.clear();
+         trx.operations.push_back( op );
+         PUSH_TX( db, trx, ~0 );
+         trx.clear();
+      };
+
+      const auto& committee_members = db.get_global_properties().active_committee_members;
+      const size_t voter_count = 24;
+      for( size_t i = 0; i < voter_count; ++i )
+      {
+         const account_id_type voter = create_account( "voter" + fc::to_string( i ) ).id;
+         transfer( committee_account, voter, asset( 1000 + 37 * i ) );
+         update_options( voter, [&committee_members,i,this]( account_options& o ) {
+            o.votes.insert( witness_id_type( 1 + i % 5 )(db).vote_id );
+            o.votes.insert( committee_members[ i % committee_members.size() ](db).vote_id );
+            o.num_witness = 1;
+            o.num_committee = 1;
+         });
+      }
+      db.enable_incremental_vote_tally( false );
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time
+                       - db.get_global_properties().parameters.block_interval );
+      BOOST_REQUIRE_EQUAL( db.get_dynamic_global_properties().next_maintenance_time,
+                           db.get_slot_time( 1 ) );
+
+      BOOST_TEST_MESSAGE( "Tallying all voters in one partition" );
+      db.set_vote_tally_partition_size( 0 );
+      generate_block();
+      const fc::sha256 serial_state = hash_object_database( db );
+      const uint64_t serial_votes = witness_id_type(1)(db).total_votes;
+      db.pop_block();
+
+      BOOST_TEST_MESSAGE( "Tallying the same voters in partitions of 5" );
+      db.set_vote_tally_partition_size( 5 );
+      generate_block();
+      BOOST_CHECK_EQUAL( witness_id_type(1)(db).total_votes, serial_votes );
+      BOOST_CHECK( hash_object_database( db ) == serial_state );
+
+      BOOST_TEST_MESSAGE( "Replaying the whole chain with partitioned tallies" );
+      verify_replay_equivalence( []( database& replica ) {
+         replica.enable_incremental_vote_tally( false );
+         replica.set_vote_tally_partition_size( 5 );
+      });
+
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()